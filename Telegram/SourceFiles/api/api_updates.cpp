@@ -744,7 +744,9 @@ void Updates::addActiveChat(rpl::producer<PeerData*> chat) {
 	}, _activeChats[key].lifetime);
 }
 
-void Updates::requestChannelRangeDifference(not_null<History*> history) {
+void Updates::requestChannelRangeDifference(
+		not_null<History*> history,
+		int32 pts) {
 	Expects(history->peer->isChannel());
 
 	const auto channel = history->peer->asChannel();
@@ -752,7 +754,10 @@ void Updates::requestChannelRangeDifference(not_null<History*> history) {
 		api().request(*requestId).cancel();
 	}
 	const auto range = history->rangeForDifferenceRequest();
-	if (!(range.from < range.till) || !channel->pts()) {
+	if (!pts) {
+		pts = channel->pts();
+	}
+	if (!(range.from < range.till) || !pts) {
 		return;
 	}
 
@@ -760,7 +765,7 @@ void Updates::requestChannelRangeDifference(not_null<History*> history) {
 		"{ good - after channelDifferenceTooLong was received, "
 		"validating history part }%1"
 		).arg(_session->mtp().isTestMode() ? " TESTMODE" : ""));
-	channelRangeDifferenceSend(channel, range, channel->pts());
+	channelRangeDifferenceSend(channel, range, pts);
 }
 
 void Updates::channelRangeDifferenceSend(
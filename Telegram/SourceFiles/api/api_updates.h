@@ -60,7 +60,11 @@ public:
 	void ptsWaiterStartTimerFor(ChannelData *channel, crl::time ms);
 
 	void getDifference();
-	void requestChannelRangeDifference(not_null<History*> history);
+	// Validates the loaded part of the history by the changes that
+	// happened after pts, the current channel pts by default.
+	void requestChannelRangeDifference(
+		not_null<History*> history,
+		int32 pts = 0);
 
 	void addActiveChat(rpl::producer<PeerData*> chat);
 
@@ -47,6 +47,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "data/data_user.h"
 #include "data/data_chat_filters.h"
 #include "data/data_histories.h"
+#include "data/data_history_cache.h"
 #include "core/core_cloud_password.h"
 #include "core/application.h"
 #include "base/unixtime.h"
@@ -3072,6 +3073,25 @@ void ApiWrap::requestSharedMedia(
 		return;
 	}
 
+	// The newest page is stored locally, apply it before the request.
+	const auto bottom = !topicRootId && (messageId == ServerMaxMsgId - 1);
+	const auto cacheKey = SharedMediaCacheKey{ peer, type };
+	if (bottom && _sharedMediaCacheLoaded.emplace(cacheKey).second) {
+		_sharedMediaRequests.emplace(key);
+		_session->data().historyCache().loadSharedMedia(
+			peer,
+			type,
+			crl::guard(_session, [=](
+					std::optional<Data::SharedMediaCacheSlice> cached) {
+				_sharedMediaRequests.remove(key);
+				if (cached) {
+					sharedMediaCacheLoaded(peer, type, std::move(*cached));
+				}
+				requestSharedMedia(peer, topicRootId, type, messageId, slice);
+			}));
+		return;
+	}
+
 	const auto history = _session->data().history(peer);
 	auto &histories = history->owner().histories();
 	const auto requestType = Data::Histories::RequestType::History;
@@ -3086,6 +3106,9 @@ void ApiWrap::requestSharedMedia(
 				messageId,
 				slice,
 				result);
+			if (bottom) {
+				sharedMediaBottomReceived(peer, type, parsed, result);
+			}
 			sharedMediaDone(peer, topicRootId, type, std::move(parsed));
 			finish();
 		}).fail([=] {
@@ -3121,6 +3144,64 @@ void ApiWrap::sharedMediaDone(
 	}
 }
 
+void ApiWrap::sharedMediaCacheLoaded(
+		not_null<PeerData*> peer,
+		SharedMediaType type,
+		Data::SharedMediaCacheSlice &&cached) {
+	auto parsed = Api::ParseSearchResult(
+		peer,
+		type,
+		ServerMaxMsgId - 1,
+		Data::LoadDirection::Around,
+		cached.messages);
+	if (parsed.messageIds.empty()) {
+		return;
+	}
+	// Newer messages could be sent after the page was stored,
+	// so the cached range ends with the newest cached message.
+	parsed.noSkipRange.till = ranges::max(parsed.messageIds);
+	_sharedMediaCached[SharedMediaCacheKey{ peer, type }]
+		= parsed.messageIds;
+
+	// The cached slice is never treated as the whole list, because
+	// the cached ids below the first server page can't be checked.
+	const auto count = (cached.fullCount > int(parsed.messageIds.size()))
+		? std::make_optional(cached.fullCount)
+		: std::nullopt;
+	_session->storage().add(Storage::SharedMediaAddSlice(
+		peer->id,
+		MsgId(),
+		type,
+		std::move(parsed.messageIds),
+		parsed.noSkipRange,
+		count
+	));
+}
+
+void ApiWrap::sharedMediaBottomReceived(
+		not_null<PeerData*> peer,
+		SharedMediaType type,
+		const Api::SearchResult &parsed,
+		const Api::SearchRequestResult &result) {
+	const auto i = _sharedMediaCached.find(SharedMediaCacheKey{ peer, type });
+	if (i != end(_sharedMediaCached)) {
+		// Cached messages missing in the server page were deleted.
+		// Cached messages below the server page can't be checked here,
+		// so they're removed as well and requested again when needed.
+		const auto range = parsed.noSkipRange;
+		for (const auto id : base::take(i->second)) {
+			if (id <= range.till
+				&& !ranges::contains(parsed.messageIds, id)) {
+				_session->storage().remove(Storage::SharedMediaRemoveOne(
+					peer->id,
+					type,
+					id));
+			}
+		}
+	}
+	_session->data().historyCache().storeSharedMedia(peer, type, result);
+}
+
 void ApiWrap::sendAction(const SendAction &action) {
 	if (!action.options.scheduled && !action.replaceMediaOf) {
 		const auto topicRootId = action.replyTo.topicRootId;
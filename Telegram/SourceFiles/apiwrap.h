@@ -34,6 +34,7 @@ class Forum;
 class ForumTopic;
 class Thread;
 class Story;
+struct SharedMediaCacheSlice;
 } // namespace Data
 
 namespace InlineBots {
@@ -490,6 +491,15 @@ private:
 		MsgId topicRootId,
 		SharedMediaType type,
 		Api::SearchResult &&parsed);
+	void sharedMediaCacheLoaded(
+		not_null<PeerData*> peer,
+		SharedMediaType type,
+		Data::SharedMediaCacheSlice &&cached);
+	void sharedMediaBottomReceived(
+		not_null<PeerData*> peer,
+		SharedMediaType type,
+		const Api::SearchResult &parsed,
+		const Api::SearchRequestResult &result);
 
 	void sendSharedContact(
 		const QString &phone,
@@ -637,6 +647,13 @@ private:
 	};
 	base::flat_set<SharedMediaRequest> _sharedMediaRequests;
 
+	// Ids applied from the local cache, checked by the first server page.
+	using SharedMediaCacheKey = std::pair<
+		not_null<PeerData*>,
+		SharedMediaType>;
+	base::flat_set<SharedMediaCacheKey> _sharedMediaCacheLoaded;
+	base::flat_map<SharedMediaCacheKey, std::vector<MsgId>> _sharedMediaCached;
+
 	std::unique_ptr<DialogsLoadState> _dialogsLoadState;
 	TimeId _dialogsLoadTill = 0;
 	rpl::variable<bool> _dialogsLoadMayBlockByDate = false;
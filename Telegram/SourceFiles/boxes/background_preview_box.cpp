@@ -551,8 +551,8 @@ void BackgroundPreviewBox::uploadForPeer(bool both) {
 		document->size);
 
 	session->uploader().documentProgress(
-	) | rpl::start_with_next([=](const FullMsgId &fullId) {
-		if (fullId != _uploadId) {
+	) | rpl::start_with_next([=](const Storage::UploadProgress &data) {
+		if (data.fullId != _uploadId) {
 			return;
 		}
 		_uploadProgress = document->uploading()
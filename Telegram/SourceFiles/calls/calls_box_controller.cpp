@@ -23,6 +23,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "main/main_session.h"
 #include "data/data_session.h"
 #include "data/data_changes.h"
+#include "data/data_histories.h"
 #include "data/data_media_types.h"
 #include "data/data_user.h"
 #include "data/data_peer_values.h" // Data::ChannelHasActiveCall.
@@ -346,6 +347,7 @@ private:
 	not_null<const style::IconButton*> _st;
 
 	std::unique_ptr<Ui::RippleAnimation> _actionRipple;
+	rpl::lifetime _unloadLock;
 
 };
 
@@ -356,7 +358,9 @@ BoxController::Row::Row(not_null<HistoryItem*> item)
 , _type(ComputeType(item))
 , _st(ComputeCallType(item) == CallType::Voice
 		? &st::callReDial
-		: &st::callCameraReDial) {
+		: &st::callCameraReDial)
+, _unloadLock(item->history()->owner().histories().preventUnload(
+	item->history())) {
 	refreshStatus();
 }
 
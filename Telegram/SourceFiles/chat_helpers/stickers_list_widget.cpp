@@ -64,6 +64,7 @@ constexpr auto kPreloadOfficialPages = 4;
 constexpr auto kOfficialLoadLimit = 40;
 constexpr auto kMinRepaintDelay = crl::time(33);
 constexpr auto kMinAfterScrollDelay = crl::time(33);
+constexpr auto kLottieStatsPeriod = crl::time(1000);
 
 using Data::StickersSet;
 using Data::StickersPack;
@@ -88,6 +89,21 @@ struct StickersListWidget::Sticker {
 	void ensureMediaCreated();
 };
 
+// Animations of a set in the player shared by all sets of the panel.
+class StickersListWidget::SetAnimations final {
+public:
+	explicit SetAnimations(not_null<Lottie::MultiPlayer*> player);
+	~SetAnimations();
+
+	void add(not_null<Lottie::Animation*> animation);
+	void remove(not_null<Lottie::Animation*> animation);
+
+private:
+	const not_null<Lottie::MultiPlayer*> _player;
+	base::flat_set<not_null<Lottie::Animation*>> _list;
+
+};
+
 struct StickersListWidget::Set {
 	Set(
 		uint64 id,
@@ -112,8 +128,7 @@ struct StickersListWidget::Set {
 	std::unique_ptr<Ui::RippleAnimation> ripple;
 	crl::time lastUpdateTime = 0;
 
-	std::unique_ptr<Lottie::MultiPlayer> lottiePlayer;
-	rpl::lifetime lottieLifetime;
+	std::unique_ptr<SetAnimations> lottieAnimations;
 
 	int count = 0;
 	bool externalLayout = false;
@@ -151,6 +166,29 @@ StickersListWidget::Set::Set(
 , externalLayout(externalLayout) {
 }
 
+StickersListWidget::SetAnimations::SetAnimations(
+	not_null<Lottie::MultiPlayer*> player)
+: _player(player) {
+}
+
+StickersListWidget::SetAnimations::~SetAnimations() {
+	for (const auto animation : _list) {
+		_player->remove(animation);
+	}
+}
+
+void StickersListWidget::SetAnimations::add(
+		not_null<Lottie::Animation*> animation) {
+	_list.emplace(animation);
+}
+
+void StickersListWidget::SetAnimations::remove(
+		not_null<Lottie::Animation*> animation) {
+	if (_list.remove(animation)) {
+		_player->remove(animation);
+	}
+}
+
 StickersListWidget::Set::Set(Set &&other) = default;
 StickersListWidget::Set &StickersListWidget::Set::operator=(
 	Set &&other) = default;
@@ -749,8 +787,7 @@ void StickersListWidget::takeHeavyData(
 }
 
 void StickersListWidget::takeHeavyData(Set &to, Set &from) {
-	to.lottiePlayer = std::move(from.lottiePlayer);
-	to.lottieLifetime = std::move(from.lottieLifetime);
+	to.lottieAnimations = std::move(from.lottieAnimations);
 	auto &toList = to.stickers;
 	auto &fromList = from.stickers;
 	const auto same = ranges::equal(
@@ -778,7 +815,7 @@ void StickersListWidget::takeHeavyData(Set &to, Set &from) {
 		}
 		for (const auto &sticker : fromList) {
 			if (sticker.lottie) {
-				to.lottiePlayer->remove(sticker.lottie);
+				to.lottieAnimations->remove(sticker.lottie);
 			}
 		}
 	}
@@ -977,9 +1014,6 @@ void StickersListWidget::paintStickers(Painter &p, QRect clip) {
 				auto deleteSelected = false;
 				paintSticker(p, set, info.rowsTop, info.section, index, now, paused, selected, deleteSelected);
 			}
-			if (!paused) {
-				markLottieFrameShown(set);
-			}
 			return true;
 		}
 		if (setHasTitle(set) && clip.top() < info.rowsTop) {
@@ -1032,17 +1066,31 @@ void StickersListWidget::paintStickers(Painter &p, QRect clip) {
 				paintSticker(p, set, info.rowsTop, info.section, index, now, paused, selected, deleteSelected);
 			}
 		}
-		if (!paused) {
-			markLottieFrameShown(set);
-		}
 		return true;
 	});
+	if (!paused) {
+		markLottieFrameShown();
+	}
 }
 
-void StickersListWidget::markLottieFrameShown(Set &set) {
-	if (const auto player = set.lottiePlayer.get()) {
-		player->markFrameShown();
+void StickersListWidget::markLottieFrameShown() {
+	// If the ready frame wasn't painted (for example only a part of the
+	// panel was repainted) the player should keep it for the next paint.
+	if (!base::take(_lottieFramePainted)) {
+		return;
+	} else if (_lottiePlayer) {
+		_lottiePlayer->markFrameShown();
 	}
+	const auto now = crl::now();
+	if (now < _lottieStatsStarted + kLottieStatsPeriod) {
+		return;
+	} else if (_lottieFramesRendered) {
+		DEBUG_LOG(("Stickers Panel: %1 frames rendered in %2ms."
+			).arg(_lottieFramesRendered
+			).arg(now - _lottieStatsStarted));
+	}
+	_lottieStatsStarted = now;
+	_lottieFramesRendered = 0;
 }
 
 void StickersListWidget::checkVisibleLottie() {
@@ -1068,8 +1116,7 @@ void StickersListWidget::checkVisibleLottie() {
 }
 
 void StickersListWidget::clearHeavyIn(Set &set, bool clearSavedFrames) {
-	const auto player = base::take(set.lottiePlayer);
-	const auto lifetime = base::take(set.lottieLifetime);
+	const auto animations = base::take(set.lottieAnimations);
 	for (auto &sticker : set.stickers) {
 		if (clearSavedFrames) {
 			sticker.savedFrame = QImage();
@@ -1083,8 +1130,8 @@ void StickersListWidget::clearHeavyIn(Set &set, bool clearSavedFrames) {
 
 void StickersListWidget::pauseInvisibleLottieIn(const SectionInfo &info) {
 	auto &set = shownSets()[info.section];
-	const auto player = set.lottiePlayer.get();
-	if (!player) {
+	const auto player = _lottiePlayer.get();
+	if (!player || !set.lottieAnimations) {
 		return;
 	}
 	const auto pauseInRows = [&](int fromRow, int tillRow) {
@@ -1156,25 +1203,33 @@ void StickersListWidget::paintMegagroupEmptySet(Painter &p, int y, bool buttonSe
 }
 
 void StickersListWidget::ensureLottiePlayer(Set &set) {
-	if (set.lottiePlayer) {
-		return;
-	}
-	set.lottiePlayer = std::make_unique<Lottie::MultiPlayer>(
-		Lottie::Quality::Default,
-		getLottieRenderer());
-	const auto raw = set.lottiePlayer.get();
-
-	raw->updates(
-	) | rpl::start_with_next([=] {
-		auto &sets = shownSets();
-		enumerateSections([&](const SectionInfo &info) {
-			if (sets[info.section].lottiePlayer.get() != raw) {
+	if (!_lottiePlayer) {
+		_lottiePlayer = std::make_unique<Lottie::MultiPlayer>(
+			Lottie::Quality::Default,
+			getLottieRenderer());
+		_lottiePlayer->updates(
+		) | rpl::start_with_next([=] {
+			++_lottieFramesRendered;
+			_lottieFramePainted = false;
+
+			const auto visibleTop = getVisibleTop();
+			const auto visibleBottom = getVisibleBottom();
+			auto &sets = shownSets();
+			enumerateSections([&](const SectionInfo &info) {
+				if (info.rowsTop >= visibleBottom) {
+					return false;
+				} else if (info.rowsBottom > visibleTop
+					&& sets[info.section].lottieAnimations) {
+					updateSet(info);
+				}
 				return true;
-			}
-			updateSet(info);
-			return false;
-		});
-	}, set.lottieLifetime);
+			});
+		}, lifetime());
+	}
+	if (!set.lottieAnimations) {
+		set.lottieAnimations = std::make_unique<SetAnimations>(
+			_lottiePlayer.get());
+	}
 }
 
 void StickersListWidget::setupLottie(Set &set, int section, int index) {
@@ -1183,11 +1238,13 @@ void StickersListWidget::setupLottie(Set &set, int section, int index) {
 
 	// Document should be loaded already for the animation to be set up.
 	Assert(sticker.documentMedia != nullptr);
-	sticker.lottie = LottieAnimationFromDocument(
-		set.lottiePlayer.get(),
+	const auto animation = LottieAnimationFromDocument(
+		_lottiePlayer.get(),
 		sticker.documentMedia.get(),
 		StickerLottieSize::StickersPanel,
 		boundingBoxSize() * cIntRetinaFactor());
+	set.lottieAnimations->add(animation);
+	sticker.lottie = animation;
 }
 
 void StickersListWidget::setupWebm(Set &set, int section, int index) {
@@ -1395,7 +1452,8 @@ void StickersListWidget::paintSticker(
 			sticker.savedFrame.setDevicePixelRatio(cRetinaFactor());
 			sticker.savedFrameFor = _singleSize;
 		}
-		set.lottiePlayer->unpause(sticker.lottie);
+		_lottiePlayer->unpause(sticker.lottie);
+		_lottieFramePainted = true;
 	} else if (sticker.webm && sticker.webm->started()) {
 		const auto frame = sticker.webm->current(
 			{ .frame = size, .keepAlpha = true },
@@ -1993,7 +2051,7 @@ void StickersListWidget::refreshSearchSets() {
 			entry.flags = set->flags;
 			auto elements = PrepareStickers(set->stickers, skipPremium);
 			if (!elements.empty()) {
-				entry.lottiePlayer = nullptr;
+				entry.lottieAnimations = nullptr;
 				entry.stickers = std::move(elements);
 			}
 			if (!SetInMyList(entry.flags)) {
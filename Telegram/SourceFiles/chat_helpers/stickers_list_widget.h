@@ -143,6 +143,7 @@ protected:
 private:
 	struct Sticker;
 	struct Set;
+	class SetAnimations;
 
 	enum class Section {
 		Featured,
@@ -283,7 +284,7 @@ private:
 		not_null<DocumentData*> document,
 		int indexHint);
 	[[nodiscard]] bool itemVisible(const SectionInfo &info, int index) const;
-	void markLottieFrameShown(Set &set);
+	void markLottieFrameShown();
 	void checkVisibleLottie();
 	void pauseInvisibleLottieIn(const SectionInfo &info);
 	void takeHeavyData(std::vector<Set> &to, std::vector<Set> &from);
@@ -363,6 +364,10 @@ private:
 	std::unique_ptr<LocalStickersManager> _localSetsManager;
 	ChannelData *_megagroupSet = nullptr;
 	uint64 _megagroupSetIdRequested = 0;
+	std::unique_ptr<Lottie::MultiPlayer> _lottiePlayer;
+	int _lottieFramesRendered = 0;
+	crl::time _lottieStatsStarted = 0;
+	bool _lottieFramePainted = false;
 	std::vector<Set> _mySets;
 	std::vector<Set> _officialSets;
 	std::vector<Set> _searchSets;
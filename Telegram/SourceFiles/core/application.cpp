@@ -28,6 +28,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "core/local_url_handlers.h"
 #include "core/launcher.h"
 #include "core/ui_integration.h"
+#include "core/startup_trace.h"
 #include "chat_helpers/emoji_keywords.h"
 #include "chat_helpers/stickers_emoji_image_loader.h"
 #include "base/qt/qt_common_adapters.h"
@@ -111,6 +112,7 @@ constexpr auto kQuitPreventTimeoutMs = crl::time(1500);
 constexpr auto kAutoLockTimeoutLateMs = crl::time(3000);
 constexpr auto kClearEmojiImageSourceTimeout = 10 * crl::time(1000);
 constexpr auto kFileOpenTimeoutMs = crl::time(1000);
+constexpr auto kStartupTraceTimeout = 30 * crl::time(1000);
 
 LaunchState GlobalLaunchState/* = LaunchState::Running*/;
 
@@ -242,6 +244,8 @@ Application::~Application() {
 }
 
 void Application::run() {
+	StartupTrace::Mark("run");
+
 	style::internal::StartFonts();
 
 	ThirdParty::start();
@@ -252,6 +256,7 @@ void Application::run() {
 
 	startLocalStorage();
 	ValidateScale();
+	StartupTrace::Mark("local storage");
 
 	refreshGlobalProxy(); // Depends on app settings being read.
 
@@ -282,6 +287,7 @@ void Application::run() {
 	startEmojiImageLoader();
 	startSystemDarkModeViewer();
 	Media::Player::start(_audio.get());
+	StartupTrace::Mark("ui");
 
 	if (MediaControlsManager::Supported()) {
 		_mediaControlsManager = std::make_unique<MediaControlsManager>();
@@ -356,8 +362,10 @@ void Application::run() {
 	}, _lifetime);
 
 	DEBUG_LOG(("Application Info: window created..."));
+	StartupTrace::Mark("window");
 
 	startDomain();
+	StartupTrace::Mark("domain");
 	startTray();
 
 	_lastActivePrimaryWindow->widget()->show();
@@ -366,6 +374,16 @@ void Application::run() {
 
 	DEBUG_LOG(("Application Info: showing."));
 	_lastActivePrimaryWindow->finishFirstShow();
+	if (_lastActivePrimaryWindow->locked()
+		|| !_lastActivePrimaryWindow->sessionController()) {
+		// No chats list will be painted on passcode or intro screens.
+		StartupTrace::Finish("shown");
+	} else {
+		StartupTrace::Mark("shown");
+		base::call_delayed(kStartupTraceTimeout, this, [] {
+			StartupTrace::Finish("timeout");
+		});
+	}
 
 	if (!_lastActivePrimaryWindow->locked() && cStartToSettings()) {
 		_lastActivePrimaryWindow->showSettings();
@@ -35,6 +35,13 @@ base::options::toggle OptionFreeType({
 	.restartRequired = true,
 });
 
+base::options::toggle OptionSkipNetworkLogs({
+	.id = kOptionSkipNetworkLogs,
+	.name = "Skip network logs",
+	.description = "Don't write TCP and MTProto records to the debug logs.",
+	.restartRequired = true,
+});
+
 class FilteredCommandLineArguments {
 public:
 	FilteredCommandLineArguments(int argc, char **argv);
@@ -291,6 +298,7 @@ base::options::toggle OptionFractionalScalingEnabled({
 
 const char kOptionFractionalScalingEnabled[] = "fractional-scaling-enabled";
 const char kOptionFreeType[] = "freetype";
+const char kOptionSkipNetworkLogs[] = "skip-network-logs";
 
 Launcher *Launcher::InstanceSetter::Instance = nullptr;
 
@@ -366,6 +374,11 @@ int Launcher::exec() {
 	// Must be called after options are inited.
 	initHighDpi();
 
+	if (OptionSkipNetworkLogs.value()) {
+		Logs::SetCategoryEnabled(Logs::Category::Tcp, false);
+		Logs::SetCategoryEnabled(Logs::Category::Mtp, false);
+	}
+
 	if (Logs::DebugEnabled()) {
 		const auto openalLogPath = QDir::toNativeSeparators(
 			cWorkingDir() + u"DebugLogs/last_openal_log.txt"_q);
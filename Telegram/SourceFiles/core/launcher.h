@@ -13,6 +13,7 @@ namespace Core {
 
 extern const char kOptionFractionalScalingEnabled[];
 extern const char kOptionFreeType[];
+extern const char kOptionSkipNetworkLogs[];
 
 class Launcher {
 public:
@@ -0,0 +1,79 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "core/startup_trace.h"
+
+#include <crl/crl_async.h>
+
+#include <QtCore/QFile>
+
+namespace Core::StartupTrace {
+namespace {
+
+struct Phase {
+	const char *name = nullptr;
+	crl::time finished = 0;
+};
+
+struct State {
+	std::vector<Phase> phases;
+	crl::time started = 0;
+	bool finished = false;
+};
+
+[[nodiscard]] State &Current() {
+	static auto result = State();
+	return result;
+}
+
+} // namespace
+
+void Mark(const char *phase) {
+	auto &state = Current();
+	if (state.finished) {
+		return;
+	}
+	const auto now = crl::now();
+	if (state.phases.empty()) {
+		state.started = now;
+	}
+	state.phases.push_back({ .name = phase, .finished = now });
+}
+
+void Finish(const char *phase) {
+	auto &state = Current();
+	if (state.finished) {
+		return;
+	}
+	Mark(phase);
+	state.finished = true;
+
+	auto lines = QStringList();
+	auto previous = state.started;
+	for (const auto &[name, finished] : base::take(state.phases)) {
+		lines.push_back(u"%1: %2 ms (at %3 ms)"_q
+			.arg(QString::fromLatin1(name))
+			.arg(finished - previous)
+			.arg(finished - state.started));
+		previous = finished;
+	}
+	LOG(("Startup Trace: %1").arg(lines.join(", ")));
+
+	if (!Logs::DebugEnabled()) {
+		return;
+	}
+	const auto path = cWorkingDir() + u"startup_trace.txt"_q;
+	crl::async([=, text = lines.join('\n').toUtf8()] {
+		auto file = QFile(path);
+		if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+			file.write(text);
+			file.write("\n");
+		}
+	});
+}
+
+} // namespace Core::StartupTrace
@@ -0,0 +1,21 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+namespace Core::StartupTrace {
+
+// Remembers when the startup phase ended, main thread only.
+// Phase names should be string literals.
+void Mark(const char *phase);
+
+// Marks the last phase and reports all of them to the log.
+// With debug logs enabled they're also written to startup_trace.txt.
+// Further calls, as well as Mark() calls, are ignored.
+void Finish(const char *phase);
+
+} // namespace Core::StartupTrace
@@ -236,6 +236,10 @@ rpl::producer<MessageUpdate> Changes::realtimeMessageUpdates(
 	return _messageChanges.realtimeUpdates(flag);
 }
 
+void Changes::messageUnloaded(not_null<HistoryItem*> item) {
+	_messageChanges.drop(item);
+}
+
 void Changes::entryUpdated(
 		not_null<Dialogs::Entry*> entry,
 		EntryUpdate::Flags flags) {
@@ -307,6 +307,7 @@ public:
 		MessageUpdate::Flags flags) const;
 	[[nodiscard]] rpl::producer<MessageUpdate> realtimeMessageUpdates(
 		MessageUpdate::Flag flag) const;
+	void messageUnloaded(not_null<HistoryItem*> item);
 
 	void entryUpdated(
 		not_null<Dialogs::Entry*> entry,
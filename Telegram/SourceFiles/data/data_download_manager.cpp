@@ -153,6 +153,11 @@ void DownloadManager::trackSession(not_null<Main::Session*> session) {
 		removed(update.item);
 	}, data.lifetime);
 
+	session->data().itemUnloaded(
+	) | rpl::start_with_next([=](not_null<HistoryItem*> item) {
+		removed(item);
+	}, data.lifetime);
+
 	session->account().sessionChanges(
 	) | rpl::filter(
 		rpl::mappers::_1 != session
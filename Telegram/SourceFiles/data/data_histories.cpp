@@ -24,6 +24,9 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "history/history_item.h"
 #include "history/history_item_helpers.h"
 #include "history/view/history_view_element.h"
+#include "storage/storage_facade.h"
+#include "storage/storage_shared_media.h"
+#include "window/window_session_controller.h"
 #include "core/application.h"
 #include "apiwrap.h"
 
@@ -31,6 +34,13 @@ namespace Data {
 namespace {
 
 constexpr auto kReadRequestTimeout = 3 * crl::time(1000);
+constexpr auto kCheckMessagesMemoryDelay = 10 * crl::time(1000);
+
+// Above this estimate messages of the cold chats are unloaded.
+constexpr auto kMessagesMemoryLimit = int64(512 * 1024 * 1024);
+
+// Chats that were shown recently are not unloaded even above the limit.
+constexpr auto kMessagesColdTimeout = 10 * 60 * crl::time(1000);
 
 } // namespace
 
@@ -101,7 +111,8 @@ MTPInputMedia WebPageForMTP(
 
 Histories::Histories(not_null<Session*> owner)
 : _owner(owner)
-, _readRequestsTimer([=] { sendReadRequests(); }) {
+, _readRequestsTimer([=] { sendReadRequests(); })
+, _checkMessagesMemoryTimer([=] { checkMessagesMemory(); }) {
 }
 
 Session &Histories::owner() const {
@@ -136,9 +147,130 @@ void Histories::unloadAll() {
 }
 
 void Histories::clearAll() {
+	_lastUsed.clear();
+	_unloadLocks.clear();
+	_checkMessagesMemoryTimer.cancel();
 	_map.clear();
 }
 
+auto Histories::collectMemoryUsage() const -> std::vector<MemoryUsage> {
+	auto result = std::vector<MemoryUsage>();
+	result.reserve(_map.size());
+	for (const auto &[peerId, history] : _map) {
+		if (const auto messages = history->messagesCount()) {
+			result.push_back({
+				.history = history.get(),
+				.messages = messages,
+				.bytes = history->messagesBytesEstimate(),
+			});
+		}
+	}
+	return result;
+}
+
+void Histories::checkMessagesMemoryDelayed() {
+	if (!_checkMessagesMemoryTimer.isActive()) {
+		_checkMessagesMemoryTimer.callOnce(kCheckMessagesMemoryDelay);
+	}
+}
+
+rpl::lifetime Histories::preventUnload(History *history) {
+	if (!history) {
+		return rpl::lifetime();
+	}
+	const auto locked = not_null(history);
+	++_unloadLocks[locked];
+	return rpl::lifetime([=, weak = base::make_weak(this)] {
+		if (!weak) {
+			return;
+		}
+		const auto i = _unloadLocks.find(locked);
+		if (i != end(_unloadLocks) && !--i->second) {
+			_unloadLocks.erase(i);
+		}
+	});
+}
+
+bool Histories::historyInUse(not_null<History*> history) const {
+	const auto locked = [&](History *checked) {
+		return checked && _unloadLocks.contains(checked);
+	};
+	if (locked(history)
+		|| locked(history->migrateToOrMe())
+		|| locked(history->migrateFrom())) {
+		return true;
+	}
+	for (const auto &window : session().windows()) {
+		const auto active = window->activeChatCurrent().owningHistory();
+		if (active
+			&& (active == history
+				|| active->migrateFrom() == history
+				|| active->migrateToOrMe() == history)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void Histories::checkMessagesMemory() {
+	const auto limit = kMessagesMemoryLimit;
+	const auto now = crl::now();
+	auto usage = collectMemoryUsage();
+	auto total = int64();
+	auto inUse = base::flat_set<not_null<History*>>();
+	for (const auto &entry : usage) {
+		total += entry.bytes;
+		if (historyInUse(entry.history)) {
+			_lastUsed[entry.history] = now;
+			inUse.emplace(entry.history);
+		}
+	}
+
+	// Histories without loaded messages have nothing to unload.
+	for (auto i = begin(_lastUsed); i != end(_lastUsed);) {
+		const auto loaded = ranges::contains(
+			usage,
+			i->first,
+			&MemoryUsage::history);
+		if (loaded) {
+			++i;
+		} else {
+			i = _lastUsed.erase(i);
+		}
+	}
+	if (total <= limit) {
+		return;
+	}
+	const auto lastUsed = [&](const MemoryUsage &entry) {
+		const auto i = _lastUsed.find(entry.history);
+		return (i != end(_lastUsed)) ? i->second : crl::time(0);
+	};
+	ranges::sort(usage, ranges::less(), lastUsed);
+
+	// Unload the least recently shown chats a bit below the limit,
+	// so that we don't do that again for each new message.
+	const auto target = limit - (limit / 4);
+	for (const auto &entry : usage) {
+		const auto used = lastUsed(entry);
+		if (total <= target || (used && used + kMessagesColdTimeout > now)) {
+			break;
+		}
+		const auto history = entry.history;
+		if (inUse.contains(history) || history->isForum()) {
+			// Shared media of topics keeps ids of their messages.
+			continue;
+		}
+		history->clear(History::ClearType::Unload);
+		history->unloadMessages();
+		total -= entry.bytes - history->messagesBytesEstimate();
+
+		// The sparse lists would point to forgotten messages.
+		session().storage().unload(Storage::SharedMediaUnloadThread(
+			history->peer->id,
+			MsgId()));
+	}
+}
+
 void Histories::readInbox(not_null<History*> history) {
 	DEBUG_LOG(("Reading: readInbox called."));
 	if (history->lastServerMessageKnown()) {
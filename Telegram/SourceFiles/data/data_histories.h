@@ -8,6 +8,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #pragma once
 
 #include "base/timer.h"
+#include "base/weak_ptr.h"
 
 class History;
 class HistoryItem;
@@ -34,7 +35,7 @@ struct WebPageDraft;
 	const Data::WebPageDraft &draft,
 	bool required = false);
 
-class Histories final {
+class Histories final : public base::has_weak_ptr {
 public:
 	enum class RequestType : uchar {
 		None,
@@ -57,6 +58,18 @@ public:
 	void unloadAll();
 	void clearAll();
 
+	struct MemoryUsage {
+		not_null<History*> history;
+		int messages = 0;
+		int64 bytes = 0;
+	};
+	[[nodiscard]] std::vector<MemoryUsage> collectMemoryUsage() const;
+	void checkMessagesMemoryDelayed();
+
+	// Messages of the history are not unloaded while the lifetime is alive.
+	// Used by the places that show its messages outside of the chat.
+	[[nodiscard]] rpl::lifetime preventUnload(History *history);
+
 	void readInbox(not_null<History*> history);
 	void readInboxTill(not_null<HistoryItem*> item);
 	void readInboxTill(not_null<History*> history, MsgId tillId);
@@ -202,6 +215,9 @@ private:
 
 	void sendDialogRequests();
 
+	void checkMessagesMemory();
+	[[nodiscard]] bool historyInUse(not_null<History*> history) const;
+
 	[[nodiscard]] bool isCreatingTopic(
 		not_null<History*> history,
 		MsgId rootId) const;
@@ -236,6 +252,10 @@ private:
 	base::flat_map<FullMsgId, MsgId> _createdTopicIds;
 	base::flat_set<mtpRequestId> _creatingTopicRequests;
 
+	base::flat_map<not_null<History*>, crl::time> _lastUsed;
+	base::flat_map<not_null<History*>, int> _unloadLocks;
+	base::Timer _checkMessagesMemoryTimer;
+
 };
 
 } // namespace Data
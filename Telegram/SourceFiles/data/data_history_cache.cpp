@@ -0,0 +1,261 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "data/data_history_cache.h"
+
+#include "data/data_session.h"
+#include "data/data_peer.h"
+#include "data/data_types.h"
+#include "main/main_session.h"
+#include "storage/cache/storage_cache_database.h"
+#include "storage/storage_facade.h"
+#include "storage/storage_shared_media.h"
+
+namespace Data {
+namespace {
+
+constexpr auto kSerializeVersion = mtpPrime(1);
+constexpr auto kMaxSerializedSize = 4 * 1024 * 1024;
+
+struct Deserialized {
+	MTPmessages_Messages messages;
+	int32 value = 0;
+};
+
+[[nodiscard]] std::optional<MTPmessages_Messages> Normalize(
+		const MTPmessages_Messages &slice) {
+	return slice.match([](const MTPDmessages_messagesNotModified &) {
+		return std::optional<MTPmessages_Messages>();
+	}, [](const auto &data) {
+		// Drop pts and topics, those are applied from the server only.
+		return std::make_optional(MTP_messages_messages(
+			data.vmessages(),
+			data.vchats(),
+			data.vusers()));
+	});
+}
+
+[[nodiscard]] int32 PtsFromSlice(const MTPmessages_Messages &slice) {
+	return slice.match([](const MTPDmessages_channelMessages &data) {
+		return data.vpts().v;
+	}, [](const auto &) {
+		return int32(0);
+	});
+}
+
+[[nodiscard]] int32 FullCountFromSlice(const MTPmessages_Messages &slice) {
+	return slice.match([](const MTPDmessages_messagesNotModified &) {
+		return int32(0);
+	}, [](const MTPDmessages_messages &data) {
+		return int32(data.vmessages().v.size());
+	}, [](const auto &data) {
+		return data.vcount().v;
+	});
+}
+
+[[nodiscard]] QByteArray Serialize(
+		const MTPmessages_Messages &slice,
+		int32 value) {
+	auto buffer = mtpBuffer();
+	buffer.push_back(kSerializeVersion);
+	buffer.push_back(value);
+	slice.write<mtpBuffer>(buffer);
+	return QByteArray(
+		reinterpret_cast<const char*>(buffer.constData()),
+		buffer.size() * sizeof(mtpPrime));
+}
+
+[[nodiscard]] std::optional<Deserialized> Deserialize(
+		const QByteArray &serialized) {
+	const auto size = serialized.size();
+	if (size < 2 * sizeof(mtpPrime) || (size % sizeof(mtpPrime)) != 0) {
+		return std::nullopt;
+	}
+	auto from = reinterpret_cast<const mtpPrime*>(serialized.constData());
+	const auto end = from + (size / sizeof(mtpPrime));
+	if (*from++ != kSerializeVersion) {
+		return std::nullopt;
+	}
+	const auto value = *from++;
+	auto result = MTPmessages_Messages();
+	if (!result.read(from, end)
+		|| from != end
+		|| result.type() != mtpc_messages_messages) {
+		return std::nullopt;
+	}
+	return Deserialized{ std::move(result), value };
+}
+
+void EnumerateTypes(
+		Storage::SharedMediaTypesMask types,
+		Fn<void(Storage::SharedMediaType)> callback) {
+	for (auto i = 0; i != Storage::kSharedMediaTypeCount; ++i) {
+		const auto type = static_cast<Storage::SharedMediaType>(i);
+		if (types.test(type)) {
+			callback(type);
+		}
+	}
+}
+
+} // namespace
+
+HistoryCache::HistoryCache(not_null<Session*> owner)
+: _owner(owner) {
+	using OneRemoved = Storage::SharedMediaRemoveOne;
+	using AllRemoved = Storage::SharedMediaRemoveAll;
+	auto &storage = _owner->session().storage();
+
+	storage.sharedMediaOneRemoved(
+	) | rpl::start_with_next([=](const OneRemoved &query) {
+		EnumerateTypes(query.types, [&](SharedMediaType type) {
+			removeSharedMedia(query.peerId, type);
+		});
+	}, _lifetime);
+
+	storage.sharedMediaAllRemoved(
+	) | rpl::start_with_next([=](const AllRemoved &query) {
+		EnumerateTypes(query.types, [&](SharedMediaType type) {
+			removeSharedMedia(query.peerId, type);
+		});
+	}, _lifetime);
+}
+
+bool HistoryCache::Allowed(not_null<PeerData*> peer) {
+	// Only channels can be validated with pts after loading from cache.
+	return peer->isChannel();
+}
+
+void HistoryCache::store(
+		not_null<PeerData*> peer,
+		const MTPmessages_Messages &slice) {
+	if (!Allowed(peer)) {
+		return;
+	}
+	const auto normalized = Normalize(slice);
+	if (!normalized) {
+		return;
+	}
+	auto serialized = Serialize(*normalized, PtsFromSlice(slice));
+	if (serialized.size() > kMaxSerializedSize) {
+		remove(peer);
+		return;
+	}
+	_owner->cache().put(
+		HistorySliceCacheKey(peer->id),
+		std::move(serialized));
+}
+
+void HistoryCache::load(
+		not_null<PeerData*> peer,
+		Fn<void(std::optional<HistoryCacheSlice>)> done) {
+	if (!Allowed(peer)) {
+		done(std::nullopt);
+		return;
+	}
+	_owner->cache().get(HistorySliceCacheKey(peer->id), [=](
+			QByteArray &&value) {
+		auto result = Deserialize(value);
+		crl::on_main(this, [=, result = std::move(result)]() mutable {
+			if (!result) {
+				done(std::nullopt);
+				return;
+			}
+			done(HistoryCacheSlice{
+				.messages = filterKnownPeers(result->messages),
+				.pts = result->value,
+			});
+		});
+	});
+}
+
+void HistoryCache::remove(not_null<PeerData*> peer) {
+	if (Allowed(peer)) {
+		_owner->cache().remove(HistorySliceCacheKey(peer->id));
+	}
+}
+
+void HistoryCache::storeSharedMedia(
+		not_null<PeerData*> peer,
+		SharedMediaType type,
+		const MTPmessages_Messages &slice) {
+	const auto normalized = Normalize(slice);
+	if (!normalized) {
+		return;
+	}
+	auto serialized = Serialize(*normalized, FullCountFromSlice(slice));
+	if (serialized.size() > kMaxSerializedSize) {
+		removeSharedMedia(peer->id, type);
+		return;
+	}
+	_owner->cache().put(
+		SharedMediaSliceCacheKey(peer->id, type),
+		std::move(serialized));
+}
+
+void HistoryCache::loadSharedMedia(
+		not_null<PeerData*> peer,
+		SharedMediaType type,
+		Fn<void(std::optional<SharedMediaCacheSlice>)> done) {
+	_owner->cache().get(SharedMediaSliceCacheKey(peer->id, type), [=](
+			QByteArray &&value) {
+		auto result = Deserialize(value);
+		crl::on_main(this, [=, result = std::move(result)]() mutable {
+			if (!result) {
+				done(std::nullopt);
+				return;
+			}
+			done(SharedMediaCacheSlice{
+				.messages = filterKnownPeers(result->messages),
+				.fullCount = result->value,
+			});
+		});
+	});
+}
+
+void HistoryCache::removeSharedMedia(PeerId peerId, SharedMediaType type) {
+	_owner->cache().remove(SharedMediaSliceCacheKey(peerId, type));
+}
+
+MTPmessages_Messages HistoryCache::filterKnownPeers(
+		const MTPmessages_Messages &slice) const {
+	// Cached users and chats may be outdated, apply only unknown ones.
+	const auto &data = slice.c_messages_messages();
+	auto chats = QVector<MTPChat>();
+	chats.reserve(data.vchats().v.size());
+	for (const auto &chat : data.vchats().v) {
+		const auto id = chat.match([](const MTPDchat &data) {
+			return peerFromChat(data.vid().v);
+		}, [](const MTPDchatForbidden &data) {
+			return peerFromChat(data.vid().v);
+		}, [](const MTPDchatEmpty &data) {
+			return peerFromChat(data.vid().v);
+		}, [](const MTPDchannel &data) {
+			return peerFromChannel(data.vid().v);
+		}, [](const MTPDchannelForbidden &data) {
+			return peerFromChannel(data.vid().v);
+		});
+		if (!_owner->peerLoaded(id)) {
+			chats.push_back(chat);
+		}
+	}
+	auto users = QVector<MTPUser>();
+	users.reserve(data.vusers().v.size());
+	for (const auto &user : data.vusers().v) {
+		const auto id = user.match([](const auto &data) {
+			return UserId(data.vid().v);
+		});
+		if (!_owner->userLoaded(id)) {
+			users.push_back(user);
+		}
+	}
+	return MTP_messages_messages(
+		data.vmessages(),
+		MTP_vector<MTPChat>(std::move(chats)),
+		MTP_vector<MTPUser>(std::move(users)));
+}
+
+} // namespace Data
@@ -0,0 +1,74 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include "base/weak_ptr.h"
+
+namespace Storage {
+enum class SharedMediaType : signed char;
+} // namespace Storage
+
+namespace Data {
+
+class Session;
+
+struct HistoryCacheSlice {
+	MTPmessages_Messages messages;
+	int32 pts = 0;
+};
+
+struct SharedMediaCacheSlice {
+	MTPmessages_Messages messages;
+	int fullCount = 0;
+};
+
+// Keeps the last server page of channel histories in the encrypted
+// local cache database, so that a chat can be shown before the first
+// messages.getHistory request finishes. The cached page is validated
+// against the channel pts and reconciled with the server afterwards.
+//
+// The newest page of each shared media list is kept the same way, so
+// that the media tabs are filled before the first messages.search.
+// Those pages are dropped when messages are removed from the lists.
+class HistoryCache final : public base::has_weak_ptr {
+public:
+	using SharedMediaType = Storage::SharedMediaType;
+
+	explicit HistoryCache(not_null<Session*> owner);
+
+	[[nodiscard]] static bool Allowed(not_null<PeerData*> peer);
+
+	void store(
+		not_null<PeerData*> peer,
+		const MTPmessages_Messages &slice);
+	void load(
+		not_null<PeerData*> peer,
+		Fn<void(std::optional<HistoryCacheSlice>)> done);
+	void remove(not_null<PeerData*> peer);
+
+	void storeSharedMedia(
+		not_null<PeerData*> peer,
+		SharedMediaType type,
+		const MTPmessages_Messages &slice);
+	void loadSharedMedia(
+		not_null<PeerData*> peer,
+		SharedMediaType type,
+		Fn<void(std::optional<SharedMediaCacheSlice>)> done);
+	void removeSharedMedia(PeerId peerId, SharedMediaType type);
+
+private:
+	[[nodiscard]] MTPmessages_Messages filterKnownPeers(
+		const MTPmessages_Messages &slice) const;
+
+	const not_null<Session*> _owner;
+
+	rpl::lifetime _lifetime;
+
+};
+
+} // namespace Data
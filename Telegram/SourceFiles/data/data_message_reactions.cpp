@@ -224,10 +224,14 @@ Reactions::Reactions(not_null<Session*> owner)
 		refreshDefault();
 	}, _lifetime);
 
-	_owner->session().changes().messageUpdates(
-		MessageUpdate::Flag::Destroyed
-	) | rpl::start_with_next([=](const MessageUpdate &update) {
-		const auto item = update.item;
+	rpl::merge(
+		_owner->session().changes().messageUpdates(
+			MessageUpdate::Flag::Destroyed
+		) | rpl::map([](const MessageUpdate &update) {
+			return update.item;
+		}),
+		_owner->itemUnloaded()
+	) | rpl::start_with_next([=](not_null<HistoryItem*> item) {
 		_pollingItems.remove(item);
 		_pollItems.remove(item);
 		_repaintItems.remove(item);
@@ -77,6 +77,9 @@ RepliesList::RepliesList(
 		}, _lifetime);
 	} else {
 		subscribeToUpdates();
+
+		// The list keeps ids of the messages, they must stay loaded.
+		_lifetime.add(histories().preventUnload(_history));
 	}
 }
 
@@ -64,6 +64,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "data/data_streaming.h"
 #include "data/data_media_rotation.h"
 #include "data/data_histories.h"
+#include "data/data_history_cache.h"
 #include "data/data_peer_values.h"
 #include "data/data_premium_limits.h"
 #include "data/data_forum.h"
@@ -254,6 +255,7 @@ Session::Session(not_null<Main::Session*> session)
 , _streaming(std::make_unique<Streaming>(this))
 , _mediaRotation(std::make_unique<MediaRotation>())
 , _histories(std::make_unique<Histories>(this))
+, _historyCache(std::make_unique<HistoryCache>(this))
 , _stickers(std::make_unique<Stickers>(this))
 , _sponsoredMessages(std::make_unique<SponsoredMessages>(this))
 , _reactions(std::make_unique<Reactions>(this))
@@ -278,6 +280,8 @@ Session::Session(not_null<Main::Session*> session)
 	setupPeerNameViewer();
 	setupUserIsContactViewer();
 
+	_chatsList.indexed()->enablePrefixIndex();
+
 	_chatsList.unreadStateChanges(
 	) | rpl::start_with_next([=] {
 		notifyUnreadBadgeChanged();
@@ -1809,6 +1813,10 @@ rpl::producer<not_null<const HistoryItem*>> Session::itemRemoved(
 	});
 }
 
+rpl::producer<not_null<HistoryItem*>> Session::itemUnloaded() const {
+	return _itemUnloaded.events();
+}
+
 void Session::notifyViewRemoved(not_null<const ViewElement*> view) {
 	_viewRemoved.fire_copy(view);
 }
@@ -2322,6 +2330,7 @@ void Session::registerMessage(not_null<HistoryItem*> item) {
 	if (!peerIsChannel(peerId) && IsServerMsgId(itemId)) {
 		_nonChannelMessages.emplace(itemId, item);
 	}
+	_histories->checkMessagesMemoryDelayed();
 }
 
 void Session::registerMessageTTL(TimeId when, not_null<HistoryItem*> item) {
@@ -2438,12 +2447,27 @@ void Session::removeDependencyMessage(not_null<HistoryItem*> item) {
 }
 
 void Session::unregisterMessage(not_null<HistoryItem*> item) {
-	const auto peerId = item->history()->peer->id;
-	const auto itemId = item->id;
 	_itemRemoved.fire_copy(item);
 	session().changes().messageUpdated(
 		item,
 		Data::MessageUpdate::Flag::Destroyed);
+	forgetMessage(item);
+}
+
+void Session::unloadMessage(not_null<HistoryItem*> item) {
+	// The message still exists on the server, so we don't send
+	// MessageUpdate::Flag::Destroyed. But all the holders of the pointer
+	// must drop it, so itemRemoved() is fired anyway. The places that
+	// show it as removed keep their histories loaded by preventUnload().
+	_itemRemoved.fire_copy(item);
+	_itemUnloaded.fire_copy(item);
+	session().changes().messageUnloaded(item);
+	forgetMessage(item);
+}
+
+void Session::forgetMessage(not_null<HistoryItem*> item) {
+	const auto peerId = item->history()->peer->id;
+	const auto itemId = item->id;
 	groups().unregisterMessage(item);
 	removeDependencyMessage(item);
 	for (auto i = begin(_highlightings); i != end(_highlightings);) {
@@ -2541,6 +2565,14 @@ void Session::unregisterDependentMessage(
 	}
 }
 
+bool Session::hasDependentMessages(not_null<HistoryItem*> item) const {
+	return _dependentMessages.contains(item);
+}
+
+bool Session::hasItemViews(not_null<HistoryItem*> item) const {
+	return _views.contains(item);
+}
+
 void Session::registerMessageRandomId(uint64 randomId, FullMsgId itemId) {
 	_messageByRandomId.emplace(randomId, itemId);
 }
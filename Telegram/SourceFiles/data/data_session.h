@@ -54,6 +54,7 @@ class CloudThemes;
 class Streaming;
 class MediaRotation;
 class Histories;
+class HistoryCache;
 class DocumentMedia;
 class PhotoMedia;
 class Stickers;
@@ -113,6 +114,9 @@ public:
 	[[nodiscard]] Histories &histories() const {
 		return *_histories;
 	}
+	[[nodiscard]] HistoryCache &historyCache() const {
+		return *_historyCache;
+	}
 	[[nodiscard]] Stickers &stickers() const {
 		return *_stickers;
 	}
@@ -285,6 +289,7 @@ public:
 	[[nodiscard]] rpl::producer<not_null<const HistoryItem*>> itemRemoved() const;
 	[[nodiscard]] rpl::producer<not_null<const HistoryItem*>> itemRemoved(
 		FullMsgId itemId) const;
+	[[nodiscard]] rpl::producer<not_null<HistoryItem*>> itemUnloaded() const;
 	void notifyViewRemoved(not_null<const ViewElement*> view);
 	[[nodiscard]] rpl::producer<not_null<const ViewElement*>> viewRemoved() const;
 	void notifyHistoryCleared(not_null<const History*> history);
@@ -384,6 +389,7 @@ public:
 
 	void registerMessage(not_null<HistoryItem*> item);
 	void unregisterMessage(not_null<HistoryItem*> item);
+	void unloadMessage(not_null<HistoryItem*> item);
 
 	void registerMessageTTL(TimeId when, not_null<HistoryItem*> item);
 	void unregisterMessageTTL(TimeId when, not_null<HistoryItem*> item);
@@ -423,6 +429,9 @@ public:
 	void unregisterDependentMessage(
 		not_null<HistoryItem*> dependent,
 		not_null<HistoryItem*> dependency);
+	[[nodiscard]] bool hasDependentMessages(
+		not_null<HistoryItem*> item) const;
+	[[nodiscard]] bool hasItemViews(not_null<HistoryItem*> item) const;
 
 	void destroyAllCallItems();
 
@@ -764,6 +773,7 @@ private:
 		std::unique_ptr<HistoryItem> item);
 	HistoryItem *changeMessageId(PeerId peerId, MsgId wasId, MsgId nowId);
 	void removeDependencyMessage(not_null<HistoryItem*> item);
+	void forgetMessage(not_null<HistoryItem*> item);
 
 	void photoApplyFields(
 		not_null<PhotoData*> photo,
@@ -888,6 +898,7 @@ private:
 	rpl::event_stream<not_null<HistoryItem*>> _itemTextRefreshRequest;
 	rpl::event_stream<not_null<HistoryItem*>> _itemDataChanges;
 	rpl::event_stream<not_null<const HistoryItem*>> _itemRemoved;
+	rpl::event_stream<not_null<HistoryItem*>> _itemUnloaded;
 	rpl::event_stream<not_null<const ViewElement*>> _viewRemoved;
 	rpl::event_stream<not_null<const History*>> _historyUnloaded;
 	rpl::event_stream<not_null<const History*>> _historyCleared;
@@ -1033,6 +1044,7 @@ private:
 	const std::unique_ptr<Streaming> _streaming;
 	const std::unique_ptr<MediaRotation> _mediaRotation;
 	const std::unique_ptr<Histories> _histories;
+	const std::unique_ptr<HistoryCache> _historyCache;
 	const std::unique_ptr<Stickers> _stickers;
 	std::unique_ptr<SponsoredMessages> _sponsoredMessages;
 	const std::unique_ptr<Reactions> _reactions;
@@ -22,6 +22,8 @@ constexpr auto kAudioAlbumThumbCacheTag = 0x0000000000000300ULL;
 constexpr auto kWebDocumentCacheTag = 0x0000020000000000ULL;
 constexpr auto kUrlCacheTag = 0x0000030000000000ULL;
 constexpr auto kGeoPointCacheTag = 0x0000040000000000ULL;
+constexpr auto kHistorySliceCacheTag = 0x0000050000000000ULL;
+constexpr auto kSharedMediaSliceCacheTag = 0x0000060000000000ULL;
 
 } // namespace
 
@@ -95,6 +97,22 @@ Storage::Cache::Key AudioAlbumThumbCacheKey(
 	};
 }
 
+Storage::Cache::Key HistorySliceCacheKey(PeerId peerId) {
+	return Storage::Cache::Key{
+		Data::kHistorySliceCacheTag,
+		peerId.value,
+	};
+}
+
+Storage::Cache::Key SharedMediaSliceCacheKey(
+		PeerId peerId,
+		Storage::SharedMediaType type) {
+	return Storage::Cache::Key{
+		Data::kSharedMediaSliceCacheTag | uint64(uint8(type)),
+		peerId.value,
+	};
+}
+
 } // namespace Data
 
 void MessageCursor::fillFrom(not_null<const Ui::InputField*> field) {
@@ -23,6 +23,7 @@ namespace Storage {
 namespace Cache {
 struct Key;
 } // namespace Cache
+enum class SharedMediaType : signed char;
 } // namespace Storage
 
 namespace Ui {
@@ -51,6 +52,10 @@ Storage::Cache::Key UrlCacheKey(const QString &location);
 Storage::Cache::Key GeoPointCacheKey(const GeoPointLocation &location);
 Storage::Cache::Key AudioAlbumThumbCacheKey(
 	const AudioAlbumThumbLocation &location);
+Storage::Cache::Key HistorySliceCacheKey(PeerId peerId);
+Storage::Cache::Key SharedMediaSliceCacheKey(
+	PeerId peerId,
+	Storage::SharedMediaType type);
 
 constexpr auto kImageCacheTag = uint8(0x01);
 constexpr auto kStickerCacheTag = uint8(0x02);
@@ -28,6 +28,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "ui/text/text_utilities.h"
 #include "ui/ui_utility.h"
 #include "apiwrap.h"
+#include "base/options.h"
 #include "styles/style_chat.h"
 #include "styles/style_chat_helpers.h"
 
@@ -35,12 +36,23 @@ namespace Data {
 namespace {
 
 constexpr auto kMaxPerRequest = 100;
+constexpr auto kInstancesMemoryBudget = int64(64 * 1024 * 1024);
+constexpr auto kEstimatedAnimatedFrames = 90;
+constexpr auto kLogCacheStatsPeriod = 60 * crl::time(1000);
 #if 0 // inject-to-on_main
 constexpr auto kUnsubscribeUpdatesDelay = 3 * crl::time(1000);
 #endif
 
 using SizeTag = CustomEmojiManager::SizeTag;
 
+base::options::toggle OptionLogCustomEmojiCache({
+	.id = kOptionLogCustomEmojiCache,
+	.name = "Log custom emoji cache",
+	.description = "Write to the log how many custom emoji instances "
+		"are kept in memory and how often they are reused.",
+	.restartRequired = true,
+});
+
 class CallbackListener final : public CustomEmojiManager::Listener {
 public:
 	explicit CallbackListener(Fn<void(not_null<DocumentData*>)> callback)
@@ -89,6 +101,18 @@ private:
 		: FrameSizeFromTag(tag);
 }
 
+// The frames are cached inside Ui::CustomEmoji::Instance,
+// so their size can only be estimated from the frame size.
+[[nodiscard]] int64 EstimateInstanceBytes(
+		not_null<DocumentData*> document,
+		int frameSize) {
+	const auto sticker = document->sticker();
+	const auto frames = (sticker && sticker->type == StickerType::Webp)
+		? 1
+		: kEstimatedAnimatedFrames;
+	return int64(frameSize) * frameSize * 4 * frames;
+}
+
 [[nodiscard]] QString InternalPrefix() {
 	return u"internal:"_q;
 }
@@ -103,6 +127,8 @@ private:
 
 } // namespace
 
+const char kOptionLogCustomEmojiCache[] = "log-custom-emoji-cache";
+
 class CustomEmojiLoader final
 	: public Ui::CustomEmoji::Loader
 	, public base::has_weak_ptr {
@@ -430,9 +456,84 @@ Ui::CustomEmoji::Preview CustomEmojiLoader::preview() {
 	return {};
 }
 
+class CustomEmojiManager::TrackedEmoji final
+	: public Ui::Text::CustomEmoji {
+public:
+	TrackedEmoji(
+		not_null<CustomEmojiManager*> manager,
+		SizeTag tag,
+		DocumentId documentId,
+		std::unique_ptr<Ui::Text::CustomEmoji> wrapped);
+	~TrackedEmoji();
+
+	int width() override;
+	QString entityData() override;
+	void paint(QPainter &p, const Context &context) override;
+	void unload() override;
+	bool ready() override;
+	bool readyInDefaultState() override;
+
+private:
+	std::unique_ptr<Ui::Text::CustomEmoji> _wrapped;
+	const base::weak_ptr<CustomEmojiManager> _manager;
+	const DocumentId _documentId = 0;
+	const SizeTag _tag = SizeTag();
+
+};
+
+CustomEmojiManager::TrackedEmoji::TrackedEmoji(
+	not_null<CustomEmojiManager*> manager,
+	SizeTag tag,
+	DocumentId documentId,
+	std::unique_ptr<Ui::Text::CustomEmoji> wrapped)
+: _wrapped(std::move(wrapped))
+, _manager(manager)
+, _documentId(documentId)
+, _tag(tag) {
+	manager->objectCreated(_tag, _documentId);
+}
+
+CustomEmojiManager::TrackedEmoji::~TrackedEmoji() {
+	// The object uses the instance, so destroy it first.
+	_wrapped = nullptr;
+	if (const auto strong = _manager.get()) {
+		strong->objectDestroyed(_tag, _documentId);
+	}
+}
+
+int CustomEmojiManager::TrackedEmoji::width() {
+	return _wrapped->width();
+}
+
+QString CustomEmojiManager::TrackedEmoji::entityData() {
+	return _wrapped->entityData();
+}
+
+void CustomEmojiManager::TrackedEmoji::paint(
+		QPainter &p,
+		const Context &context) {
+	_wrapped->paint(p, context);
+}
+
+void CustomEmojiManager::TrackedEmoji::unload() {
+	_wrapped->unload();
+}
+
+bool CustomEmojiManager::TrackedEmoji::ready() {
+	return _wrapped->ready();
+}
+
+bool CustomEmojiManager::TrackedEmoji::readyInDefaultState() {
+	return _wrapped->readyInDefaultState();
+}
+
 CustomEmojiManager::CustomEmojiManager(not_null<Session*> owner)
 : _owner(owner)
+, _logStatsTimer([=] { logCacheStats(); })
 , _repaintTimer([=] { invokeRepaints(); }) {
+	if (OptionLogCustomEmojiCache.value()) {
+		_logStatsTimer.callEach(kLogCacheStatsPeriod);
+	}
 	const auto appConfig = &owner->session().account().appConfig();
 	appConfig->value(
 	) | rpl::take_while([=] {
@@ -466,24 +567,120 @@ std::unique_ptr<Ui::Text::CustomEmoji> CustomEmojiManager::create(
 			repaintLater(instance, request);
 		};
 		auto [loader, setId, colored] = factory();
-		i = instances.emplace(
-			documentId,
-			std::make_unique<Ui::CustomEmoji::Instance>(Loading{
+		const auto bytes = EstimateInstanceBytes(
+			_owner->document(documentId),
+			FrameSizeFromTag(tag, sizeOverride));
+		i = instances.emplace(documentId, InstanceEntry{
+			.instance = std::make_unique<Ui::CustomEmoji::Instance>(Loading{
 				std::move(loader),
 				prepareNonExactPreview(documentId, tag, sizeOverride)
-			}, std::move(repaint))).first;
+			}, std::move(repaint)),
+			.bytes = bytes,
+		}).first;
 		if (colored) {
-			i->second->setColored();
+			i->second.instance->setColored();
 		}
-	} else if (!i->second->hasImagePreview()) {
-		auto preview = prepareNonExactPreview(documentId, tag, sizeOverride);
-		if (preview.isImage()) {
-			i->second->updatePreview(std::move(preview));
+		++_stats.misses;
+		++_stats.resident;
+		_stats.residentBytes += bytes;
+	} else {
+		++_stats.hits;
+		if (!i->second.instance->hasImagePreview()) {
+			auto preview = prepareNonExactPreview(
+				documentId,
+				tag,
+				sizeOverride);
+			if (preview.isImage()) {
+				i->second.instance->updatePreview(std::move(preview));
+			}
 		}
 	}
-	return std::make_unique<Ui::CustomEmoji::Object>(
-		i->second.get(),
-		std::move(update));
+	return std::make_unique<TrackedEmoji>(
+		this,
+		tag,
+		documentId,
+		std::make_unique<Ui::CustomEmoji::Object>(
+			i->second.instance.get(),
+			std::move(update)));
+}
+
+void CustomEmojiManager::objectCreated(SizeTag tag, DocumentId documentId) {
+	auto &instances = _instances[SizeIndex(tag)];
+	const auto i = instances.find(documentId);
+	Assert(i != end(instances));
+
+	++i->second.objects;
+	i->second.lastUsed = ++_instancesUsed;
+}
+
+void CustomEmojiManager::objectDestroyed(
+		SizeTag tag,
+		DocumentId documentId) {
+	auto &instances = _instances[SizeIndex(tag)];
+	const auto i = instances.find(documentId);
+	Assert(i != end(instances));
+	Assert(i->second.objects > 0);
+
+	i->second.lastUsed = ++_instancesUsed;
+	if (!--i->second.objects
+		&& _stats.residentBytes > kInstancesMemoryBudget) {
+		scheduleEviction();
+	}
+}
+
+void CustomEmojiManager::scheduleEviction() {
+	if (_evictionScheduled) {
+		return;
+	}
+	// Objects may be destroyed while their instance is repainting.
+	_evictionScheduled = true;
+	Ui::PostponeCall(this, [=] {
+		_evictionScheduled = false;
+		evictUnused();
+	});
+}
+
+void CustomEmojiManager::evictUnused() {
+	struct Unused {
+		not_null<base::flat_map<DocumentId, InstanceEntry>*> instances;
+		DocumentId documentId = 0;
+		uint64 lastUsed = 0;
+	};
+	auto unused = std::vector<Unused>();
+	for (auto &instances : _instances) {
+		for (const auto &[documentId, entry] : instances) {
+			if (!entry.objects) {
+				unused.push_back({ &instances, documentId, entry.lastUsed });
+			}
+		}
+	}
+	ranges::sort(unused, ranges::less(), &Unused::lastUsed);
+
+	// Free a quarter of the budget at once to not evict on each object.
+	const auto till = kInstancesMemoryBudget - kInstancesMemoryBudget / 4;
+	auto evicted = 0;
+	for (const auto &entry : unused) {
+		if (_stats.residentBytes <= till) {
+			break;
+		}
+		const auto i = entry.instances->find(entry.documentId);
+		_stats.residentBytes -= i->second.bytes;
+		--_stats.resident;
+		++evicted;
+		entry.instances->erase(i);
+	}
+	_stats.evicted += evicted;
+}
+
+void CustomEmojiManager::logCacheStats() const {
+	const auto lookups = _stats.hits + _stats.misses;
+	LOG(("Custom Emoji: Resident %1 (%2 bytes), evicted %3, "
+		"hit rate %4% of %5."
+		).arg(_stats.resident
+		).arg(_stats.residentBytes
+		).arg(_stats.evicted
+		).arg(lookups ? (_stats.hits * 100 / lookups) : 0
+		).arg(lookups));
 }
 
 Ui::Text::CustomEmojiFactory CustomEmojiManager::factory(
@@ -506,7 +703,7 @@ Ui::CustomEmoji::Preview CustomEmojiManager::prepareNonExactPreview(
 		const auto j = other.find(documentId);
 		if (j == end(other)) {
 			continue;
-		} else if (const auto nonExact = j->second->imagePreview()) {
+		} else if (const auto nonExact = j->second.instance->imagePreview()) {
 			const auto size = FrameSizeFromTag(tag, sizeOverride);
 			return {
 				nonExact.image().scaled(
@@ -729,7 +926,7 @@ void CustomEmojiManager::fillColoredFlags(not_null<DocumentData*> document) {
 		for (auto &instances : _instances) {
 			const auto i = instances.find(id);
 			if (i != end(instances)) {
-				i->second->setColored();
+				i->second.instance->setColored();
 			}
 		}
 	}
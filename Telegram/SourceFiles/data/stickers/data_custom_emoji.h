@@ -21,6 +21,8 @@ namespace Data {
 class Session;
 class CustomEmojiLoader;
 
+extern const char kOptionLogCustomEmojiCache[];
+
 enum class CustomEmojiSizeTag : uchar {
 	Normal,
 	Large,
@@ -30,6 +32,14 @@ enum class CustomEmojiSizeTag : uchar {
 	kCount,
 };
 
+struct CustomEmojiCacheStats {
+	int64 hits = 0;
+	int64 misses = 0;
+	int64 evicted = 0;
+	int64 residentBytes = 0;
+	int resident = 0;
+};
+
 class CustomEmojiManager final : public base::has_weak_ptr {
 public:
 	using SizeTag = CustomEmojiSizeTag;
@@ -97,6 +107,8 @@ public:
 private:
 	static constexpr auto kSizeCount = int(SizeTag::kCount);
 
+	class TrackedEmoji;
+
 	struct InternalEmojiData {
 		QImage image;
 		bool textColor = true;
@@ -110,6 +122,12 @@ private:
 		uint64 setId = 0;
 		bool colored = false;
 	};
+	struct InstanceEntry {
+		std::unique_ptr<Ui::CustomEmoji::Instance> instance;
+		int64 bytes = 0;
+		uint64 lastUsed = 0;
+		int objects = 0;
+	};
 
 	[[nodiscard]] LoaderWithSetId createLoaderWithSetId(
 		not_null<DocumentData*> document,
@@ -148,13 +166,23 @@ private:
 		QStringView data);
 	[[nodiscard]] static int SizeIndex(SizeTag tag);
 
+	void objectCreated(SizeTag tag, DocumentId documentId);
+	void objectDestroyed(SizeTag tag, DocumentId documentId);
+	void scheduleEviction();
+	void evictUnused();
+	void logCacheStats() const;
+
 	const not_null<Session*> _owner;
 
+	// Instances are shared by all objects of the same emoji and size,
+	// the ones without objects are kept while they fit in the budget.
 	std::array<
-		base::flat_map<
-			DocumentId,
-			std::unique_ptr<Ui::CustomEmoji::Instance>>,
+		base::flat_map<DocumentId, InstanceEntry>,
 		kSizeCount> _instances;
+	CustomEmojiCacheStats _stats;
+	base::Timer _logStatsTimer;
+	uint64 _instancesUsed = 0;
+	bool _evictionScheduled = false;
 	std::array<
 		base::flat_map<
 			DocumentId,
@@ -0,0 +1,216 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "dialogs/dialogs_filter_search.h"
+
+#include "dialogs/dialogs_entry.h"
+#include "dialogs/dialogs_indexed_list.h"
+#include "dialogs/dialogs_row.h"
+
+#include <crl/crl_async.h>
+#include <crl/crl_on_main.h>
+
+namespace Dialogs {
+namespace {
+
+// Less candidates than that are matched right away on the main thread.
+constexpr auto kAsyncCandidates = 1000;
+
+// How often the background matching checks for cancellation.
+constexpr auto kCancelCheckEach = 256;
+
+// Each of the old words is a prefix of some of the new words,
+// so everything that matches the new words matched the old ones.
+[[nodiscard]] bool Extends(const QStringList &was, const QStringList &now) {
+	for (const auto &word : was) {
+		const auto extended = ranges::any_of(now, [&](const QString &other) {
+			return other.startsWith(word);
+		});
+		if (!extended) {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+FilterSearch::FilterSearch() = default;
+
+FilterSearch::~FilterSearch() {
+	cancel();
+}
+
+void FilterSearch::search(
+		const QStringList &words,
+		std::vector<not_null<IndexedList*>> lists) {
+	cancel();
+
+	const auto refine = canRefine(words, lists);
+	if (!refine) {
+		clear();
+		_lists = std::move(lists);
+	}
+	auto rows = collect(words, refine);
+	const auto total = ranges::accumulate(
+		rows,
+		0,
+		ranges::plus(),
+		[](const std::vector<not_null<Row*>> &list) {
+			return int(list.size());
+		});
+	if (total < kAsyncCandidates) {
+		auto found = Found();
+		found.reserve(rows.size());
+		for (const auto &list : rows) {
+			auto &keys = found.emplace_back();
+			for (const auto &row : list) {
+				const auto entry = row->entry();
+				if (IndexedList::Matches(entry->chatListNameWords(), words)) {
+					keys.push_back(row->key());
+				}
+			}
+		}
+		finish(words, std::move(found));
+		return;
+	}
+
+	// Name words are changed on the main thread, so take a snapshot.
+	auto candidates = Candidates();
+	candidates.reserve(rows.size());
+	for (const auto &list : rows) {
+		auto &snapshot = candidates.emplace_back();
+		snapshot.reserve(list.size());
+		for (const auto &row : list) {
+			snapshot.push_back({
+				.key = row->key(),
+				.nameWords = row->entry()->chatListNameWords(),
+			});
+		}
+	}
+	const auto cancelled = std::make_shared<std::atomic<bool>>(false);
+	_cancelled = cancelled;
+	crl::async([=, candidates = std::move(candidates)] {
+		auto found = Filter(candidates, words, *cancelled);
+		if (*cancelled) {
+			return;
+		}
+		crl::on_main(this, [=, found = std::move(found)]() mutable {
+			if (!*cancelled) {
+				_cancelled = nullptr;
+				finish(words, std::move(found));
+			}
+		});
+	});
+}
+
+void FilterSearch::cancel() {
+	if (const auto cancelled = base::take(_cancelled)) {
+		*cancelled = true;
+	}
+	_runningInvalidated = false;
+}
+
+void FilterSearch::clear() {
+	cancel();
+	_lists.clear();
+	_lastWords = QStringList();
+	_lastFound = Found();
+	_lastValid = false;
+}
+
+void FilterSearch::invalidate() {
+	_lastFound = Found();
+	_lastValid = false;
+
+	// The running search still delivers its results,
+	// but they were collected before the change.
+	_runningInvalidated = searching();
+}
+
+bool FilterSearch::searching() const {
+	return (_cancelled != nullptr);
+}
+
+rpl::producer<FilterSearchResult> FilterSearch::results() const {
+	return _results.events();
+}
+
+bool FilterSearch::canRefine(
+		const QStringList &words,
+		const std::vector<not_null<IndexedList*>> &lists) const {
+	return _lastValid
+		&& (_lists == lists)
+		&& Extends(_lastWords, words);
+}
+
+std::vector<std::vector<not_null<Row*>>> FilterSearch::collect(
+		const QStringList &words,
+		bool refine) const {
+	auto result = std::vector<std::vector<not_null<Row*>>>();
+	result.reserve(_lists.size());
+	for (auto i = 0, count = int(_lists.size()); i != count; ++i) {
+		const auto list = _lists[i];
+		if (!refine) {
+			result.push_back(list->candidates(words));
+			continue;
+		}
+		auto &rows = result.emplace_back();
+		rows.reserve(_lastFound[i].size());
+		for (const auto &key : _lastFound[i]) {
+			if (const auto row = list->getRow(key)) {
+				rows.push_back(row);
+			}
+		}
+	}
+	return result;
+}
+
+FilterSearch::Found FilterSearch::Filter(
+		const Candidates &candidates,
+		const QStringList &words,
+		const std::atomic<bool> &cancelled) {
+	auto result = Found();
+	result.reserve(candidates.size());
+	auto checked = 0;
+	for (const auto &list : candidates) {
+		auto &keys = result.emplace_back();
+		for (const auto &candidate : list) {
+			if (!(++checked % kCancelCheckEach) && cancelled) {
+				return result;
+			} else if (IndexedList::Matches(candidate.nameWords, words)) {
+				keys.push_back(candidate.key);
+			}
+		}
+	}
+	return result;
+}
+
+void FilterSearch::finish(QStringList words, Found found) {
+	auto result = FilterSearchResult{ .words = words };
+	result.rows.reserve(found.size());
+	for (auto i = 0, count = int(found.size()); i != count; ++i) {
+		auto &rows = result.rows.emplace_back();
+		rows.reserve(found[i].size());
+		for (const auto &key : found[i]) {
+			if (const auto row = _lists[i]->getRow(key)) {
+				rows.push_back(row);
+			}
+		}
+
+		// The chats could've been reordered since the previous search.
+		ranges::sort(rows, ranges::less(), [](not_null<Row*> row) {
+			return row->index();
+		});
+	}
+	_lastWords = std::move(words);
+	_lastFound = std::move(found);
+	_lastValid = !base::take(_runningInvalidated);
+	_results.fire(std::move(result));
+}
+
+} // namespace Dialogs
@@ -0,0 +1,85 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include "dialogs/dialogs_key.h"
+#include "base/weak_ptr.h"
+
+namespace Dialogs {
+
+class Row;
+class IndexedList;
+
+struct FilterSearchResult {
+	QStringList words;
+
+	// One vector for each of the searched lists, in the list order.
+	std::vector<std::vector<not_null<Row*>>> rows;
+};
+
+// Matches chat names against the search words for the chats list filter.
+//
+// When the query extends the previous one only the previously found
+// entries are checked again, until the lists or the names change. Large
+// candidate sets are matched in the background on a snapshot of the name
+// words, a newer query cancels the running one and only the latest
+// results are delivered.
+class FilterSearch final : public base::has_weak_ptr {
+public:
+	FilterSearch();
+	~FilterSearch();
+
+	void search(
+		const QStringList &words,
+		std::vector<not_null<IndexedList*>> lists);
+	void cancel();
+
+	// Forget the previous results, so the next search is a full one.
+	void clear();
+
+	// Chats were added to the lists or renamed, the next search should
+	// collect the candidates again. The lists themselves are still alive.
+	void invalidate();
+
+	[[nodiscard]] bool searching() const;
+	[[nodiscard]] rpl::producer<FilterSearchResult> results() const;
+
+private:
+	struct Candidate {
+		Key key;
+		base::flat_set<QString> nameWords;
+	};
+	using Candidates = std::vector<std::vector<Candidate>>;
+	using Found = std::vector<std::vector<Key>>;
+
+	[[nodiscard]] bool canRefine(
+		const QStringList &words,
+		const std::vector<not_null<IndexedList*>> &lists) const;
+	[[nodiscard]] std::vector<std::vector<not_null<Row*>>> collect(
+		const QStringList &words,
+		bool refine) const;
+	[[nodiscard]] static Found Filter(
+		const Candidates &candidates,
+		const QStringList &words,
+		const std::atomic<bool> &cancelled);
+
+	void finish(QStringList words, Found found);
+
+	std::vector<not_null<IndexedList*>> _lists;
+	QStringList _lastWords;
+	Found _lastFound;
+	bool _lastValid = false;
+	bool _runningInvalidated = false;
+
+	std::shared_ptr<std::atomic<bool>> _cancelled;
+
+	rpl::event_stream<FilterSearchResult> _results;
+
+};
+
+} // namespace Dialogs
@@ -12,6 +12,33 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "history/history.h"
 
 namespace Dialogs {
+namespace {
+
+[[nodiscard]] uint32 WordPrefix(const QString &word) {
+	Expects(word.size() > 1);
+
+	return (uint32(word[0].unicode()) << 16) | uint32(word[1].unicode());
+}
+
+[[nodiscard]] base::flat_set<uint32> NamePrefixes(Key key) {
+	auto result = base::flat_set<uint32>();
+	for (const auto &word : key.entry()->chatListNameWords()) {
+		if (word.size() > 1) {
+			result.emplace(WordPrefix(word));
+		}
+	}
+	return result;
+}
+
+void RemoveFromPrefix(std::vector<Key> &keys, Key key) {
+	const auto i = ranges::find(keys, key);
+	if (i != end(keys)) {
+		*i = keys.back();
+		keys.pop_back();
+	}
+}
+
+} // namespace
 
 IndexedList::IndexedList(SortMode sortMode, FilterId filterId)
 : _sortMode(sortMode)
@@ -33,6 +60,7 @@ RowsByLetter IndexedList::addToEnd(Key key) {
 		}
 		result.letters.emplace(ch, j->second.addToEnd(key));
 	}
+	indexNameWords(key);
 	return result;
 }
 
@@ -49,6 +77,7 @@ Row *IndexedList::addByName(Key key) {
 		}
 		j->second.addByName(key);
 	}
+	indexNameWords(key);
 	return result;
 }
 
@@ -127,6 +156,8 @@ void IndexedList::adjustByName(
 	const auto mainRow = _list.adjustByName(key);
 	if (!mainRow) return;
 
+	indexNameWords(key);
+
 	auto toRemove = oldLetters;
 	auto toAdd = base::flat_set<QChar>();
 	for (const auto &ch : key.entry()->chatListFirstLetters()) {
@@ -164,6 +195,8 @@ void IndexedList::adjustNames(
 	auto mainRow = _list.getRow(key);
 	if (!mainRow) return;
 
+	indexNameWords(key);
+
 	auto toRemove = oldLetters;
 	auto toAdd = base::flat_set<QChar>();
 	for (const auto &ch : key.entry()->chatListFirstLetters()) {
@@ -201,60 +234,153 @@ void IndexedList::remove(Key key, Row *replacedBy) {
 				it->second.remove(key, replacedBy);
 			}
 		}
+		removeNameWords(key);
 	}
 }
 
 void IndexedList::clear() {
 	_list.clear();
 	_index.clear();
+	_prefixes.clear();
+	_prefixesByKey.clear();
 }
 
-std::vector<not_null<Row*>> IndexedList::filtered(
-		const QStringList &words) const {
-	const auto minimal = [&]() -> const Dialogs::List* {
-		if (empty()) {
-			return nullptr;
+void IndexedList::enablePrefixIndex() {
+	if (_prefixIndexEnabled) {
+		return;
+	}
+	_prefixIndexEnabled = true;
+	for (const auto &row : _list) {
+		indexNameWords(row->key());
+	}
+}
+
+void IndexedList::indexNameWords(Key key) {
+	if (!_prefixIndexEnabled) {
+		return;
+	}
+	auto now = NamePrefixes(key);
+	auto &was = _prefixesByKey[key];
+	if (was == now) {
+		return;
+	}
+	for (const auto prefix : was) {
+		if (!now.contains(prefix)) {
+			const auto i = _prefixes.find(prefix);
+			if (i != end(_prefixes)) {
+				RemoveFromPrefix(i->second, key);
+				if (i->second.empty()) {
+					_prefixes.erase(i);
+				}
+			}
 		}
-		auto result = (const Dialogs::List*)nullptr;
-		for (const auto &word : words) {
-			if (word.isEmpty()) {
-				continue;
+	}
+	for (const auto prefix : now) {
+		if (!was.contains(prefix)) {
+			_prefixes[prefix].push_back(key);
+		}
+	}
+	was = std::move(now);
+}
+
+void IndexedList::removeNameWords(Key key) {
+	const auto i = _prefixesByKey.find(key);
+	if (i == end(_prefixesByKey)) {
+		return;
+	}
+	for (const auto prefix : i->second) {
+		const auto j = _prefixes.find(prefix);
+		if (j != end(_prefixes)) {
+			RemoveFromPrefix(j->second, key);
+			if (j->second.empty()) {
+				_prefixes.erase(j);
 			}
-			const auto found = filtered(word[0]);
-			if (!found || found->empty()) {
-				return nullptr;
-			} else if (!result || result->size() > found->size()) {
-				result = found;
+		}
+	}
+	_prefixesByKey.erase(i);
+}
+
+bool IndexedList::Matches(
+		const base::flat_set<QString> &nameWords,
+		const QStringList &words) {
+	const auto found = [&](const QString &word) {
+		for (const auto &name : nameWords) {
+			if (name.startsWith(word)) {
+				return true;
 			}
 		}
-		return result;
-	}();
+		return false;
+	};
+	for (const auto &word : words) {
+		if (!found(word)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+std::vector<not_null<Row*>> IndexedList::filtered(
+		const QStringList &words) const {
+	auto result = candidates(words);
+	result.erase(ranges::remove_if(result, [&](not_null<Row*> row) {
+		return !Matches(row->entry()->chatListNameWords(), words);
+	}), end(result));
+	return result;
+}
+
+std::vector<not_null<Row*>> IndexedList::candidates(
+		const QStringList &words) const {
 	auto result = std::vector<not_null<Row*>>();
-	if (!minimal || minimal->empty()) {
+	if (empty()) {
 		return result;
 	}
-	result.reserve(minimal->size());
-	for (const auto &row : *minimal) {
-		const auto &nameWords = row->entry()->chatListNameWords();
-		const auto found = [&](const QString &word) {
-			for (const auto &name : nameWords) {
-				if (name.startsWith(word)) {
-					return true;
-				}
+
+	// Choose the smallest candidates set: a first letter bucket for
+	// single letter words, a first two letters set for longer ones.
+	auto minimalList = (const Dialogs::List*)nullptr;
+	auto minimalKeys = (const std::vector<Key>*)nullptr;
+	auto minimalSize = std::numeric_limits<int>::max();
+	for (const auto &word : words) {
+		if (word.isEmpty()) {
+			continue;
+		} else if (word.size() > 1 && _prefixIndexEnabled) {
+			const auto i = _prefixes.find(WordPrefix(word));
+			if (i == end(_prefixes) || i->second.empty()) {
+				return result;
+			} else if (int(i->second.size()) < minimalSize) {
+				minimalSize = int(i->second.size());
+				minimalKeys = &i->second;
+				minimalList = nullptr;
 			}
-			return false;
-		};
-		const auto allFound = [&] {
-			for (const auto &word : words) {
-				if (!found(word)) {
-					return false;
-				}
+		} else {
+			const auto found = filtered(word[0]);
+			if (!found || found->empty()) {
+				return result;
+			} else if (found->size() < minimalSize) {
+				minimalSize = found->size();
+				minimalList = found;
+				minimalKeys = nullptr;
 			}
-			return true;
-		}();
-		if (allFound) {
+		}
+	}
+	if (!minimalList && !minimalKeys) {
+		return result;
+	}
+
+	result.reserve(minimalSize);
+	if (minimalList) {
+		for (const auto &row : *minimalList) {
 			result.push_back(row);
 		}
+	} else {
+		for (const auto &key : *minimalKeys) {
+			if (const auto row = _list.getRow(key)) {
+				result.push_back(row);
+			}
+		}
+		ranges::sort(result, ranges::less(), [](not_null<Row*> row) {
+			return row->index();
+		});
 	}
 	return result;
 }
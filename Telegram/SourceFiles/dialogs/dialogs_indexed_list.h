@@ -42,6 +42,9 @@ public:
 	void remove(Key key, Row *replacedBy = nullptr);
 	void clear();
 
+	// Only the lists searched with long queries need the words index.
+	void enablePrefixIndex();
+
 	[[nodiscard]] const List &all() const {
 		return _list;
 	}
@@ -52,6 +55,13 @@ public:
 	[[nodiscard]] std::vector<not_null<Row*>> filtered(
 		const QStringList &words) const;
 
+	// Rows that may match all the words, in the list order.
+	[[nodiscard]] std::vector<not_null<Row*>> candidates(
+		const QStringList &words) const;
+	[[nodiscard]] static bool Matches(
+		const base::flat_set<QString> &nameWords,
+		const QStringList &words);
+
 	// Part of List interface is duplicated here for all() list.
 	[[nodiscard]] int size() const { return all().size(); }
 	[[nodiscard]] bool empty() const { return all().empty(); }
@@ -90,12 +100,21 @@ private:
 		FilterId filterId,
 		not_null<History*> history,
 		const base::flat_set<QChar> &oldChars);
+	void indexNameWords(Key key);
+	void removeNameWords(Key key);
 
 	SortMode _sortMode = SortMode();
 	FilterId _filterId = 0;
 	List _list, _empty;
 	base::flat_map<QChar, List> _index;
 
+	// Keys by the first two letters of their name words, so that search
+	// checks only a small part of the first letter bucket. The keys in
+	// each group are unordered, candidates() restores the list order.
+	base::flat_map<uint32, std::vector<Key>> _prefixes;
+	std::map<Key, base::flat_set<uint32>> _prefixesByKey;
+	bool _prefixIndexEnabled = false;
+
 };
 
 } // namespace Dialogs
@@ -9,16 +9,19 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include "dialogs/dialogs_three_state_icon.h"
 #include "dialogs/ui/dialogs_layout.h"
+#include "dialogs/ui/dialogs_row_cache.h"
 #include "dialogs/ui/dialogs_stories_content.h"
 #include "dialogs/ui/dialogs_stories_list.h"
 #include "dialogs/ui/dialogs_video_userpic.h"
 #include "dialogs/dialogs_indexed_list.h"
+#include "dialogs/dialogs_filter_search.h"
 #include "dialogs/dialogs_widget.h"
 #include "dialogs/dialogs_search_from_controllers.h"
 #include "history/history.h"
 #include "history/history_item.h"
 #include "core/shortcuts.h"
 #include "core/application.h"
+#include "core/startup_trace.h"
 #include "ui/widgets/buttons.h"
 #include "ui/widgets/popup_menu.h"
 #include "ui/widgets/scroll_area.h"
@@ -144,12 +147,14 @@ InnerWidget::InnerWidget(
 , _controller(controller)
 , _shownList(controller->session().data().chatsList()->indexed())
 , _st(&st::defaultDialogRow)
+, _rowCache(std::make_unique<Ui::RowCache>())
 , _pinnedShiftAnimation([=](crl::time now) {
 	return pinnedShiftAnimationCallback(now);
 })
 , _narrowWidth(st::defaultDialogRow.padding.left()
 	+ st::defaultDialogRow.photoSize
 	+ st::defaultDialogRow.padding.left())
+, _filterSearch(std::make_unique<FilterSearch>())
 , _cancelSearchInChat(this, st::dialogsCancelSearchInPeer)
 , _cancelSearchFromUser(this, st::dialogsCancelSearchInPeer)
 , _childListShown(std::move(childListShown)) {
@@ -161,10 +166,17 @@ InnerWidget::InnerWidget(
 	style::PaletteChanged(
 	) | rpl::start_with_next([=] {
 		_topicJumpCache = nullptr;
+		_rowCache->clear();
+	}, lifetime());
+
+	_filterSearch->results(
+	) | rpl::start_with_next([=](FilterSearchResult &&results) {
+		applyFilterResults(std::move(results));
 	}, lifetime());
 
 	session().downloaderTaskFinished(
 	) | rpl::start_with_next([=] {
+		// Rows with userpics or media previews loading aren't cached.
 		update();
 	}, lifetime());
 
@@ -172,6 +184,7 @@ InnerWidget::InnerWidget(
 	) | rpl::start_with_next([=](Window::Notifications::ChangeType change) {
 		if (change == Window::Notifications::ChangeType::CountMessages) {
 			// Folder rows change their unread badge with this setting.
+			_rowCache->clear();
 			update();
 		}
 	}, lifetime());
@@ -195,6 +208,7 @@ InnerWidget::InnerWidget(
 	session().data().sendActionManager().animationUpdated(
 	) | rpl::start_with_next([=](
 			const Data::SendActionManager::AnimationUpdate &update) {
+		_rowCache->invalidate(update.thread);
 		const auto updateRect = Ui::RowPainter::SendActionAnimationRect(
 			_st,
 			update.left,
@@ -210,6 +224,7 @@ InnerWidget::InnerWidget(
 
 	session().data().sendActionManager().speakingAnimationUpdated(
 	) | rpl::start_with_next([=](not_null<History*> history) {
+		_rowCache->invalidate(history);
 		repaintDialogRowCornerStatus(history);
 	}, lifetime());
 
@@ -224,6 +239,19 @@ InnerWidget::InnerWidget(
 		refresh();
 	}, lifetime());
 
+	rpl::merge(
+		session().data().chatsListChanges() | rpl::to_empty,
+		session().changes().peerUpdates(
+			Data::PeerUpdate::Flag::Name
+			| Data::PeerUpdate::Flag::IsContact
+		) | rpl::to_empty,
+		session().changes().topicUpdates(
+			Data::TopicUpdate::Flag::Title
+		) | rpl::to_empty
+	) | rpl::start_with_next([=] {
+		_filterSearch->invalidate();
+	}, lifetime());
+
 	rpl::merge(
 		session().settings().archiveCollapsedChanges() | rpl::to_empty,
 		session().data().chatsFilters().changed()
@@ -241,6 +269,7 @@ InnerWidget::InnerWidget(
 		| Data::HistoryUpdate::Flag::ChatOccupied
 	) | rpl::start_with_next([=](const Data::HistoryUpdate &update) {
 		if (update.flags & Data::HistoryUpdate::Flag::IsPinned) {
+			_rowCache->invalidate(update.history);
 			stopReorderPinned();
 		}
 		if (update.flags & Data::HistoryUpdate::Flag::ChatOccupied) {
@@ -256,14 +285,19 @@ InnerWidget::InnerWidget(
 		| UpdateFlag::IsContact
 		| UpdateFlag::FullInfo
 		| UpdateFlag::EmojiStatus
+		| UpdateFlag::StoriesState
 	) | rpl::start_with_next([=](const Data::PeerUpdate &update) {
 		if (update.flags
 			& (UpdateFlag::Name
 				| UpdateFlag::Photo
 				| UpdateFlag::FullInfo
-				| UpdateFlag::EmojiStatus)) {
+				| UpdateFlag::EmojiStatus
+				| UpdateFlag::StoriesState)) {
 			const auto peer = update.peer;
 			const auto history = peer->owner().historyLoaded(peer);
+			if (history) {
+				_rowCache->invalidate(history);
+			}
 			if (_state == WidgetState::Default) {
 				if (history) {
 					updateDialogRow({ history, FullMsgId() });
@@ -282,6 +316,7 @@ InnerWidget::InnerWidget(
 	session().changes().messageUpdates(
 		Data::MessageUpdate::Flag::DialogRowRefresh
 	) | rpl::start_with_next([=](const Data::MessageUpdate &update) {
+		_rowCache->invalidate(update.item->history());
 		refreshDialogRow({ update.item->history(), update.item->fullId() });
 	}, lifetime());
 
@@ -290,6 +325,7 @@ InnerWidget::InnerWidget(
 		| Data::EntryUpdate::Flag::Height
 	) | rpl::start_with_next([=](const Data::EntryUpdate &update) {
 		const auto entry = update.entry;
+		_rowCache->invalidate(entry);
 		if (update.flags & Data::EntryUpdate::Flag::Height) {
 			if (updateEntryHeight(entry)) {
 				refresh();
@@ -534,13 +570,21 @@ void InnerWidget::changeOpenedForum(Data::Forum *forum) {
 	refreshShownList();
 
 	_openedForumLifetime.destroy();
+	_filterSearch->clear();
 	if (forum) {
 		rpl::merge(
 			forum->chatsListChanges(),
 			forum->chatsListLoadedEvents()
 		) | rpl::start_with_next([=] {
+			_filterSearch->invalidate();
 			refresh();
 		}, _openedForumLifetime);
+
+		// The topics list is searched, don't touch it after destruction.
+		forum->destroyed(
+		) | rpl::start_with_next([=] {
+			_filterSearch->clear();
+		}, _openedForumLifetime);
 	}
 
 	refreshWithCollapsedRows(true);
@@ -609,7 +653,7 @@ void InnerWidget::paintEvent(QPaintEvent *e) {
 		context.topicJumpSelected = selected
 			&& _selectedTopicJump
 			&& (!_pressed || _pressedTopicJump);
-		Ui::RowPainter::Paint(p, row, validateVideoUserpic(row), context);
+		_rowCache->paint(p, row, validateVideoUserpic(row), context);
 	};
 	if (_state == WidgetState::Default) {
 		const auto collapsedSkip = collapsedRowsOffset();
@@ -688,6 +732,8 @@ void InnerWidget::paintEvent(QPaintEvent *e) {
 					top += row->height();
 				}
 
+				Core::StartupTrace::Finish("chats list painted");
+
 				// Paint the dragged chat above all others.
 				if (reorderingRow) {
 					p.translate(0, reorderingRow->top() - top);
@@ -2280,30 +2326,13 @@ void InnerWidget::applyFilterUpdate(QString newFilter, bool force) {
 			_waitingForSearch = true;
 			_filterResults.clear();
 			_filterResultsGlobal.clear();
-			const auto append = [&](not_null<IndexedList*> list) {
-				const auto results = list->filtered(words);
-				auto top = filteredHeight();
-				auto i = _filterResults.insert(
-					end(_filterResults),
-					begin(results),
-					end(results));
-				for (const auto e = end(_filterResults); i != e; ++i) {
-					i->top = top;
-					i->row->recountHeight(_narrowRatio);
-					top += i->row->height();
-				}
-			};
+			if (force) {
+				_filterSearch->clear();
+			}
 			if (!_searchInChat && !_searchFromPeer && !words.isEmpty()) {
-				if (_openedForum) {
-					append(_openedForum->topicsList()->indexed());
-				} else {
-					append(session().data().chatsList()->indexed());
-					const auto id = Data::Folder::kId;
-					if (const auto add = session().data().folderLoaded(id)) {
-						append(add->chatsList()->indexed());
-					}
-					append(session().data().contactsNoChatsList());
-				}
+				_filterSearch->search(words, filterLists());
+			} else {
+				_filterSearch->cancel();
 			}
 			refresh(true);
 		}
@@ -2344,6 +2373,59 @@ void InnerWidget::onHashtagFilterUpdate(QStringView newFilter) {
 	clearMouseSelection(true);
 }
 
+std::vector<not_null<IndexedList*>> InnerWidget::filterLists() const {
+	if (_openedForum) {
+		return { _openedForum->topicsList()->indexed() };
+	}
+	auto result = std::vector<not_null<IndexedList*>>();
+	result.push_back(session().data().chatsList()->indexed());
+	const auto id = Data::Folder::kId;
+	if (const auto add = session().data().folderLoaded(id)) {
+		result.push_back(add->chatsList()->indexed());
+	}
+	result.push_back(session().data().contactsNoChatsList());
+	return result;
+}
+
+void InnerWidget::applyFilterResults(FilterSearchResult &&results) {
+	if (_state != WidgetState::Filtered
+		|| results.words.join(' ') != _filter) {
+		return;
+	}
+
+	// Server results could have been appended while we were searching,
+	// local ones go before them, skipping the ones already shown.
+	auto local = std::vector<FilterResult>();
+	for (const auto &rows : results.rows) {
+		for (const auto &row : rows) {
+			if (!_filterResultsGlobal.contains(row->key())) {
+				local.emplace_back(row);
+			}
+		}
+	}
+	if (local.empty()) {
+		return;
+	}
+	const auto added = int(local.size());
+	_filterResults.insert(
+		begin(_filterResults),
+		std::make_move_iterator(begin(local)),
+		std::make_move_iterator(end(local)));
+	auto top = 0;
+	for (auto &result : _filterResults) {
+		result.top = top;
+		result.row->recountHeight(_narrowRatio);
+		top += result.row->height();
+	}
+	if (_filteredSelected >= 0) {
+		_filteredSelected += added;
+	}
+	if (_filteredPressed >= 0) {
+		_filteredPressed += added;
+	}
+	refresh(true);
+}
+
 void InnerWidget::appendToFiltered(Key key) {
 	for (const auto &row : _filterResults) {
 		if (row.key() == key) {
@@ -2376,6 +2458,9 @@ void InnerWidget::trackSearchResultsHistory(not_null<History*> history) {
 	if (!_searchResultsHistories.emplace(history).second) {
 		return;
 	}
+	_searchResultsLifetime.add(
+		history->owner().histories().preventUnload(history));
+
 	const auto channel = history->peer->asChannel();
 	if (!channel || channel->isBroadcast()) {
 		return;
@@ -2941,6 +3026,7 @@ void InnerWidget::clearFilter() {
 			setState(WidgetState::Default);
 		}
 		_hashtagResults.clear();
+		_filterSearch->clear();
 		_filterResults.clear();
 		_filterResultsGlobal.clear();
 		_peerSearchResults.clear();
@@ -3623,6 +3709,7 @@ void InnerWidget::repaintDialogRowCornerStatus(not_null<History*> history) {
 }
 
 void InnerWidget::updateRowCornerStatusShown(not_null<History*> history) {
+	_rowCache->invalidate(history);
 	const auto repaint = [=] {
 		repaintDialogRowCornerStatus(history);
 	};
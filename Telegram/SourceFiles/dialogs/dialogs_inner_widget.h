@@ -50,6 +50,7 @@ using namespace ::Ui;
 class VideoUserpic;
 struct PaintContext;
 struct TopicJumpCache;
+class RowCache;
 } // namespace Dialogs::Ui
 
 namespace Dialogs {
@@ -57,6 +58,8 @@ namespace Dialogs {
 class Row;
 class FakeRow;
 class IndexedList;
+class FilterSearch;
+struct FilterSearchResult;
 
 struct ChosenRow {
 	Key key;
@@ -377,6 +380,9 @@ private:
 	void clearSearchResults(bool clearPeerSearchResults = true);
 	void updateSelectedRow(Key key = Key());
 	void trackSearchResultsHistory(not_null<History*> history);
+
+	[[nodiscard]] std::vector<not_null<IndexedList*>> filterLists() const;
+	void applyFilterResults(FilterSearchResult &&results);
 	void trackSearchResultsForum(Data::Forum *forum);
 
 	[[nodiscard]] QBrush currentBg() const;
@@ -412,6 +418,7 @@ private:
 	std::vector<std::unique_ptr<CollapsedRow>> _collapsedRows;
 	not_null<const style::DialogRow*> _st;
 	mutable std::unique_ptr<Ui::TopicJumpCache> _topicJumpCache;
+	const std::unique_ptr<Ui::RowCache> _rowCache;
 	int _collapsedSelected = -1;
 	int _collapsedPressed = -1;
 	bool _skipTopDialog = false;
@@ -443,6 +450,7 @@ private:
 	bool _hashtagDeleteSelected = false;
 	bool _hashtagDeletePressed = false;
 
+	const std::unique_ptr<FilterSearch> _filterSearch;
 	std::vector<FilterResult> _filterResults;
 	base::flat_map<Key, std::unique_ptr<Row>> _filterResultsGlobal;
 	int _filteredSelected = -1;
@@ -608,6 +608,13 @@ bool Row::topicJumpRipple() const {
 	return _topicJumpRipple != 0;
 }
 
+bool Row::animating() const {
+	return hasRipple()
+		|| topicJumpRipple()
+		|| (_cornerBadgeUserpic
+			&& !_cornerBadgeUserpic->layersManager.isFinished());
+}
+
 FakeRow::FakeRow(
 	Key searchInChat,
 	not_null<HistoryItem*> item,
@@ -67,6 +67,9 @@ public:
 		int y,
 		int outerWidth,
 		const QColor *colorOverride = nullptr) const;
+	[[nodiscard]] bool hasRipple() const {
+		return (_ripple != nullptr);
+	}
 
 	[[nodiscard]] Ui::PeerUserpicView &userpicView() const {
 		return _userpic;
@@ -116,6 +119,9 @@ public:
 	void clearTopicJumpRipple();
 	[[nodiscard]] bool topicJumpRipple() const;
 
+	// Ripples or corner badge animations are in progress.
+	[[nodiscard]] bool animating() const;
+
 	[[nodiscard]] Key key() const {
 		return _id;
 	}
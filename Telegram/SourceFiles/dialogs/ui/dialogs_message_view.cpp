@@ -222,6 +222,16 @@ void MessageView::prepare(
 	}
 }
 
+bool MessageView::loading() const {
+	return (_loadingContext != nullptr);
+}
+
+bool MessageView::animated() const {
+	return _spoiler
+		|| _textCache.hasPersistentAnimation()
+		|| _senderCache.hasPersistentAnimation();
+}
+
 bool MessageView::isInTopicJump(int x, int y) const {
 	return _topics && _topics->isInTopicJumpArea(x, y);
 }
@@ -62,6 +62,8 @@ public:
 		Data::Forum *forum,
 		Fn<void()> customEmojiRepaint,
 		ToPreviewOptions options);
+	[[nodiscard]] bool loading() const;
+	[[nodiscard]] bool animated() const;
 
 	void paint(
 		Painter &p,
@@ -0,0 +1,177 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "dialogs/ui/dialogs_row_cache.h"
+
+#include "dialogs/dialogs_row.h"
+#include "dialogs/ui/dialogs_layout.h"
+#include "dialogs/ui/dialogs_message_view.h"
+#include "history/history.h"
+#include "history/view/history_view_send_action.h"
+#include "base/unixtime.h"
+#include "ui/painter.h"
+
+namespace Dialogs::Ui {
+namespace {
+
+// A couple of screens of rows in a wide window on a HiDPI display.
+constexpr auto kMaxBytes = 24 * 1024 * 1024;
+
+[[nodiscard]] bool Loading(not_null<const Row*> row) {
+	const auto &userpic = row->userpicView().cloud;
+	const auto thread = row->thread();
+	return (userpic && userpic->isNull())
+		|| (thread && thread->lastItemDialogsView().loading());
+}
+
+} // namespace
+
+RowCache::RowCache() = default;
+
+RowCache::~RowCache() = default;
+
+void RowCache::paint(
+		Painter &p,
+		not_null<const Row*> row,
+		VideoUserpic *videoUserpic,
+		const PaintContext &context) {
+	if (!Cacheable(row, videoUserpic, context)) {
+		// Animated rows are painted directly, the layer painted before
+		// the animation may be outdated when it finishes.
+		const auto i = _layers.find(row);
+		if (i != end(_layers)) {
+			setFrame(i->second, QImage());
+			_layers.erase(i);
+		}
+		RowPainter::Paint(p, row, videoUserpic, context);
+		return;
+	}
+	auto i = _layers.find(row);
+	if (i == end(_layers)) {
+		i = _layers.emplace(row, Layer{ .key = row->key() }).first;
+	} else if (i->second.key != row->key()) {
+		setFrame(i->second, QImage());
+		i->second = Layer{ .key = row->key() };
+	}
+	auto &layer = i->second;
+	layer.used = ++_used;
+
+	if (layer.loading) {
+		// Rows with a userpic or a media preview still loading are
+		// painted directly, they're cached once everything is loaded.
+		RowPainter::Paint(p, row, nullptr, context);
+		layer.loading = Loading(row);
+		return;
+	}
+	const auto state = ComputeState(p, row, context);
+	if (!layer.valid || layer.state != state) {
+		render(layer, state, row, context);
+		if (Loading(row)) {
+			layer.loading = true;
+			layer.valid = false;
+		}
+	}
+	p.drawImage(0, 0, layer.frame);
+
+	while (_bytes > kMaxBytes && _layers.size() > 1) {
+		removeLeastRecentlyUsed(row);
+	}
+}
+
+void RowCache::invalidate(Key key) {
+	for (auto &[row, layer] : _layers) {
+		if (layer.key == key) {
+			layer.valid = false;
+		}
+	}
+}
+
+void RowCache::clear() {
+	_layers.clear();
+	_bytes = 0;
+}
+
+bool RowCache::Cacheable(
+		not_null<const Row*> row,
+		VideoUserpic *videoUserpic,
+		const PaintContext &context) {
+	const auto history = row->history();
+	const auto thread = row->thread();
+	return !videoUserpic
+		&& !row->animating()
+		&& !row->entry()->chatListPeerBadge().animated()
+		&& !context.topicsExpanded
+		&& !context.topicJumpSelected
+		&& !(history && history->isForum())
+		&& !(thread
+			&& (thread->sendActionPainter()->animating()
+				|| thread->lastItemDialogsView().animated()));
+}
+
+RowCache::State RowCache::ComputeState(
+		const Painter &p,
+		not_null<const Row*> row,
+		const PaintContext &context) {
+	return {
+		.st = context.st,
+		.badges = row->entry()->chatListBadgesState(),
+		.filter = context.filter,
+		.minute = base::unixtime::now() / 60,
+		.paletteVersion = uint32(style::PaletteVersion()),
+		.width = context.width,
+		.height = row->height(),
+		.active = context.active,
+		.selected = context.selected,
+		.inactive = p.inactive(),
+		.paused = context.paused,
+		.search = context.search,
+		.narrow = context.narrow,
+	};
+}
+
+void RowCache::render(
+		Layer &layer,
+		const State &state,
+		not_null<const Row*> row,
+		const PaintContext &context) {
+	const auto ratio = style::DevicePixelRatio();
+	const auto size = QSize(state.width, state.height) * ratio;
+	if (layer.frame.size() != size) {
+		auto frame = QImage(size, QImage::Format_ARGB32_Premultiplied);
+		frame.setDevicePixelRatio(ratio);
+		setFrame(layer, std::move(frame));
+	}
+	layer.frame.fill(Qt::transparent);
+	{
+		auto q = Painter(&layer.frame);
+		q.setInactive(state.inactive);
+		RowPainter::Paint(q, row, nullptr, context);
+	}
+	layer.state = state;
+	layer.valid = true;
+}
+
+void RowCache::setFrame(Layer &layer, QImage frame) {
+	_bytes -= layer.frame.sizeInBytes();
+	layer.frame = std::move(frame);
+	_bytes += layer.frame.sizeInBytes();
+}
+
+void RowCache::removeLeastRecentlyUsed(not_null<const Row*> except) {
+	const auto i = ranges::min_element(_layers, ranges::less(), [&](
+			const auto &pair) {
+		return (pair.first == except)
+			? std::numeric_limits<uint64>::max()
+			: pair.second.used;
+	});
+	if (i != end(_layers) && i->first != except) {
+		setFrame(i->second, QImage());
+		_layers.erase(i);
+	}
+}
+
+} // namespace Dialogs::Ui
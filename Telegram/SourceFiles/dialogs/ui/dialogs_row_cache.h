@@ -0,0 +1,105 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include "dialogs/dialogs_entry.h"
+#include "dialogs/dialogs_key.h"
+
+class Painter;
+
+namespace style {
+struct DialogRow;
+} // namespace style
+
+namespace Dialogs {
+class Row;
+} // namespace Dialogs
+
+namespace Dialogs::Ui {
+
+class VideoUserpic;
+struct PaintContext;
+
+// Keeps painted rows of the chats list as images, so that scrolling
+// through the list doesn't layout names, previews and badges again.
+//
+// Images are kept for the recently painted rows within a memory limit and
+// are invalidated by the owner through invalidate() / clear() when
+// the row contents change (Data::Changes notifications and similar).
+// Rows with animated content, like custom emoji, spoilers or emoji
+// statuses, and rows with userpics or previews still loading are
+// painted directly instead.
+class RowCache final {
+public:
+	RowCache();
+	~RowCache();
+
+	void paint(
+		Painter &p,
+		not_null<const Row*> row,
+		VideoUserpic *videoUserpic,
+		const PaintContext &context);
+
+	void invalidate(Key key);
+	void clear();
+
+private:
+	struct State {
+		const style::DialogRow *st = nullptr;
+		BadgesState badges;
+		FilterId filter = 0;
+		TimeId minute = 0;
+		uint32 paletteVersion = 0;
+		int width = 0;
+		int height = 0;
+		bool active : 1 = false;
+		bool selected : 1 = false;
+		bool inactive : 1 = false;
+		bool paused : 1 = false;
+		bool search : 1 = false;
+		bool narrow : 1 = false;
+
+		friend inline bool operator==(
+			const State &a,
+			const State &b) = default;
+	};
+	struct Layer {
+		Key key;
+		State state;
+		QImage frame;
+		uint64 used = 0;
+		bool loading = false;
+		bool valid = false;
+	};
+
+	[[nodiscard]] static bool Cacheable(
+		not_null<const Row*> row,
+		VideoUserpic *videoUserpic,
+		const PaintContext &context);
+	[[nodiscard]] static State ComputeState(
+		const Painter &p,
+		not_null<const Row*> row,
+		const PaintContext &context);
+
+	void render(
+		Layer &layer,
+		const State &state,
+		not_null<const Row*> row,
+		const PaintContext &context);
+	void setFrame(Layer &layer, QImage frame);
+	void removeLeastRecentlyUsed(not_null<const Row*> except);
+
+	// Row pointers are never dereferenced, rows destroyed and created
+	// at the same address are detected by comparing the row keys.
+	base::flat_map<not_null<const Row*>, Layer> _layers;
+	int64 _bytes = 0;
+	uint64 _used = 0;
+
+};
+
+} // namespace Dialogs::Ui
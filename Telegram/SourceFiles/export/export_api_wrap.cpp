@@ -11,6 +11,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "export/data/export_data_types.h"
 #include "export/output/export_output_result.h"
 #include "export/output/export_output_file.h"
+#include "export/output/export_output_journal.h"
+#include "export/output/export_output_stats.h"
 #include "mtproto/mtproto_response.h"
 #include "base/bytes.h"
 #include "base/random.h"
@@ -22,8 +24,9 @@ namespace {
 
 constexpr auto kUserpicsSliceLimit = 100;
 constexpr auto kFileChunkSize = 128 * 1024;
-constexpr auto kFileRequestsCount = 2;
-//constexpr auto kFileNextRequestDelay = crl::time(20);
+constexpr auto kFileRequestsCount = 8;
+constexpr auto kFileRequestsLimit = 8;
+constexpr auto kFileBytesLimit = 4 * 1024 * 1024;
 constexpr auto kChatsSliceLimit = 100;
 constexpr auto kMessagesSliceLimit = 100;
 constexpr auto kTopPeerSliceLimit = 100;
@@ -32,6 +35,13 @@ constexpr auto kLocationCacheSize = 100'000;
 constexpr auto kMaxEmojiPerRequest = 100;
 constexpr auto kStoriesSliceLimit = 100;
 
+// Following chats are loaded in advance, with up to kPrefetchChatsMax
+// chats having requests in flight. Slow responses (flood waits are
+// handled by resending the request later) halve the in flight limit.
+constexpr auto kPrefetchChatsMax = 4;
+constexpr auto kPrefetchChatsAhead = 16;
+constexpr auto kPrefetchSlowResponse = crl::time(2000);
+
 struct LocationKey {
 	uint64 type;
 	uint64 id;
@@ -39,6 +49,9 @@ struct LocationKey {
 	inline bool operator<(const LocationKey &other) const {
 		return std::tie(type, id) < std::tie(other.type, other.id);
 	}
+	inline bool operator==(const LocationKey &other) const {
+		return std::tie(type, id) == std::tie(other.type, other.id);
+	}
 };
 
 LocationKey ComputeLocationKey(const Data::FileLocation &value) {
@@ -66,6 +79,20 @@ LocationKey ComputeLocationKey(const Data::FileLocation &value) {
 	return result;
 }
 
+[[nodiscard]] bool SameFileOrigin(
+		const Data::FileOrigin &a,
+		const Data::FileOrigin &b) {
+	return (a.split == b.split)
+		&& (a.messageId == b.messageId)
+		&& (a.storyId == b.storyId)
+		&& (a.customEmojiId == b.customEmojiId);
+}
+
+Output::JournalFileKey JournalKey(const Data::FileLocation &value) {
+	const auto key = ComputeLocationKey(value);
+	return { .type = key.type, .id = key.id };
+}
+
 Settings::Type SettingsFromDialogsType(Data::DialogInfo::Type type) {
 	using DialogType = Data::DialogInfo::Type;
 	switch (type) {
@@ -87,6 +114,18 @@ Settings::Type SettingsFromDialogsType(Data::DialogInfo::Type type) {
 	return Settings::Type(0);
 }
 
+[[nodiscard]] int MessagesCount(const MTPmessages_Messages &result) {
+	return result.match([](const MTPDmessages_messages &data) {
+		return int(data.vmessages().v.size());
+	}, [](const MTPDmessages_messagesSlice &data) {
+		return data.vcount().v;
+	}, [](const MTPDmessages_channelMessages &data) {
+		return data.vcount().v;
+	}, [](const MTPDmessages_messagesNotModified &data) {
+		return -1;
+	});
+}
+
 } // namespace
 
 class ApiWrap::LoadedFileCache {
@@ -177,12 +216,15 @@ struct ApiWrap::FileProcess {
 	struct Request {
 		int64 offset = 0;
 		QByteArray bytes;
+		mtpRequestId requestId = 0;
 	};
 	std::deque<Request> requests;
-	mtpRequestId requestId = 0;
+	mtpRequestId referenceRequestId = 0;
 };
 
 struct ApiWrap::FileProgress {
+	uint64 randomId = 0;
+	QString path;
 	int64 ready = 0;
 	int64 total = 0;
 };
@@ -228,6 +270,32 @@ struct ApiWrap::ChatProcess {
 	int fileIndex = 0;
 };
 
+struct ApiWrap::MessagesPrefetch {
+	struct Key {
+		PeerId peerId = 0;
+		int splitIndex = 0;
+		int offsetId = 0;
+		int addOffset = 0;
+		int limit = 0;
+		bool onlyMyMessages = false;
+
+		friend inline auto operator<=>(const Key &, const Key &) = default;
+		friend inline bool operator==(const Key &, const Key &) = default;
+	};
+	struct Entry {
+		std::optional<MTPmessages_Messages> result;
+		FnMut<void(MTPmessages_Messages&&)> waiting;
+		crl::time sent = 0;
+	};
+
+	std::vector<Data::DialogInfo> dialogs;
+	base::flat_map<PeerId, int> indices;
+	std::map<Key, Entry> entries;
+	int current = -1;
+	int next = 0;
+	int active = 0;
+	int limit = kPrefetchChatsMax;
+};
 
 template <typename Request>
 class ApiWrap::RequestBuilder {
@@ -367,11 +435,13 @@ auto ApiWrap::splitRequest(int index, Request &&request) {
 		std::forward<Request>(request)));
 }
 
-auto ApiWrap::fileRequest(const Data::FileLocation &location, int64 offset) {
+auto ApiWrap::fileRequest(
+		uint64 randomId,
+		const Data::FileLocation &location,
+		int64 offset) {
 	Expects(location.dcId != 0
 		|| location.data.type() == mtpc_inputTakeoutFileLocation);
 	Expects(_takeoutId.has_value());
-	Expects(_fileProcess->requestId == 0);
 
 	return std::move(_mtp.request(MTPInvokeWithTakeout<MTPupload_GetFile>(
 		MTP_long(*_takeoutId),
@@ -381,11 +451,23 @@ auto ApiWrap::fileRequest(const Data::FileLocation &location, int64 offset) {
 			MTP_long(offset),
 			MTP_int(kFileChunkSize))
 	)).fail([=](const MTP::Error &result) {
-		_fileProcess->requestId = 0;
+		const auto process = fileProcess(randomId);
+		if (!process) {
+			return;
+		}
+		using Request = FileProcess::Request;
+		const auto i = ranges::find(
+			process->requests,
+			offset,
+			[](const Request &request) { return request.offset; });
+		Assert(i != end(process->requests));
+		i->requestId = 0;
+
 		if (result.type() == u"TAKEOUT_FILE_EMPTY"_q
 			&& _otherDataProcess != nullptr) {
 			filePartDone(
-				0,
+				randomId,
+				offset,
 				MTP_upload_file(
 					MTP_storage_filePartial(),
 					MTP_int(0),
@@ -393,10 +475,10 @@ auto ApiWrap::fileRequest(const Data::FileLocation &location, int64 offset) {
 		} else if (result.type() == u"LOCATION_INVALID"_q
 			|| result.type() == u"VERSION_INVALID"_q
 			|| result.type() == u"LOCATION_NOT_AVAILABLE"_q) {
-			filePartUnavailable();
+			filePartUnavailable(randomId);
 		} else if (result.code() == 400
 			&& result.type().startsWith(u"FILE_REFERENCE_"_q)) {
-			filePartRefreshReference(offset);
+			filePartRefreshReference(randomId, offset);
 		} else {
 			error(std::move(result));
 		}
@@ -404,7 +486,8 @@ auto ApiWrap::fileRequest(const Data::FileLocation &location, int64 offset) {
 }
 
 ApiWrap::ApiWrap(QPointer<MTP::Instance> weak, Fn<void(FnMut<void()>)> runner)
-: _mtp(weak, std::move(runner))
+: _mtp(weak, runner)
+, _runner(std::move(runner))
 , _fileCache(std::make_unique<LoadedFileCache>(kLocationCacheSize)) {
 }
 
@@ -447,10 +530,24 @@ void ApiWrap::startExport(
 		}
 	}
 	startMainSession([=] {
-		sendNextStartRequest();
+		if (startJournal()) {
+			sendNextStartRequest();
+		}
 	});
 }
 
+bool ApiWrap::startJournal() {
+	Expects(_settings != nullptr);
+	Expects(_selfId.has_value());
+
+	_journal = std::make_unique<Output::Journal>(_settings->path, *_settings);
+	if (const auto result = _journal->start(_selfId->bare); !result) {
+		ioError(result);
+		return false;
+	}
+	return true;
+}
+
 void ApiWrap::sendNextStartRequest() {
 	Expects(_startProcess != nullptr);
 
@@ -732,6 +829,11 @@ void ApiWrap::requestOtherData(
 	_otherDataProcess->done = std::move(done);
 	_otherDataProcess->file.location.data = MTP_inputTakeoutFileLocation();
 	_otherDataProcess->file.suggestedPath = suggestedPath;
+	if (writePreloadedFile(_otherDataProcess->file, Data::FileOrigin())) {
+		const auto relativePath = _otherDataProcess->file.relativePath;
+		otherDataDone(relativePath);
+		return;
+	}
 	loadFile(
 		_otherDataProcess->file,
 		Data::FileOrigin(),
@@ -817,16 +919,21 @@ void ApiWrap::loadNextUserpic() {
 	for (auto &list = _userpicsProcess->slice->list
 		; _userpicsProcess->fileIndex < list.size()
 		; ++_userpicsProcess->fileIndex) {
-		const auto ready = processFileLoad(
-			list[_userpicsProcess->fileIndex].image.file,
+		const auto index = _userpicsProcess->fileIndex;
+		const auto state = processFileLoad(
+			list[index].image.file,
 			Data::FileOrigin(),
-			[=](FileProgress value) { return loadUserpicProgress(value); },
-			[=](const QString &path) { loadUserpicDone(path); });
-		if (!ready) {
+			[=](FileProgress value) {
+				return loadUserpicProgress(index, value);
+			},
+			[=](const QString &path) { loadUserpicDone(index, path); });
+		if (state == FileLoadState::Wait) {
 			return;
 		}
 	}
-	finishUserpicsSlice();
+	if (_fileProcesses.empty()) {
+		finishUserpicsSlice();
+	}
 }
 
 void ApiWrap::finishUserpicsSlice() {
@@ -856,30 +963,26 @@ void ApiWrap::finishUserpicsSlice() {
 	}).send();
 }
 
-bool ApiWrap::loadUserpicProgress(FileProgress progress) {
-	Expects(_fileProcess != nullptr);
+bool ApiWrap::loadUserpicProgress(int index, FileProgress progress) {
 	Expects(_userpicsProcess != nullptr);
 	Expects(_userpicsProcess->slice.has_value());
-	Expects((_userpicsProcess->fileIndex >= 0)
-		&& (_userpicsProcess->fileIndex
-			< _userpicsProcess->slice->list.size()));
+	Expects((index >= 0)
+		&& (index < _userpicsProcess->slice->list.size()));
 
 	return _userpicsProcess->fileProgress(DownloadProgress{
-		_fileProcess->randomId,
-		_fileProcess->relativePath,
-		_userpicsProcess->fileIndex,
+		progress.randomId,
+		progress.path,
+		index,
 		progress.ready,
 		progress.total });
 }
 
-void ApiWrap::loadUserpicDone(const QString &relativePath) {
+void ApiWrap::loadUserpicDone(int index, const QString &relativePath) {
 	Expects(_userpicsProcess != nullptr);
 	Expects(_userpicsProcess->slice.has_value());
-	Expects((_userpicsProcess->fileIndex >= 0)
-		&& (_userpicsProcess->fileIndex
-			< _userpicsProcess->slice->list.size()));
+	Expects((index >= 0)
+		&& (index < _userpicsProcess->slice->list.size()));
 
-	const auto index = _userpicsProcess->fileIndex;
 	auto &file = _userpicsProcess->slice->list[index].image.file;
 	file.relativePath = relativePath;
 	if (relativePath.isEmpty()) {
@@ -950,31 +1053,36 @@ void ApiWrap::loadNextStory() {
 	for (auto &list = _storiesProcess->slice->list
 		; _storiesProcess->fileIndex < list.size()
 		; ++_storiesProcess->fileIndex) {
-		auto &story = list[_storiesProcess->fileIndex];
+		const auto index = _storiesProcess->fileIndex;
+		auto &story = list[index];
 		const auto origin = Data::FileOrigin{ .storyId = story.id };
-		const auto ready = processFileLoad(
+		const auto state = processFileLoad(
 			story.file(),
 			origin,
-			[=](FileProgress value) { return loadStoryProgress(value); },
-			[=](const QString &path) { loadStoryDone(path); });
-		if (!ready) {
+			[=](FileProgress value) {
+				return loadStoryProgress(index, value);
+			},
+			[=](const QString &path) { loadStoryDone(index, path); });
+		if (state == FileLoadState::Wait) {
 			return;
 		}
 		const auto thumbProgress = [=](FileProgress value) {
-			return loadStoryThumbProgress(value);
+			return loadStoryThumbProgress(index, value);
 		};
-		const auto thumbReady = processFileLoad(
+		const auto thumbState = processFileLoad(
 			story.thumb().file,
 			origin,
 			thumbProgress,
-			[=](const QString &path) { loadStoryThumbDone(path); },
+			[=](const QString &path) { loadStoryThumbDone(index, path); },
 			nullptr,
 			&story);
-		if (!thumbReady) {
+		if (thumbState == FileLoadState::Wait) {
 			return;
 		}
 	}
-	finishStoriesSlice();
+	if (_fileProcesses.empty()) {
+		finishStoriesSlice();
+	}
 }
 
 void ApiWrap::finishStoriesSlice() {
@@ -1003,30 +1111,26 @@ void ApiWrap::finishStoriesSlice() {
 	}).send();
 }
 
-bool ApiWrap::loadStoryProgress(FileProgress progress) {
-	Expects(_fileProcess != nullptr);
+bool ApiWrap::loadStoryProgress(int index, FileProgress progress) {
 	Expects(_storiesProcess != nullptr);
 	Expects(_storiesProcess->slice.has_value());
-	Expects((_storiesProcess->fileIndex >= 0)
-		&& (_storiesProcess->fileIndex
-			< _storiesProcess->slice->list.size()));
+	Expects((index >= 0)
+		&& (index < _storiesProcess->slice->list.size()));
 
 	return _storiesProcess->fileProgress(DownloadProgress{
-		_fileProcess->randomId,
-		_fileProcess->relativePath,
-		_storiesProcess->fileIndex,
+		progress.randomId,
+		progress.path,
+		index,
 		progress.ready,
 		progress.total });
 }
 
-void ApiWrap::loadStoryDone(const QString &relativePath) {
+void ApiWrap::loadStoryDone(int index, const QString &relativePath) {
 	Expects(_storiesProcess != nullptr);
 	Expects(_storiesProcess->slice.has_value());
-	Expects((_storiesProcess->fileIndex >= 0)
-		&& (_storiesProcess->fileIndex
-			< _storiesProcess->slice->list.size()));
+	Expects((index >= 0)
+		&& (index < _storiesProcess->slice->list.size()));
 
-	const auto index = _storiesProcess->fileIndex;
 	auto &file = _storiesProcess->slice->list[index].file();
 	file.relativePath = relativePath;
 	if (relativePath.isEmpty()) {
@@ -1035,18 +1139,16 @@ void ApiWrap::loadStoryDone(const QString &relativePath) {
 	loadNextStory();
 }
 
-bool ApiWrap::loadStoryThumbProgress(FileProgress progress) {
-	return loadStoryProgress(progress);
+bool ApiWrap::loadStoryThumbProgress(int index, FileProgress progress) {
+	return loadStoryProgress(index, progress);
 }
 
-void ApiWrap::loadStoryThumbDone(const QString &relativePath) {
+void ApiWrap::loadStoryThumbDone(int index, const QString &relativePath) {
 	Expects(_storiesProcess != nullptr);
 	Expects(_storiesProcess->slice.has_value());
-	Expects((_storiesProcess->fileIndex >= 0)
-		&& (_storiesProcess->fileIndex
-			< _storiesProcess->slice->list.size()));
+	Expects((index >= 0)
+		&& (index < _storiesProcess->slice->list.size()));
 
-	const auto index = _storiesProcess->fileIndex;
 	auto &file = _storiesProcess->slice->list[index].thumb().file;
 	file.relativePath = relativePath;
 	if (relativePath.isEmpty()) {
@@ -1155,9 +1257,213 @@ void ApiWrap::requestMessages(
 	_chatProcess->handleSlice = std::move(slice);
 	_chatProcess->done = std::move(done);
 
+	if (_messagesPrefetch) {
+		advanceMessagesPrefetch(info.peerId);
+	}
 	requestMessagesCount(0);
 }
 
+void ApiWrap::prefetchMessages(const Data::DialogsInfo &dialogs) {
+	Expects(_settings != nullptr);
+
+	if (_settings->onlySinglePeer()) {
+		return;
+	}
+	_messagesPrefetch = std::make_unique<MessagesPrefetch>();
+	auto &list = _messagesPrefetch->dialogs;
+	list.reserve(dialogs.chats.size() + dialogs.left.size());
+	list.insert(end(list), begin(dialogs.chats), end(dialogs.chats));
+	list.insert(end(list), begin(dialogs.left), end(dialogs.left));
+	for (auto i = 0, count = int(list.size()); i != count; ++i) {
+		_messagesPrefetch->indices.emplace(list[i].peerId, i);
+	}
+}
+
+void ApiWrap::advanceMessagesPrefetch(PeerId peerId) {
+	Expects(_messagesPrefetch != nullptr);
+
+	auto &prefetch = *_messagesPrefetch;
+	const auto i = prefetch.indices.find(peerId);
+	if (i == end(prefetch.indices)) {
+		return;
+	}
+	prefetch.current = i->second;
+	prefetch.next = std::max(prefetch.next, prefetch.current + 1);
+
+	// Forget everything loaded for the chats that are already exported.
+	for (auto j = begin(prefetch.entries); j != end(prefetch.entries);) {
+		const auto index = prefetch.indices.find(j->first.peerId);
+		if (index == end(prefetch.indices)
+			|| index->second < prefetch.current) {
+			j = prefetch.entries.erase(j);
+		} else {
+			++j;
+		}
+	}
+	startMessagesPrefetch();
+}
+
+void ApiWrap::startMessagesPrefetch() {
+	Expects(_messagesPrefetch != nullptr);
+
+	auto &prefetch = *_messagesPrefetch;
+	while (prefetch.active < prefetch.limit
+		&& prefetch.current >= 0
+		&& prefetch.next < int(prefetch.dialogs.size())
+		&& prefetch.next <= prefetch.current + kPrefetchChatsAhead) {
+		++prefetch.active;
+		prefetchChatSplit(prefetch.next++, 0);
+	}
+}
+
+void ApiWrap::prefetchChatSplit(int index, int localSplitIndex) {
+	if (!_messagesPrefetch) {
+		return;
+	}
+	auto &prefetch = *_messagesPrefetch;
+	const auto &info = prefetch.dialogs[index];
+	if (localSplitIndex >= info.splits.size()
+		|| index < prefetch.current) {
+		--prefetch.active;
+		startMessagesPrefetch();
+		return;
+	}
+
+	// The same requests as requestMessagesCount() and the first
+	// requestMessagesSlice() do, so that they find the results here.
+	const auto splitIndex = info.splits[localSplitIndex];
+	const auto nextSplit = [=](int) {
+		prefetchChatSplit(index, localSplitIndex + 1);
+	};
+	prefetchChatMessages(index, splitIndex, 0, 0, 1, [=](int count) {
+		if (count <= 0) {
+			nextSplit(count);
+			return;
+		}
+		prefetchChatMessages(
+			index,
+			splitIndex,
+			1, // largestIdPlusOne
+			-kMessagesSliceLimit,
+			kMessagesSliceLimit,
+			nextSplit);
+	});
+}
+
+void ApiWrap::prefetchChatMessages(
+		int index,
+		int splitIndex,
+		int offsetId,
+		int addOffset,
+		int limit,
+		Fn<void(int count)> next) {
+	Expects(_messagesPrefetch != nullptr);
+
+	auto &prefetch = *_messagesPrefetch;
+	const auto &info = prefetch.dialogs[index];
+	const auto key = MessagesPrefetch::Key{
+		.peerId = info.peerId,
+		.splitIndex = splitIndex,
+		.offsetId = offsetId,
+		.addOffset = addOffset,
+		.limit = limit,
+		.onlyMyMessages = info.onlyMyMessages,
+	};
+	prefetch.entries[key].sent = crl::now();
+	sendChatMessagesRequest(
+		info,
+		splitIndex,
+		offsetId,
+		addOffset,
+		limit,
+		[=](MTPmessages_Messages &&result) {
+			if (!_messagesPrefetch) {
+				return;
+			}
+			auto &prefetch = *_messagesPrefetch;
+			const auto count = MessagesCount(result);
+			const auto i = prefetch.entries.find(key);
+			if (i != end(prefetch.entries)) {
+				const auto duration = crl::now() - i->second.sent;
+				if (duration > kPrefetchSlowResponse) {
+					prefetch.limit = std::max(prefetch.limit / 2, 1);
+				} else if (prefetch.limit < kPrefetchChatsMax) {
+					++prefetch.limit;
+				}
+				if (auto waiting = base::take(i->second.waiting)) {
+					prefetch.entries.erase(i);
+					waiting(std::move(result));
+				} else {
+					i->second.result = std::move(result);
+				}
+			}
+			next(count);
+		},
+		[=](const MTP::Error &error) {
+			if (!_messagesPrefetch) {
+				return true;
+			}
+			auto &prefetch = *_messagesPrefetch;
+			const auto i = prefetch.entries.find(key);
+			if (i != end(prefetch.entries)) {
+				auto waiting = base::take(i->second.waiting);
+				prefetch.entries.erase(i);
+				if (waiting) {
+					// Send the request again as usual, so that errors
+					// are handled by the chat export process.
+					sendChatMessages(
+						splitIndex,
+						offsetId,
+						addOffset,
+						limit,
+						std::move(waiting));
+				}
+			}
+			next(-1);
+			return true;
+		});
+}
+
+bool ApiWrap::takePrefetchedMessages(
+		int splitIndex,
+		int offsetId,
+		int addOffset,
+		int limit,
+		FnMut<void(MTPmessages_Messages&&)> &done) {
+	Expects(_chatProcess != nullptr);
+
+	if (!_messagesPrefetch) {
+		return false;
+	}
+	auto &prefetch = *_messagesPrefetch;
+	const auto i = prefetch.entries.find({
+		.peerId = _chatProcess->info.peerId,
+		.splitIndex = splitIndex,
+		.offsetId = offsetId,
+		.addOffset = addOffset,
+		.limit = limit,
+		.onlyMyMessages = _chatProcess->info.onlyMyMessages,
+	});
+	if (i == end(prefetch.entries)) {
+		return false;
+	} else if (!i->second.result) {
+		i->second.waiting = std::move(done);
+		return true;
+	}
+	auto result = std::move(*i->second.result);
+	prefetch.entries.erase(i);
+
+	// Don't process the whole chats list recursively. The chat could be
+	// finished or skipped and another one started before this runs.
+	const auto peerId = _chatProcess->info.peerId;
+	_runner([=, done = std::move(done), result = std::move(result)]() mutable {
+		if (_chatProcess && _chatProcess->info.peerId == peerId) {
+			done(std::move(result));
+		}
+	});
+	return true;
+}
+
 void ApiWrap::requestMessagesCount(int localSplitIndex) {
 	Expects(_chatProcess != nullptr);
 	Expects(localSplitIndex < _chatProcess->info.splits.size());
@@ -1170,16 +1476,7 @@ void ApiWrap::requestMessagesCount(int localSplitIndex) {
 		[=](const MTPmessages_Messages &result) {
 		Expects(_chatProcess != nullptr);
 
-		const auto count = result.match(
-			[](const MTPDmessages_messages &data) {
-			return int(data.vmessages().v.size());
-		}, [](const MTPDmessages_messagesSlice &data) {
-			return data.vcount().v;
-		}, [](const MTPDmessages_channelMessages &data) {
-			return data.vcount().v;
-		}, [](const MTPDmessages_messagesNotModified &data) {
-			return -1;
-		});
+		const auto count = MessagesCount(result);
 		if (count < 0) {
 			error("Unexpected messagesNotModified received.");
 			return;
@@ -1236,20 +1533,28 @@ void ApiWrap::messagesCountLoaded(int localSplitIndex, int count) {
 void ApiWrap::finishExport(FnMut<void()> done) {
 	const auto guard = gsl::finally([&] { _takeoutId = std::nullopt; });
 
+	_messagesPrefetch = nullptr;
+
+	// Keep the journal if the takeout session could not be finished,
+	// the export can be resumed from it then.
 	mainRequest(MTPaccount_FinishTakeoutSession(
 		MTP_flags(MTPaccount_FinishTakeoutSession::Flag::f_success)
-	)).done(std::move(done)).send();
+	)).done([=, done = std::move(done)]() mutable {
+		if (_journal) {
+			base::take(_journal)->finish();
+		}
+		done();
+	}).send();
 }
 
 void ApiWrap::skipFile(uint64 randomId) {
-	if (!_fileProcess || _fileProcess->randomId != randomId) {
+	const auto process = takeFileProcess(randomId);
+	if (!process) {
 		return;
 	}
 	LOG(("Export Info: File skipped."));
-	Assert(!_fileProcess->requests.empty());
-	Assert(_fileProcess->requestId != 0);
-	_mtp.request(base::take(_fileProcess->requestId)).cancel();
-	base::take(_fileProcess)->done(QString());
+	loadFileParts();
+	process->done(QString());
 }
 
 void ApiWrap::cancelExportFast() {
@@ -1605,21 +1910,77 @@ void ApiWrap::requestChatMessages(
 		FnMut<void(MTPmessages_Messages&&)> done) {
 	Expects(_chatProcess != nullptr);
 
+	if (takePrefetchedMessages(splitIndex, offsetId, addOffset, limit, done)) {
+		return;
+	}
+	sendChatMessages(splitIndex, offsetId, addOffset, limit, std::move(done));
+}
+
+void ApiWrap::sendChatMessages(
+		int splitIndex,
+		int offsetId,
+		int addOffset,
+		int limit,
+		FnMut<void(MTPmessages_Messages&&)> done) {
+	Expects(_chatProcess != nullptr);
+
 	_chatProcess->requestDone = std::move(done);
 	const auto doneHandler = [=](MTPmessages_Messages &&result) {
 		Expects(_chatProcess != nullptr);
 
 		base::take(_chatProcess->requestDone)(std::move(result));
 	};
+	sendChatMessagesRequest(
+		_chatProcess->info,
+		splitIndex,
+		offsetId,
+		addOffset,
+		limit,
+		doneHandler,
+		[=](const MTP::Error &error) {
+		Expects(_chatProcess != nullptr);
+
+		if (error.type() == u"CHANNEL_PRIVATE"_q) {
+			const auto &info = _chatProcess->info;
+			const auto realPeerInput = (splitIndex >= 0)
+				? info.input
+				: info.migratedFromInput;
+			if (realPeerInput.type() == mtpc_inputPeerChannel
+				&& !info.onlyMyMessages) {
+
+				// Perhaps we just left / were kicked from channel.
+				// Just switch to only my messages.
+				_chatProcess->info.onlyMyMessages = true;
+				sendChatMessages(
+					splitIndex,
+					offsetId,
+					addOffset,
+					limit,
+					base::take(_chatProcess->requestDone));
+				return true;
+			}
+		}
+		return false;
+	});
+}
+
+mtpRequestId ApiWrap::sendChatMessagesRequest(
+		const Data::DialogInfo &info,
+		int splitIndex,
+		int offsetId,
+		int addOffset,
+		int limit,
+		FnMut<void(MTPmessages_Messages&&)> done,
+		Fn<bool(const MTP::Error&)> fail) {
 	const auto splitsCount = int(_splits.size());
 	const auto realPeerInput = (splitIndex >= 0)
-		? _chatProcess->info.input
-		: _chatProcess->info.migratedFromInput;
+		? info.input
+		: info.migratedFromInput;
 	const auto realSplitIndex = (splitIndex >= 0)
 		? splitIndex
 		: (splitsCount + splitIndex);
-	if (_chatProcess->info.onlyMyMessages) {
-		splitRequest(realSplitIndex, MTPmessages_Search(
+	if (info.onlyMyMessages) {
+		return splitRequest(realSplitIndex, MTPmessages_Search(
 			MTP_flags(MTPmessages_Search::Flag::f_from_id),
 			realPeerInput,
 			MTP_string(), // query
@@ -1634,39 +1995,18 @@ void ApiWrap::requestChatMessages(
 			MTP_int(0), // max_id
 			MTP_int(0), // min_id
 			MTP_long(0) // hash
-		)).done(doneHandler).send();
-	} else {
-		splitRequest(realSplitIndex, MTPmessages_GetHistory(
-			realPeerInput,
-			MTP_int(offsetId),
-			MTP_int(0), // offset_date
-			MTP_int(addOffset),
-			MTP_int(limit),
-			MTP_int(0), // max_id
-			MTP_int(0), // min_id
-			MTP_long(0)  // hash
-		)).fail([=](const MTP::Error &error) {
-			Expects(_chatProcess != nullptr);
-
-			if (error.type() == u"CHANNEL_PRIVATE"_q) {
-				if (realPeerInput.type() == mtpc_inputPeerChannel
-					&& !_chatProcess->info.onlyMyMessages) {
-
-					// Perhaps we just left / were kicked from channel.
-					// Just switch to only my messages.
-					_chatProcess->info.onlyMyMessages = true;
-					requestChatMessages(
-						splitIndex,
-						offsetId,
-						addOffset,
-						limit,
-						base::take(_chatProcess->requestDone));
-					return true;
-				}
-			}
-			return false;
-		}).done(doneHandler).send();
+		)).fail(std::move(fail)).done(std::move(done)).send();
 	}
+	return splitRequest(realSplitIndex, MTPmessages_GetHistory(
+		realPeerInput,
+		MTP_int(offsetId),
+		MTP_int(0), // offset_date
+		MTP_int(addOffset),
+		MTP_int(limit),
+		MTP_int(0), // max_id
+		MTP_int(0), // min_id
+		MTP_long(0)  // hash
+	)).fail(std::move(fail)).done(std::move(done)).send();
 }
 
 void ApiWrap::loadMessagesFiles(Data::MessagesSlice &&slice) {
@@ -1772,7 +2112,11 @@ Data::FileOrigin ApiWrap::currentFileMessageOrigin() const {
 	return result;
 }
 
-bool ApiWrap::messageCustomEmojiReady(Data::Message &message) {
+bool ApiWrap::messageCustomEmojiReady(int index) {
+	Expects(_chatProcess != nullptr);
+	Expects(_chatProcess->slice.has_value());
+
+	auto &message = _chatProcess->slice->list[index];
 	for (auto &part : message.text) {
 		if (part.type == Data::TextPart::Type::CustomEmoji) {
 			if (const auto id = part.additional.toULongLong()) {
@@ -1782,16 +2126,18 @@ bool ApiWrap::messageCustomEmojiReady(Data::Message &message) {
 				} else {
 					auto &file = i->second.file;
 					const auto fileProgress = [=](FileProgress value) {
-						return loadMessageEmojiProgress(value);
+						return loadMessageEmojiProgress(index, value);
 					};
-					const auto ready = processFileLoad(
+					const auto state = processFileLoad(
 						file,
 						{ .customEmojiId = id },
 						fileProgress,
 						[=](const QString &path) {
 							loadMessageEmojiDone(id, path);
 						});
-					if (!ready) {
+					if (state != FileLoadState::Ready) {
+						// The emoji path is written into the message text,
+						// so we have to wait for the file to be loaded.
 						return false;
 					}
 					using SkipReason = Data::File::SkipReason;
@@ -1817,39 +2163,42 @@ void ApiWrap::loadNextMessageFile() {
 	for (auto &list = _chatProcess->slice->list
 		; _chatProcess->fileIndex < list.size()
 		; ++_chatProcess->fileIndex) {
-		auto &message = list[_chatProcess->fileIndex];
+		const auto index = _chatProcess->fileIndex;
+		auto &message = list[index];
 		if (Data::SkipMessageByDate(message, *_settings)) {
 			continue;
 		}
-		if (!messageCustomEmojiReady(message)) {
+		if (!messageCustomEmojiReady(index)) {
 			return;
 		}
 		const auto fileProgress = [=](FileProgress value) {
-			return loadMessageFileProgress(value);
+			return loadMessageFileProgress(index, value);
 		};
-		const auto ready = processFileLoad(
-			list[_chatProcess->fileIndex].file(),
+		const auto state = processFileLoad(
+			message.file(),
 			currentFileMessageOrigin(),
 			fileProgress,
-			[=](const QString &path) { loadMessageFileDone(path); },
-			currentFileMessage());
-		if (!ready) {
+			[=](const QString &path) { loadMessageFileDone(index, path); },
+			&message);
+		if (state == FileLoadState::Wait) {
 			return;
 		}
 		const auto thumbProgress = [=](FileProgress value) {
-			return loadMessageThumbProgress(value);
+			return loadMessageThumbProgress(index, value);
 		};
-		const auto thumbReady = processFileLoad(
-			list[_chatProcess->fileIndex].thumb().file,
+		const auto thumbState = processFileLoad(
+			message.thumb().file,
 			currentFileMessageOrigin(),
 			thumbProgress,
-			[=](const QString &path) { loadMessageThumbDone(path); },
-			currentFileMessage());
-		if (!thumbReady) {
+			[=](const QString &path) { loadMessageThumbDone(index, path); },
+			&message);
+		if (thumbState == FileLoadState::Wait) {
 			return;
 		}
 	}
-	finishMessagesSlice();
+	if (_fileProcesses.empty()) {
+		finishMessagesSlice();
+	}
 }
 
 void ApiWrap::finishMessagesSlice() {
@@ -1881,28 +2230,24 @@ void ApiWrap::finishMessagesSlice() {
 	}
 }
 
-bool ApiWrap::loadMessageFileProgress(FileProgress progress) {
-	Expects(_fileProcess != nullptr);
+bool ApiWrap::loadMessageFileProgress(int index, FileProgress progress) {
 	Expects(_chatProcess != nullptr);
 	Expects(_chatProcess->slice.has_value());
-	Expects((_chatProcess->fileIndex >= 0)
-		&& (_chatProcess->fileIndex < _chatProcess->slice->list.size()));
+	Expects((index >= 0) && (index < _chatProcess->slice->list.size()));
 
 	return _chatProcess->fileProgress(DownloadProgress{
-		.randomId = _fileProcess->randomId,
-		.path = _fileProcess->relativePath,
-		.itemIndex = _chatProcess->fileIndex,
+		.randomId = progress.randomId,
+		.path = progress.path,
+		.itemIndex = index,
 		.ready = progress.ready,
 		.total = progress.total });
 }
 
-void ApiWrap::loadMessageFileDone(const QString &relativePath) {
+void ApiWrap::loadMessageFileDone(int index, const QString &relativePath) {
 	Expects(_chatProcess != nullptr);
 	Expects(_chatProcess->slice.has_value());
-	Expects((_chatProcess->fileIndex >= 0)
-		&& (_chatProcess->fileIndex < _chatProcess->slice->list.size()));
+	Expects((index >= 0) && (index < _chatProcess->slice->list.size()));
 
-	const auto index = _chatProcess->fileIndex;
 	auto &file = _chatProcess->slice->list[index].file();
 	file.relativePath = relativePath;
 	if (relativePath.isEmpty()) {
@@ -1911,17 +2256,15 @@ void ApiWrap::loadMessageFileDone(const QString &relativePath) {
 	loadNextMessageFile();
 }
 
-bool ApiWrap::loadMessageThumbProgress(FileProgress progress) {
-	return loadMessageFileProgress(progress);
+bool ApiWrap::loadMessageThumbProgress(int index, FileProgress progress) {
+	return loadMessageFileProgress(index, progress);
 }
 
-void ApiWrap::loadMessageThumbDone(const QString &relativePath) {
+void ApiWrap::loadMessageThumbDone(int index, const QString &relativePath) {
 	Expects(_chatProcess != nullptr);
 	Expects(_chatProcess->slice.has_value());
-	Expects((_chatProcess->fileIndex >= 0)
-		&& (_chatProcess->fileIndex < _chatProcess->slice->list.size()));
+	Expects((index >= 0) && (index < _chatProcess->slice->list.size()));
 
-	const auto index = _chatProcess->fileIndex;
 	auto &file = _chatProcess->slice->list[index].thumb().file;
 	file.relativePath = relativePath;
 	if (relativePath.isEmpty()) {
@@ -1930,8 +2273,8 @@ void ApiWrap::loadMessageThumbDone(const QString &relativePath) {
 	loadNextMessageFile();
 }
 
-bool ApiWrap::loadMessageEmojiProgress(FileProgress progress) {
-	return loadMessageFileProgress(progress);
+bool ApiWrap::loadMessageEmojiProgress(int index, FileProgress progress) {
+	return loadMessageFileProgress(index, progress);
 }
 
 void ApiWrap::loadMessageEmojiDone(uint64 id, const QString &relativePath) {
@@ -1953,23 +2296,25 @@ void ApiWrap::finishMessages() {
 	process->done();
 }
 
-bool ApiWrap::processFileLoad(
+auto ApiWrap::processFileLoad(
 		Data::File &file,
 		const Data::FileOrigin &origin,
 		Fn<bool(FileProgress)> progress,
 		FnMut<void(QString)> done,
 		Data::Message *message,
-		Data::Story *story) {
+		Data::Story *story) -> FileLoadState {
 	using SkipReason = Data::File::SkipReason;
 
 	if (!file.relativePath.isEmpty()
 		|| file.skipReason != SkipReason::None) {
-		return true;
+		return FileLoadState::Ready;
 	} else if (!file.location && file.content.isEmpty()) {
 		file.skipReason = SkipReason::Unavailable;
-		return true;
+		return FileLoadState::Ready;
 	} else if (writePreloadedFile(file, origin)) {
-		return !file.relativePath.isEmpty();
+		return file.relativePath.isEmpty()
+			? FileLoadState::Wait
+			: FileLoadState::Ready;
 	}
 
 	using Type = MediaSettings::Type;
@@ -2004,17 +2349,44 @@ bool ApiWrap::processFileLoad(
 		: file.size;
 	if (message && Data::SkipMessageByDate(*message, *_settings)) {
 		file.skipReason = SkipReason::DateLimits;
-		return true;
+		return FileLoadState::Ready;
 	} else if (!story && (_settings->media.types & type) != type) {
 		file.skipReason = SkipReason::FileType;
-		return true;
+		return FileLoadState::Ready;
 	} else if (!story && fullSize >= _settings->media.sizeLimit) {
 		// Don't load thumbs for large files that we skip.
 		file.skipReason = SkipReason::FileSize;
-		return true;
+		return FileLoadState::Ready;
+	}
+
+	// A file is identified by its owner and its location, the file
+	// objects themselves may be moved while their parts are loaded.
+	const auto key = ComputeLocationKey(file.location);
+	const auto loading = [&](const std::unique_ptr<FileProcess> &process) {
+		return SameFileOrigin(process->origin, origin)
+			&& (ComputeLocationKey(process->location) == key);
+	};
+	if (ranges::any_of(_fileProcesses, loading)) {
+		return FileLoadState::Loading;
+	}
+
+	// Files are created on disk only when the first part is written,
+	// so wait for a file with the same path to avoid choosing it twice.
+	// The same location will be taken from the cache after it's loaded.
+	const auto relativePath = Output::File::PrepareRelativePath(
+		_settings->path,
+		file.suggestedPath);
+	for (const auto &process : _fileProcesses) {
+		if (ComputeLocationKey(process->location) == key
+			|| process->relativePath == relativePath) {
+			return FileLoadState::Wait;
+		}
+	}
+	if (!canLoadFilePart()) {
+		return FileLoadState::Wait;
 	}
 	loadFile(file, origin, std::move(progress), std::move(done));
-	return false;
+	return FileLoadState::Loading;
 }
 
 bool ApiWrap::writePreloadedFile(
@@ -2024,9 +2396,21 @@ bool ApiWrap::writePreloadedFile(
 
 	using namespace Output;
 
+	const auto journal = (_journal && file.location)
+		? _journal->find(JournalKey(file.location))
+		: nullptr;
 	if (const auto path = _fileCache->find(file.location)) {
 		file.relativePath = *path;
 		return true;
+	} else if (journal) {
+		// This file was loaded before the export was interrupted.
+		file.relativePath = journal->relativePath;
+		_fileCache->save(file.location, file.relativePath);
+		if (_stats) {
+			_stats->incrementFiles();
+			_stats->incrementBytes(journal->size);
+		}
+		return true;
 	} else if (!file.content.isEmpty()) {
 		const auto process = prepareFileProcess(file, origin);
 		if (const auto result = process->file.writeBlock(file.content)) {
@@ -2034,6 +2418,16 @@ bool ApiWrap::writePreloadedFile(
 			_fileCache->save(file.location, file.relativePath);
 		} else {
 			ioError(result);
+			return true;
+		}
+		if (_journal && file.location) {
+			const auto result = _journal->fileFinished(
+				JournalKey(file.location),
+				file.relativePath,
+				process->file.size());
+			if (!result) {
+				ioError(result);
+			}
 		}
 		return true;
 	}
@@ -2045,27 +2439,29 @@ void ApiWrap::loadFile(
 		const Data::FileOrigin &origin,
 		Fn<bool(FileProgress)> progress,
 		FnMut<void(QString)> done) {
-	Expects(_fileProcess == nullptr);
 	Expects(file.location.dcId != 0
 		|| file.location.data.type() == mtpc_inputTakeoutFileLocation);
 
-	_fileProcess = prepareFileProcess(file, origin);
-	_fileProcess->progress = std::move(progress);
-	_fileProcess->done = std::move(done);
+	auto process = prepareFileProcess(file, origin);
+	process->progress = std::move(progress);
+	process->done = std::move(done);
 
-	if (_fileProcess->progress) {
-		const auto progress = FileProgress{
-			_fileProcess->file.size(),
-			_fileProcess->size
-		};
-		if (!_fileProcess->progress(progress)) {
+	if (_journal) {
+		const auto result = _journal->fileStarted(process->relativePath);
+		if (!result) {
+			ioError(result);
 			return;
 		}
 	}
 
-	loadFilePart();
+	const auto raw = process.get();
+	_fileProcesses.push_back(std::move(process));
 
-	Ensures(_fileProcess->requestId != 0);
+	if (!reportFileProgress(raw)) {
+		return;
+	}
+
+	loadFileParts();
 }
 
 auto ApiWrap::prepareFileProcess(
@@ -2088,43 +2484,145 @@ auto ApiWrap::prepareFileProcess(
 	return result;
 }
 
-void ApiWrap::loadFilePart() {
-	if (!_fileProcess
-		|| _fileProcess->requestId
-		|| _fileProcess->requests.size() >= kFileRequestsCount
-		|| (_fileProcess->size > 0
-			&& _fileProcess->offset >= _fileProcess->size)) {
-		return;
+void ApiWrap::loadNextFiles() {
+	if (_chatProcess && _chatProcess->slice) {
+		loadNextMessageFile();
+	} else if (_storiesProcess && _storiesProcess->slice) {
+		loadNextStory();
+	} else if (_userpicsProcess && _userpicsProcess->slice) {
+		loadNextUserpic();
+	}
+}
+
+bool ApiWrap::canLoadFilePart() const {
+	// Parts that are received out of order stay in memory until all
+	// the previous parts of the same file are written, so they are
+	// counted against the bytes limit together with the pending ones.
+	auto loading = 0;
+	auto reserved = int64();
+	for (const auto &process : _fileProcesses) {
+		for (const auto &request : process->requests) {
+			if (request.bytes.isEmpty()) {
+				++loading;
+				reserved += kFileChunkSize;
+			} else {
+				reserved += request.bytes.size();
+			}
+		}
 	}
+	return (loading < kFileRequestsLimit)
+		&& (reserved + kFileChunkSize <= kFileBytesLimit);
+}
 
-	const auto offset = _fileProcess->offset;
-	_fileProcess->requests.push_back({ offset });
-	_fileProcess->requestId = fileRequest(
-		_fileProcess->location,
-		_fileProcess->offset
-	).done([=](const MTPupload_File &result) {
-		_fileProcess->requestId = 0;
-		filePartDone(offset, result);
-	}).send();
-	_fileProcess->offset += kFileChunkSize;
+auto ApiWrap::fileProcess(uint64 randomId) const -> FileProcess* {
+	const auto i = ranges::find(
+		_fileProcesses,
+		randomId,
+		[](const std::unique_ptr<FileProcess> &process) {
+			return process->randomId;
+		});
+	return (i != end(_fileProcesses)) ? i->get() : nullptr;
+}
+
+bool ApiWrap::reportFileProgress(not_null<FileProcess*> process) {
+	if (!process->progress) {
+		return true;
+	} else if (_fileProgressId != process->randomId
+		&& fileProcess(_fileProgressId)) {
+		// Progress is shown for one file at a time, until it is done.
+		return true;
+	}
+	_fileProgressId = process->randomId;
+	return process->progress(FileProgress{
+		process->randomId,
+		process->relativePath,
+		process->file.size(),
+		process->size });
+}
+
+auto ApiWrap::takeFileProcess(uint64 randomId)
+-> std::unique_ptr<FileProcess> {
+	const auto i = ranges::find(
+		_fileProcesses,
+		randomId,
+		[](const std::unique_ptr<FileProcess> &process) {
+			return process->randomId;
+		});
+	if (i == end(_fileProcesses)) {
+		return nullptr;
+	}
+	auto result = std::move(*i);
+	_fileProcesses.erase(i);
+	for (const auto &request : result->requests) {
+		if (request.requestId) {
+			_mtp.request(request.requestId).cancel();
+		}
+	}
+	if (result->referenceRequestId) {
+		_mtp.request(result->referenceRequestId).cancel();
+	}
+	return result;
+}
+
+void ApiWrap::loadFileParts() {
+	// Spread the requests between the files loaded in parallel, so that
+	// a large file won't stop the small ones from being loaded.
+	for (auto round = 1; round <= kFileRequestsCount; ++round) {
+		for (const auto &process : _fileProcesses) {
+			if (int(process->requests.size()) < round
+				&& !loadFilePart(process.get())) {
+				return;
+			}
+		}
+	}
+}
 
-	if (_fileProcess->size > 0
-		&& _fileProcess->requests.size() < kFileRequestsCount) {
-		// Only one request at a time supported right now.
-		//const auto runner = _runner;
-		//crl::on_main([=] {
-		//	QTimer::singleShot(kFileNextRequestDelay, [=] {
-		//		runner([=] {
-		//			loadFilePart();
-		//		});
-		//	});
-		//});
+bool ApiWrap::loadFilePart(not_null<FileProcess*> process) {
+	if (process->referenceRequestId
+		|| process->requests.size() >= kFileRequestsCount
+		|| (process->size > 0 && process->offset >= process->size)
+		|| (!process->size && !process->requests.empty())) {
+		// Files of unknown size are loaded one part at a time.
+		return true;
+	} else if (!canLoadFilePart()) {
+		return false;
 	}
+
+	const auto offset = process->offset;
+	process->requests.push_back({ offset });
+	process->offset += kFileChunkSize;
+	sendFilePart(process, offset);
+	return true;
+}
+
+void ApiWrap::sendFilePart(not_null<FileProcess*> process, int64 offset) {
+	using Request = FileProcess::Request;
+	const auto i = ranges::find(
+		process->requests,
+		offset,
+		[](const Request &request) { return request.offset; });
+	Assert(i != end(process->requests));
+	Assert(i->requestId == 0);
+
+	const auto randomId = process->randomId;
+	i->requestId = fileRequest(
+		randomId,
+		process->location,
+		offset
+	).done([=](const MTPupload_File &result) {
+		filePartDone(randomId, offset, result);
+	}).send();
 }
 
-void ApiWrap::filePartDone(int64 offset, const MTPupload_File &result) {
-	Expects(_fileProcess != nullptr);
-	Expects(!_fileProcess->requests.empty());
+void ApiWrap::filePartDone(
+		uint64 randomId,
+		int64 offset,
+		const MTPupload_File &result) {
+	const auto process = fileProcess(randomId);
+	if (!process) {
+		return;
+	}
+	Assert(!process->requests.empty());
 
 	if (result.type() == mtpc_upload_fileCdnRedirect) {
 		error("Cdn redirect is not supported.");
@@ -2132,27 +2630,28 @@ void ApiWrap::filePartDone(int64 offset, const MTPupload_File &result) {
 	}
 	const auto &data = result.c_upload_file();
 	if (data.vbytes().v.isEmpty()) {
-		if (_fileProcess->size > 0) {
+		if (process->size > 0) {
 			error("Empty bytes received in file part.");
 			return;
 		}
-		const auto result = _fileProcess->file.writeBlock({});
+		const auto result = process->file.writeBlock({});
 		if (!result) {
 			ioError(result);
 			return;
 		}
 	} else {
 		using Request = FileProcess::Request;
-		auto &requests = _fileProcess->requests;
+		auto &requests = process->requests;
 		const auto i = ranges::find(
 			requests,
 			offset,
 			[](const Request &request) { return request.offset; });
 		Assert(i != end(requests));
 
+		i->requestId = 0;
 		i->bytes = data.vbytes().v;
 
-		auto &file = _fileProcess->file;
+		auto &file = process->file;
 		while (!requests.empty() && !requests.front().bytes.isEmpty()) {
 			const auto &bytes = requests.front().bytes;
 			if (const auto result = file.writeBlock(bytes); !result) {
@@ -2162,42 +2661,54 @@ void ApiWrap::filePartDone(int64 offset, const MTPupload_File &result) {
 			requests.pop_front();
 		}
 
-		if (_fileProcess->progress) {
-			_fileProcess->progress(FileProgress{
-				file.size(),
-				_fileProcess->size });
-		}
+		reportFileProgress(process);
 
 		if (!requests.empty()
-			|| !_fileProcess->size
-			|| _fileProcess->size > _fileProcess->offset) {
-			loadFilePart();
+			|| !process->size
+			|| process->size > process->offset) {
+			loadFileParts();
+			if (canLoadFilePart()) {
+				loadNextFiles();
+			}
 			return;
 		}
 	}
 
-	auto process = base::take(_fileProcess);
-	const auto relativePath = process->relativePath;
-	_fileCache->save(process->location, relativePath);
-	process->done(process->relativePath);
+	auto finished = takeFileProcess(randomId);
+	const auto relativePath = finished->relativePath;
+	_fileCache->save(finished->location, relativePath);
+	if (_journal) {
+		const auto result = _journal->fileFinished(
+			JournalKey(finished->location),
+			relativePath,
+			finished->file.size());
+		if (!result) {
+			ioError(result);
+			return;
+		}
+	}
+	loadFileParts();
+	finished->done(relativePath);
 }
 
-void ApiWrap::filePartRefreshReference(int64 offset) {
-	Expects(_fileProcess != nullptr);
-	Expects(_fileProcess->requestId == 0);
+void ApiWrap::filePartRefreshReference(uint64 randomId, int64 offset) {
+	const auto process = fileProcess(randomId);
+	Assert(process != nullptr);
 
-	const auto &origin = _fileProcess->origin;
+	if (process->referenceRequestId) {
+		// This part will be requested again after the reference refresh.
+		return;
+	}
+	const auto &origin = process->origin;
 	if (origin.storyId) {
-		_fileProcess->requestId = mainRequest(MTPstories_GetStoriesByID(
+		process->referenceRequestId = mainRequest(MTPstories_GetStoriesByID(
 			MTP_inputPeerSelf(),
 			MTP_vector<MTPint>(1, MTP_int(origin.storyId))
 		)).fail([=](const MTP::Error &error) {
-			_fileProcess->requestId = 0;
-			filePartUnavailable();
+			filePartUnavailable(randomId);
 			return true;
 		}).done([=](const MTPstories_Stories &result) {
-			_fileProcess->requestId = 0;
-			filePartExtractReference(offset, result);
+			filePartExtractReference(randomId, result);
 		}).send();
 		return;
 	} else if (!origin.messageId) {
@@ -2214,21 +2725,19 @@ void ApiWrap::filePartRefreshReference(int64 offset) {
 				origin.peer.c_inputPeerChannelFromMessage().vpeer(),
 				origin.peer.c_inputPeerChannelFromMessage().vmsg_id(),
 				origin.peer.c_inputPeerChannelFromMessage().vchannel_id());
-		_fileProcess->requestId = mainRequest(MTPchannels_GetMessages(
+		process->referenceRequestId = mainRequest(MTPchannels_GetMessages(
 			channel,
 			MTP_vector<MTPInputMessage>(
 				1,
 				MTP_inputMessageID(MTP_int(origin.messageId)))
 		)).fail([=](const MTP::Error &error) {
-			_fileProcess->requestId = 0;
-			filePartUnavailable();
+			filePartUnavailable(randomId);
 			return true;
 		}).done([=](const MTPmessages_Messages &result) {
-			_fileProcess->requestId = 0;
-			filePartExtractReference(offset, result);
+			filePartExtractReference(randomId, result);
 		}).send();
 	} else {
-		_fileProcess->requestId = splitRequest(
+		process->referenceRequestId = splitRequest(
 			origin.split,
 			MTPmessages_GetMessages(
 				MTP_vector<MTPInputMessage>(
@@ -2236,21 +2745,22 @@ void ApiWrap::filePartRefreshReference(int64 offset) {
 					MTP_inputMessageID(MTP_int(origin.messageId)))
 			)
 		).fail([=](const MTP::Error &error) {
-			_fileProcess->requestId = 0;
-			filePartUnavailable();
+			filePartUnavailable(randomId);
 			return true;
 		}).done([=](const MTPmessages_Messages &result) {
-			_fileProcess->requestId = 0;
-			filePartExtractReference(offset, result);
+			filePartExtractReference(randomId, result);
 		}).send();
 	}
 }
 
 void ApiWrap::filePartExtractReference(
-		int64 offset,
+		uint64 randomId,
 		const MTPmessages_Messages &result) {
-	Expects(_fileProcess != nullptr);
-	Expects(_fileProcess->requestId == 0);
+	const auto process = fileProcess(randomId);
+	if (!process) {
+		return;
+	}
+	process->referenceRequestId = 0;
 
 	result.match([&](const MTPDmessages_messagesNotModified &data) {
 		error("Unexpected messagesNotModified received.");
@@ -2266,68 +2776,71 @@ void ApiWrap::filePartExtractReference(
 			data.vchats(),
 			_chatProcess->info.relativePath);
 		for (const auto &message : messages.list) {
-			if (message.id == _fileProcess->origin.messageId) {
+			if (message.id == process->origin.messageId) {
 				const auto refresh1 = Data::RefreshFileReference(
-					_fileProcess->location,
+					process->location,
 					message.file().location);
 				const auto refresh2 = Data::RefreshFileReference(
-					_fileProcess->location,
+					process->location,
 					message.thumb().file.location);
 				if (refresh1 || refresh2) {
-					_fileProcess->requestId = fileRequest(
-						_fileProcess->location,
-						offset
-					).done([=](const MTPupload_File &result) {
-						_fileProcess->requestId = 0;
-						filePartDone(offset, result);
-					}).send();
+					filePartsResend(process);
 					return;
 				}
 			}
 		}
-		filePartUnavailable();
+		filePartUnavailable(randomId);
 	});
 }
 
 void ApiWrap::filePartExtractReference(
-		int64 offset,
+		uint64 randomId,
 		const MTPstories_Stories &result) {
-	Expects(_fileProcess != nullptr);
-	Expects(_fileProcess->requestId == 0);
+	const auto process = fileProcess(randomId);
+	if (!process) {
+		return;
+	}
+	process->referenceRequestId = 0;
 
 	const auto stories = Data::ParseStoriesSlice(
 		result.data().vstories(),
 		0);
 	for (const auto &story : stories.list) {
-		if (story.id == _fileProcess->origin.storyId) {
+		if (story.id == process->origin.storyId) {
 			const auto refresh1 = Data::RefreshFileReference(
-				_fileProcess->location,
+				process->location,
 				story.file().location);
 			const auto refresh2 = Data::RefreshFileReference(
-				_fileProcess->location,
+				process->location,
 				story.thumb().file.location);
 			if (refresh1 || refresh2) {
-				_fileProcess->requestId = fileRequest(
-					_fileProcess->location,
-					offset
-				).done([=](const MTPupload_File &result) {
-					_fileProcess->requestId = 0;
-					filePartDone(offset, result);
-				}).send();
+				filePartsResend(process);
 				return;
 			}
 		}
 	}
-	filePartUnavailable();
+	filePartUnavailable(randomId);
+}
+
+void ApiWrap::filePartsResend(not_null<FileProcess*> process) {
+	for (const auto &request : process->requests) {
+		if (request.bytes.isEmpty() && !request.requestId) {
+			sendFilePart(process, request.offset);
+		}
+	}
+	loadFileParts();
 }
 
-void ApiWrap::filePartUnavailable() {
-	Expects(_fileProcess != nullptr);
-	Expects(!_fileProcess->requests.empty());
+void ApiWrap::filePartUnavailable(uint64 randomId) {
+	const auto process = takeFileProcess(randomId);
+	if (!process) {
+		return;
+	}
 
 	LOG(("Export Error: File unavailable."));
 
-	base::take(_fileProcess)->done(QString());
+	loadFileParts();
+	process->done(QString());
 }
 
 void ApiWrap::error(const MTP::Error &error) {
@@ -34,6 +34,7 @@ struct FileOrigin;
 namespace Output {
 struct Result;
 class Stats;
+class Journal;
 } // namespace Output
 
 struct Settings;
@@ -88,6 +89,10 @@ public:
 
 	void requestSessions(FnMut<void(Data::SessionsList&&)> done);
 
+	// Messages of the chats following the one requested by
+	// requestMessages() are loaded in advance, several at once.
+	void prefetchMessages(const Data::DialogsInfo &dialogs);
+
 	void requestMessages(
 		const Data::DialogInfo &info,
 		FnMut<bool(const Data::DialogInfo &)> start,
@@ -114,8 +119,16 @@ private:
 	struct LeftChannelsProcess;
 	struct DialogsProcess;
 	struct ChatProcess;
+	struct MessagesPrefetch;
+
+	enum class FileLoadState {
+		Ready,
+		Loading,
+		Wait,
+	};
 
 	void startMainSession(FnMut<void()> done);
+	bool startJournal();
 	void sendNextStartRequest();
 	void requestUserpicsCount();
 	void requestStoriesCount();
@@ -129,18 +142,18 @@ private:
 	void handleUserpicsSlice(const MTPphotos_Photos &result);
 	void loadUserpicsFiles(Data::UserpicsSlice &&slice);
 	void loadNextUserpic();
-	bool loadUserpicProgress(FileProgress value);
-	void loadUserpicDone(const QString &relativePath);
+	bool loadUserpicProgress(int index, FileProgress value);
+	void loadUserpicDone(int index, const QString &relativePath);
 	void finishUserpicsSlice();
 	void finishUserpics();
 
 	void handleStoriesSlice(const MTPstories_Stories &result);
 	void loadStoriesFiles(Data::StoriesSlice &&slice);
 	void loadNextStory();
-	bool loadStoryProgress(FileProgress value);
-	void loadStoryDone(const QString &relativePath);
-	bool loadStoryThumbProgress(FileProgress value);
-	void loadStoryThumbDone(const QString &relativePath);
+	bool loadStoryProgress(int index, FileProgress value);
+	void loadStoryDone(int index, const QString &relativePath);
+	bool loadStoryThumbProgress(int index, FileProgress value);
+	void loadStoryThumbDone(int index, const QString &relativePath);
 	void finishStoriesSlice();
 	void finishStories();
 
@@ -179,16 +192,47 @@ private:
 		int addOffset,
 		int limit,
 		FnMut<void(MTPmessages_Messages&&)> done);
+	void sendChatMessages(
+		int splitIndex,
+		int offsetId,
+		int addOffset,
+		int limit,
+		FnMut<void(MTPmessages_Messages&&)> done);
+	mtpRequestId sendChatMessagesRequest(
+		const Data::DialogInfo &info,
+		int splitIndex,
+		int offsetId,
+		int addOffset,
+		int limit,
+		FnMut<void(MTPmessages_Messages&&)> done,
+		Fn<bool(const MTP::Error&)> fail);
+
+	void advanceMessagesPrefetch(PeerId peerId);
+	void startMessagesPrefetch();
+	void prefetchChatSplit(int index, int localSplitIndex);
+	void prefetchChatMessages(
+		int index,
+		int splitIndex,
+		int offsetId,
+		int addOffset,
+		int limit,
+		Fn<void(int count)> next);
+	[[nodiscard]] bool takePrefetchedMessages(
+		int splitIndex,
+		int offsetId,
+		int addOffset,
+		int limit,
+		FnMut<void(MTPmessages_Messages&&)> &done);
 	void collectMessagesCustomEmoji(const Data::MessagesSlice &slice);
 	void resolveCustomEmoji();
 	void loadMessagesFiles(Data::MessagesSlice &&slice);
 	void loadNextMessageFile();
-	bool messageCustomEmojiReady(Data::Message &message);
-	bool loadMessageFileProgress(FileProgress value);
-	void loadMessageFileDone(const QString &relativePath);
-	bool loadMessageThumbProgress(FileProgress value);
-	void loadMessageThumbDone(const QString &relativePath);
-	bool loadMessageEmojiProgress(FileProgress progress);
+	bool messageCustomEmojiReady(int index);
+	bool loadMessageFileProgress(int index, FileProgress value);
+	void loadMessageFileDone(int index, const QString &relativePath);
+	bool loadMessageThumbProgress(int index, FileProgress value);
+	void loadMessageThumbDone(int index, const QString &relativePath);
+	bool loadMessageEmojiProgress(int index, FileProgress progress);
 	void loadMessageEmojiDone(uint64 id, const QString &relativePath);
 	void finishMessagesSlice();
 	void finishMessages();
@@ -196,7 +240,7 @@ private:
 	[[nodiscard]] Data::Message *currentFileMessage() const;
 	[[nodiscard]] Data::FileOrigin currentFileMessageOrigin() const;
 
-	bool processFileLoad(
+	FileLoadState processFileLoad(
 		Data::File &file,
 		const Data::FileOrigin &origin,
 		Fn<bool(FileProgress)> progress,
@@ -214,15 +258,26 @@ private:
 		const Data::FileOrigin &origin,
 		Fn<bool(FileProgress)> progress,
 		FnMut<void(QString)> done);
-	void loadFilePart();
-	void filePartDone(int64 offset, const MTPupload_File &result);
-	void filePartUnavailable();
-	void filePartRefreshReference(int64 offset);
-	void filePartExtractReference(
+	void loadNextFiles();
+	[[nodiscard]] bool canLoadFilePart() const;
+	[[nodiscard]] FileProcess *fileProcess(uint64 randomId) const;
+	bool reportFileProgress(not_null<FileProcess*> process);
+	std::unique_ptr<FileProcess> takeFileProcess(uint64 randomId);
+	void loadFileParts();
+	bool loadFilePart(not_null<FileProcess*> process);
+	void sendFilePart(not_null<FileProcess*> process, int64 offset);
+	void filePartDone(
+		uint64 randomId,
 		int64 offset,
+		const MTPupload_File &result);
+	void filePartsResend(not_null<FileProcess*> process);
+	void filePartUnavailable(uint64 randomId);
+	void filePartRefreshReference(uint64 randomId, int64 offset);
+	void filePartExtractReference(
+		uint64 randomId,
 		const MTPmessages_Messages &result);
 	void filePartExtractReference(
-		int64 offset,
+		uint64 randomId,
 		const MTPstories_Stories &result);
 
 	template <typename Request>
@@ -235,6 +290,7 @@ private:
 	[[nodiscard]] auto splitRequest(int index, Request &&request);
 
 	[[nodiscard]] auto fileRequest(
+		uint64 randomId,
 		const Data::FileLocation &location,
 		int64 offset);
 
@@ -243,6 +299,7 @@ private:
 	void ioError(const Output::Result &result);
 
 	MTP::ConcurrentSender _mtp;
+	Fn<void(FnMut<void()>)> _runner;
 	std::optional<uint64> _takeoutId;
 	std::optional<UserId> _selfId;
 	Output::Stats *_stats = nullptr;
@@ -252,14 +309,17 @@ private:
 
 	std::unique_ptr<StartProcess> _startProcess;
 	std::unique_ptr<LoadedFileCache> _fileCache;
+	std::unique_ptr<Output::Journal> _journal;
 	std::unique_ptr<ContactsProcess> _contactsProcess;
 	std::unique_ptr<UserpicsProcess> _userpicsProcess;
 	std::unique_ptr<StoriesProcess> _storiesProcess;
 	std::unique_ptr<OtherDataProcess> _otherDataProcess;
-	std::unique_ptr<FileProcess> _fileProcess;
+	std::vector<std::unique_ptr<FileProcess>> _fileProcesses;
+	uint64 _fileProgressId = 0;
 	std::unique_ptr<LeftChannelsProcess> _leftChannelsProcess;
 	std::unique_ptr<DialogsProcess> _dialogsProcess;
 	std::unique_ptr<ChatProcess> _chatProcess;
+	std::unique_ptr<MessagesPrefetch> _messagesPrefetch;
 	base::flat_set<uint64> _unresolvedCustomEmoji;
 	base::flat_map<uint64, Data::Document> _resolvedCustomEmoji;
 	QVector<MTPMessageRange> _splits;
@@ -253,7 +253,9 @@ void ControllerObject::startExport(
 	_settings = NormalizeSettings(settings);
 	_environment = environment;
 
-	_settings.path = Output::NormalizePath(_settings);
+	_settings.path = Output::NormalizePath(
+		_settings,
+		_environment.selfId);
 	_writer = Output::CreateWriter(_settings.format);
 	fillExportSteps();
 	exportNext();
@@ -490,6 +492,7 @@ void ControllerObject::exportDialogs() {
 		return;
 	}
 
+	_api.prefetchMessages(_dialogsInfo);
 	exportNextDialog();
 }
 
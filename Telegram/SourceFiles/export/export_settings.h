@@ -109,6 +109,7 @@ struct Settings {
 };
 
 struct Environment {
+	uint64 selfId = 0;
 	QString internalLinksDomain;
 	QByteArray aboutTelegram;
 	QByteArray aboutContacts;
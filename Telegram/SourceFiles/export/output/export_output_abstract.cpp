@@ -10,6 +10,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "export/output/export_output_html_and_json.h"
 #include "export/output/export_output_html.h"
 #include "export/output/export_output_json.h"
+#include "export/output/export_output_journal.h"
 #include "export/output/export_output_stats.h"
 #include "export/output/export_output_result.h"
 
@@ -19,23 +20,41 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 namespace Export {
 namespace Output {
 
-QString NormalizePath(const Settings &settings) {
+QString NormalizePath(const Settings &settings, uint64 selfId) {
 	QDir folder(settings.path);
 	const auto path = folder.absolutePath();
 	auto result = path.endsWith('/') ? path : (path + '/');
 	if (!folder.exists() && !settings.forceSubPath) {
 		return result;
+	} else if (!settings.forceSubPath
+		&& Journal::Resumable(result, settings, selfId)) {
+		return result;
 	}
 	const auto mode = QDir::AllEntries | QDir::NoDotAndDotDot;
 	const auto list = folder.entryInfoList(mode);
 	if (list.isEmpty() && !settings.forceSubPath) {
 		return result;
 	}
+	const auto prefix = settings.onlySinglePeer()
+		? u"ChatExport_"_q
+		: u"DataExport_"_q;
+
+	// Continue the latest interrupted export with the same settings.
+	// Names like "... (10)" sort before "... (2)", so check the most
+	// recently modified folders first.
+	const auto subfolders = folder.entryInfoList(
+		{ prefix + '*' },
+		QDir::Dirs | QDir::NoDotAndDotDot,
+		QDir::Time);
+	for (const auto &subfolder : subfolders) {
+		const auto resumed = result + subfolder.fileName() + '/';
+		if (Journal::Resumable(resumed, settings, selfId)) {
+			return resumed;
+		}
+	}
+
 	const auto date = QDate::currentDate();
-	const auto base = QString(settings.onlySinglePeer()
-		? "ChatExport_%1"
-		: "DataExport_%1"
-	).arg(date.toString(Qt::ISODate));
+	const auto base = prefix + date.toString(Qt::ISODate);
 	const auto add = [&](int i) {
 		return base + (i ? " (" + QString::number(i) + ')' : QString());
 	};
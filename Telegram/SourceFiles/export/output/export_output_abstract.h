@@ -29,7 +29,7 @@ struct Environment;
 
 namespace Output {
 
-QString NormalizePath(const Settings &settings);
+QString NormalizePath(const Settings &settings, uint64 selfId);
 
 struct Result;
 class Stats;
@@ -19,26 +19,58 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 namespace Export {
 namespace Output {
 
-File::File(const QString &path, Stats *stats) : _path(path), _stats(stats) {
+File::File(const QString &path, Stats *stats, int bufferSize)
+: _path(path)
+, _bufferSize(bufferSize)
+, _stats(stats) {
 }
 
 int64 File::size() const {
-	return _offset;
+	return _offset + _buffer.size();
 }
 
 bool File::empty() const {
-	return !_offset;
+	return !size();
 }
 
 Result File::writeBlock(const QByteArray &block) {
-	const auto result = writeBlockAttempt(block);
+	if (!_bufferSize || block.isEmpty()) {
+		return write(block.constData(), block.size());
+	} else if (_buffer.size() + block.size() > _bufferSize) {
+		if (const auto result = flush(); !result) {
+			return result;
+		} else if (block.size() >= _bufferSize) {
+			return write(block.constData(), block.size());
+		}
+	}
+	if (_buffer.capacity() < _bufferSize) {
+		_buffer.reserve(_bufferSize);
+	}
+	_buffer.append(block);
+	return Result::Success();
+}
+
+Result File::flush() {
+	if (_buffer.isEmpty()) {
+		return Result::Success();
+	}
+	const auto result = write(_buffer.constData(), _buffer.size());
+	if (result) {
+		// Keep the allocated buffer for the next blocks.
+		_buffer.resize(0);
+	}
+	return result;
+}
+
+Result File::write(const char *data, int size) {
+	const auto result = writeAttempt(data, size);
 	if (!result) {
 		_file.reset();
 	}
 	return result;
 }
 
-Result File::writeBlockAttempt(const QByteArray &block) {
+Result File::writeAttempt(const char *data, int size) {
 	if (_stats && !_inStats) {
 		_inStats = true;
 		_stats->incrementFiles();
@@ -46,11 +78,10 @@ Result File::writeBlockAttempt(const QByteArray &block) {
 	if (const auto result = reopen(); !result) {
 		return result;
 	}
-	const auto size = block.size();
 	if (!size) {
 		return Result::Success();
 	}
-	if (_file->write(block) == size && _file->flush()) {
+	if (_file->write(data, size) == size && _file->flush()) {
 		_offset += size;
 		if (_stats) {
 			_stats->incrementBytes(size);
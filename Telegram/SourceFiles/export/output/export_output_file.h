@@ -19,14 +19,21 @@ namespace Output {
 struct Result;
 class Stats;
 
+// Buffer size for large text files, like the messages lists.
+constexpr auto kFileBufferSize = 1024 * 1024;
+
 class File {
 public:
-	File(const QString &path, Stats *stats);
+	// With non-zero bufferSize blocks are collected in a buffer of that
+	// size and written to disk when it is full or by flush(), otherwise
+	// each block is written and flushed right away.
+	File(const QString &path, Stats *stats, int bufferSize = 0);
 
 	[[nodiscard]] int64 size() const;
 	[[nodiscard]] bool empty() const;
 
 	[[nodiscard]] Result writeBlock(const QByteArray &block);
+	[[nodiscard]] Result flush();
 
 	[[nodiscard]] static QString PrepareRelativePath(
 		const QString &folder,
@@ -39,7 +46,8 @@ public:
 
 private:
 	[[nodiscard]] Result reopen();
-	[[nodiscard]] Result writeBlockAttempt(const QByteArray &block);
+	[[nodiscard]] Result write(const char *data, int size);
+	[[nodiscard]] Result writeAttempt(const char *data, int size);
 
 	[[nodiscard]] Result error() const;
 	[[nodiscard]] Result fatalError() const;
@@ -47,6 +55,8 @@ private:
 	QString _path;
 	int64 _offset = 0;
 	std::optional<QFile> _file;
+	QByteArray _buffer;
+	int _bufferSize = 0;
 
 	Stats *_stats = nullptr;
 	bool _inStats = false;
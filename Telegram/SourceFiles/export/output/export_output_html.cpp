@@ -499,7 +499,11 @@ struct HtmlWriter::MessageInfo {
 
 class HtmlWriter::Wrap {
 public:
-	Wrap(const QString &path, const QString &base, Stats *stats);
+	Wrap(
+		const QString &path,
+		const QString &base,
+		Stats *stats,
+		int bufferSize = 0);
 
 	[[nodiscard]] bool empty() const;
 
@@ -676,8 +680,9 @@ QString WriteUserpicThumb(
 HtmlWriter::Wrap::Wrap(
 	const QString &path,
 	const QString &base,
-	Stats *stats)
-: _file(path, stats) {
+	Stats *stats,
+	int bufferSize)
+: _file(path, stats, bufferSize) {
 	Expects(base.endsWith('/'));
 	Expects(path.startsWith(base));
 
@@ -2060,7 +2065,10 @@ Result HtmlWriter::Wrap::close() {
 		while (!_context.empty()) {
 			block.append(_context.popTag());
 		}
-		return _file.writeBlock(block);
+		if (const auto result = _file.writeBlock(block); !result) {
+			return result;
+		}
+		return _file.flush();
 	}
 	return Result::Success();
 }
@@ -2731,7 +2739,9 @@ Result HtmlWriter::writeDialogsStart(const Data::DialogsInfo &data) {
 Result HtmlWriter::writeDialogStart(const Data::DialogInfo &data) {
 	Expects(_chat == nullptr);
 
-	_chat = fileWithRelativePath(data.relativePath + messagesFile(0));
+	_chat = fileWithRelativePath(
+		data.relativePath + messagesFile(0),
+		kFileBufferSize);
 	_chatFileEmpty = true;
 	_messagesCount = 0;
 	_dateMessageId = 0;
@@ -2753,21 +2763,17 @@ Result HtmlWriter::writeDialogSlice(const Data::MessagesSlice &data) {
 		: 0;
 	auto previous = _lastMessageInfo.get();
 	auto saved = std::optional<MessageInfo>();
-	auto block = QByteArray();
 	for (const auto &message : data.list) {
 		if (Data::SkipMessageByDate(message, _settings)) {
 			continue;
 		}
 		const auto newIndex = (_messagesCount / kMessagesInFile);
 		if (oldIndex != newIndex) {
-			if (const auto result = _chat->writeBlock(block); !result) {
-				return result;
-			} else if (const auto next = switchToNextChatFile(newIndex)) {
+			if (const auto next = switchToNextChatFile(newIndex)) {
 				Assert(saved.has_value() || _lastMessageInfo != nullptr);
 				_lastMessageIdsPerFile.push_back(saved
 					? saved->id
 					: _lastMessageInfo->id);
-				block = QByteArray();
 				_lastMessageInfo = nullptr;
 				previous = nullptr;
 				saved = std::nullopt;
@@ -2784,11 +2790,14 @@ Result HtmlWriter::writeDialogSlice(const Data::MessagesSlice &data) {
 		}
 		const auto date = message.date;
 		if (DisplayDate(date, previous ? previous->date : 0)) {
-			block.append(_chat->pushServiceMessage(
+			const auto result = _chat->writeBlock(_chat->pushServiceMessage(
 				--_dateMessageId,
 				_dialog,
 				_settings.path,
 				FormatDateText(date)));
+			if (!result) {
+				return result;
+			}
 		}
 		const auto [info, content] = _chat->pushMessage(
 			message,
@@ -2798,7 +2807,9 @@ Result HtmlWriter::writeDialogSlice(const Data::MessagesSlice &data) {
 			data.peers,
 			_environment.internalLinksDomain,
 			messageLinkWrapper);
-		block.append(content);
+		if (const auto result = _chat->writeBlock(content); !result) {
+			return result;
+		}
 
 		++_messagesCount;
 		saved = info;
@@ -2807,7 +2818,7 @@ Result HtmlWriter::writeDialogSlice(const Data::MessagesSlice &data) {
 	if (saved) {
 		_lastMessageInfo = std::make_unique<MessageInfo>(*saved);
 	}
-	return block.isEmpty() ? Result::Success() : _chat->writeBlock(block);
+	return Result::Success();
 }
 
 Result HtmlWriter::writeEmptySinglePeer() {
@@ -3051,7 +3062,9 @@ Result HtmlWriter::switchToNextChatFile(int index) {
 	} else if (const auto end = _chat->close(); !end) {
 		return end;
 	}
-	_chat = fileWithRelativePath(_dialog.relativePath + nextPath);
+	_chat = fileWithRelativePath(
+		_dialog.relativePath + nextPath,
+		kFileBufferSize);
 	_chatFileEmpty = true;
 	return Result::Success();
 }
@@ -3111,11 +3124,13 @@ QString HtmlWriter::messagesFile(int index) const {
 }
 
 std::unique_ptr<HtmlWriter::Wrap> HtmlWriter::fileWithRelativePath(
-		const QString &path) const {
+		const QString &path,
+		int bufferSize) const {
 	return std::make_unique<Wrap>(
 		pathWithRelativePath(path),
 		_settings.path,
-		_stats);
+		_stats,
+		bufferSize);
 }
 
 HtmlWriter::~HtmlWriter() = default;
@@ -101,7 +101,8 @@ private:
 	[[nodiscard]] QString mainFileRelativePath() const;
 	[[nodiscard]] QString pathWithRelativePath(const QString &path) const;
 	[[nodiscard]] std::unique_ptr<Wrap> fileWithRelativePath(
-		const QString &path) const;
+		const QString &path,
+		int bufferSize = 0) const;
 	[[nodiscard]] QString messagesFile(int index) const;
 
 	[[nodiscard]] Result writeSavedContacts(const Data::ContactsList &data);
@@ -0,0 +1,240 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "export/output/export_output_journal.h"
+
+#include "export/export_settings.h"
+#include "export/output/export_output_abstract.h"
+#include "export/output/export_output_result.h"
+#include "base/flat_set.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QFileInfo>
+#include <QtCore/QDir>
+
+namespace Export {
+namespace Output {
+namespace {
+
+constexpr auto kJournalMagic = quint32(0x4A505845); // 'EXPJ'
+constexpr auto kJournalVersion = qint32(1);
+const auto kJournalName = u".export_journal"_q;
+
+enum class Record : qint32 {
+	FileStarted = 1,
+	FileFinished = 2,
+};
+
+[[nodiscard]] QByteArray Fingerprint(const Settings &settings) {
+	auto peer = mtpBuffer();
+	settings.singlePeer.write(peer);
+
+	auto result = QByteArray();
+	{
+		QDataStream stream(&result, QIODevice::WriteOnly);
+		stream.setVersion(QDataStream::Qt_5_1);
+		stream
+			<< quint32(settings.types)
+			<< quint32(settings.fullChats)
+			<< quint32(settings.format)
+			<< quint32(settings.media.types)
+			<< qint64(settings.media.sizeLimit)
+			<< qint32(settings.singlePeerFrom)
+			<< qint32(settings.singlePeerTill)
+			<< QByteArray(
+				reinterpret_cast<const char*>(peer.constData()),
+				peer.size() * sizeof(mtpPrime));
+	}
+	return result;
+}
+
+[[nodiscard]] bool ReadHeader(
+		QDataStream &stream,
+		const QByteArray &fingerprint,
+		quint64 *selfId = nullptr) {
+	auto magic = quint32();
+	auto version = qint32();
+	auto existing = QByteArray();
+	auto user = quint64();
+	stream >> magic >> version >> existing >> user;
+	if (stream.status() != QDataStream::Ok
+		|| magic != kJournalMagic
+		|| version != kJournalVersion
+		|| existing != fingerprint) {
+		return false;
+	} else if (selfId) {
+		*selfId = user;
+	}
+	return true;
+}
+
+} // namespace
+
+Journal::Journal(const QString &folder, const Settings &settings)
+: _folder(folder)
+, _fingerprint(Fingerprint(settings))
+, _file(folder + kJournalName) {
+}
+
+bool Journal::Resumable(
+		const QString &folder,
+		const Settings &settings,
+		uint64 selfId) {
+	auto file = QFile(folder + kJournalName);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_1);
+
+	// Don't continue an export of another account in the same folder.
+	auto user = quint64();
+	return ReadHeader(stream, Fingerprint(settings), &user)
+		&& (user == selfId);
+}
+
+Result Journal::start(uint64 selfId) {
+	readExisting(selfId);
+
+	// Rewrite the journal with the files that are still on disk.
+	if (!QDir().mkpath(_folder)
+		|| !_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		return error();
+	} else if (const auto result = writeHeader(selfId); !result) {
+		return result;
+	}
+	for (const auto &[key, entry] : _entries) {
+		if (const auto result = writeFinished(key, entry); !result) {
+			return result;
+		}
+	}
+	return Result::Success();
+}
+
+void Journal::readExisting(uint64 selfId) {
+	if (!_file.open(QIODevice::ReadOnly)) {
+		return;
+	}
+	QDataStream stream(&_file);
+	stream.setVersion(QDataStream::Qt_5_1);
+
+	auto user = quint64();
+	if (!ReadHeader(stream, _fingerprint, &user) || user != selfId) {
+		_file.close();
+		return;
+	}
+
+	// A crash could leave the last record written partially, so we
+	// read until the first bad record and ignore everything after it.
+	auto started = base::flat_set<QString>();
+	while (!stream.atEnd()) {
+		auto type = qint32();
+		auto relativePath = QString();
+		stream >> type >> relativePath;
+		if (stream.status() != QDataStream::Ok) {
+			break;
+		} else if (type == qint32(Record::FileStarted)) {
+			started.emplace(relativePath);
+			continue;
+		} else if (type != qint32(Record::FileFinished)) {
+			break;
+		}
+		auto key = JournalFileKey();
+		auto size = qint64();
+		stream >> key.type >> key.id >> size;
+		if (stream.status() != QDataStream::Ok) {
+			break;
+		}
+		started.remove(relativePath);
+		if (QFileInfo(_folder + relativePath).size() == size) {
+			_entries[key] = Entry{ relativePath, size };
+		} else {
+			QFile::remove(_folder + relativePath);
+		}
+	}
+	_file.close();
+
+	// Partially loaded files will be loaded from the beginning.
+	for (const auto &relativePath : started) {
+		QFile::remove(_folder + relativePath);
+	}
+}
+
+auto Journal::find(const JournalFileKey &key) const -> const Entry* {
+	const auto i = _entries.find(key);
+	return (i != end(_entries)) ? &i->second : nullptr;
+}
+
+Result Journal::fileStarted(const QString &relativePath) {
+	auto record = QByteArray();
+	{
+		QDataStream stream(&record, QIODevice::WriteOnly);
+		stream.setVersion(QDataStream::Qt_5_1);
+		stream << qint32(Record::FileStarted) << relativePath;
+	}
+	return append(record);
+}
+
+Result Journal::fileFinished(
+		const JournalFileKey &key,
+		const QString &relativePath,
+		int64 size) {
+	const auto &entry = _entries[key] = Entry{ relativePath, size };
+	return writeFinished(key, entry);
+}
+
+void Journal::finish() {
+	_file.close();
+	_file.remove();
+}
+
+Result Journal::writeHeader(uint64 selfId) {
+	auto record = QByteArray();
+	{
+		QDataStream stream(&record, QIODevice::WriteOnly);
+		stream.setVersion(QDataStream::Qt_5_1);
+		stream
+			<< kJournalMagic
+			<< kJournalVersion
+			<< _fingerprint
+			<< quint64(selfId);
+	}
+	return append(record);
+}
+
+Result Journal::writeFinished(
+		const JournalFileKey &key,
+		const Entry &entry) {
+	auto record = QByteArray();
+	{
+		QDataStream stream(&record, QIODevice::WriteOnly);
+		stream.setVersion(QDataStream::Qt_5_1);
+		stream
+			<< qint32(Record::FileFinished)
+			<< entry.relativePath
+			<< key.type
+			<< key.id
+			<< qint64(entry.size);
+	}
+	return append(record);
+}
+
+Result Journal::append(const QByteArray &record) {
+	if (!_file.isOpen()) {
+		return error();
+	} else if (_file.write(record) != record.size() || !_file.flush()) {
+		return error();
+	}
+	return Result::Success();
+}
+
+Result Journal::error() const {
+	return Result(Result::Type::Error, _file.fileName());
+}
+
+} // namespace Output
+} // namespace Export
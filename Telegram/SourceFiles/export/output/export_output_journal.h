@@ -0,0 +1,79 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include "base/flat_map.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QString>
+
+namespace Export {
+
+struct Settings;
+
+namespace Output {
+
+struct Result;
+class Stats;
+
+struct JournalFileKey {
+	uint64 type = 0;
+	uint64 id = 0;
+
+	friend inline auto operator<=>(
+		const JournalFileKey &,
+		const JournalFileKey &) = default;
+	friend inline bool operator==(
+		const JournalFileKey &,
+		const JournalFileKey &) = default;
+};
+
+// Remembers the media files already written to the export folder, so
+// that an interrupted export started again with the same settings can
+// continue in the same folder without loading those files again.
+class Journal {
+public:
+	struct Entry {
+		QString relativePath;
+		int64 size = 0;
+	};
+
+	Journal(const QString &folder, const Settings &settings);
+
+	[[nodiscard]] static bool Resumable(
+		const QString &folder,
+		const Settings &settings,
+		uint64 selfId);
+
+	[[nodiscard]] Result start(uint64 selfId);
+	[[nodiscard]] const Entry *find(const JournalFileKey &key) const;
+	[[nodiscard]] Result fileStarted(const QString &relativePath);
+	[[nodiscard]] Result fileFinished(
+		const JournalFileKey &key,
+		const QString &relativePath,
+		int64 size);
+	void finish();
+
+private:
+	void readExisting(uint64 selfId);
+	[[nodiscard]] Result writeHeader(uint64 selfId);
+	[[nodiscard]] Result writeFinished(
+		const JournalFileKey &key,
+		const Entry &entry);
+	[[nodiscard]] Result append(const QByteArray &record);
+	[[nodiscard]] Result error() const;
+
+	QString _folder;
+	QByteArray _fingerprint;
+	QFile _file;
+	base::flat_map<JournalFileKey, Entry> _entries;
+
+};
+
+} // namespace Output
+} // namespace Export
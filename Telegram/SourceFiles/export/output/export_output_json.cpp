@@ -103,8 +103,16 @@ QByteArray SerializeObject(
 	const auto guard = gsl::finally([&] { context.nesting.pop_back(); });
 	const auto next = '\n' + Indentation(context);
 
+	auto size = 2 + indent.size() + 1;
+	for (const auto &[key, value] : values) {
+		if (!value.isEmpty()) {
+			size += 1 + next.size() + key.size() + 4 + value.size();
+		}
+	}
+
 	auto first = true;
 	auto result = QByteArray();
+	result.reserve(size);
 	result.append('{');
 	for (const auto &[key, value] : values) {
 		if (value.isEmpty()) {
@@ -128,8 +136,14 @@ QByteArray SerializeArray(
 	const auto indent = Indentation(context.nesting.size());
 	const auto next = '\n' + Indentation(context.nesting.size() + 1);
 
+	auto size = 2 + indent.size() + 1;
+	for (const auto &value : values) {
+		size += 1 + next.size() + value.size();
+	}
+
 	auto first = true;
 	auto result = QByteArray();
+	result.reserve(size);
 	result.append('[');
 	for (const auto &value : values) {
 		if (first) {
@@ -791,7 +805,7 @@ Result JsonWriter::start(
 	_settings = base::duplicate(settings);
 	_environment = environment;
 	_stats = stats;
-	_output = fileWithRelativePath(mainFileRelativePath());
+	_output = fileWithRelativePath(mainFileRelativePath(), kFileBufferSize);
 	if (_settings.onlySinglePeer()) {
 		return Result::Success();
 	}
@@ -1306,18 +1320,23 @@ Result JsonWriter::validateDialogsMode(bool isLeftChannel) {
 Result JsonWriter::writeDialogSlice(const Data::MessagesSlice &data) {
 	Expects(_output != nullptr);
 
-	auto block = QByteArray();
+	// Messages go to the file buffer one by one, without collecting
+	// the whole slice in memory.
 	for (const auto &message : data.list) {
 		if (Data::SkipMessageByDate(message, _settings)) {
 			continue;
 		}
-		block.append(prepareArrayItemStart() + SerializeMessage(
+		auto block = prepareArrayItemStart();
+		block.append(SerializeMessage(
 			_context,
 			message,
 			data.peers,
 			_environment.internalLinksDomain));
+		if (const auto result = _output->writeBlock(block); !result) {
+			return result;
+		}
 	}
-	return block.isEmpty() ? Result::Success() : _output->writeBlock(block);
+	return Result::Success();
 }
 
 Result JsonWriter::writeDialogEnd() {
@@ -1359,11 +1378,14 @@ Result JsonWriter::finish() {
 
 	if (_settings.onlySinglePeer()) {
 		Assert(_context.nesting.empty());
-		return Result::Success();
+		return _output->flush();
 	}
 	auto block = popNesting();
 	Assert(_context.nesting.empty());
-	return _output->writeBlock(block);
+	if (const auto result = _output->writeBlock(block); !result) {
+		return result;
+	}
+	return _output->flush();
 }
 
 QString JsonWriter::mainFilePath() {
@@ -1379,8 +1401,12 @@ QString JsonWriter::pathWithRelativePath(const QString &path) const {
 }
 
 std::unique_ptr<File> JsonWriter::fileWithRelativePath(
-		const QString &path) const {
-	return std::make_unique<File>(pathWithRelativePath(path), _stats);
+		const QString &path,
+		int bufferSize) const {
+	return std::make_unique<File>(
+		pathWithRelativePath(path),
+		_stats,
+		bufferSize);
 }
 
 } // namespace Output
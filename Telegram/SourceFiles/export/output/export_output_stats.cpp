@@ -19,7 +19,7 @@ void Stats::incrementFiles() {
 	++_files;
 }
 
-void Stats::incrementBytes(int count) {
+void Stats::incrementBytes(int64 count) {
 	_bytes += count;
 }
 
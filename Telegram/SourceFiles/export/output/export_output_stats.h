@@ -18,7 +18,7 @@ public:
 	Stats(const Stats &other);
 
 	void incrementFiles();
-	void incrementBytes(int count);
+	void incrementBytes(int64 count);
 
 	int filesCount() const;
 	int64 bytesCount() const;
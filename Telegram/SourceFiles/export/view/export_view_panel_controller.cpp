@@ -85,6 +85,7 @@ void SuggestBox::prepare() {
 
 Environment PrepareEnvironment(not_null<Main::Session*> session) {
 	auto result = Environment();
+	result.selfId = session->userId().bare;
 	result.internalLinksDomain = session->serverConfig().internalLinksDomain;
 	result.aboutTelegram = tr::lng_export_about_telegram(tr::now).toUtf8();
 	result.aboutContacts = tr::lng_export_about_contacts(tr::now).toUtf8();
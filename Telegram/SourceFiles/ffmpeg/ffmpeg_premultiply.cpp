@@ -0,0 +1,385 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "ffmpeg/ffmpeg_premultiply.h"
+
+#include <QtGui/QImage>
+
+#ifdef LIB_FFMPEG_USE_QT_PRIVATE_API
+#include <private/qdrawhelper_p.h>
+#elif defined Q_PROCESSOR_X86 // LIB_FFMPEG_USE_QT_PRIVATE_API
+#define LIB_FFMPEG_USE_X86_KERNELS
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
+#endif // LIB_FFMPEG_USE_QT_PRIVATE_API || Q_PROCESSOR_X86
+
+#ifdef LIB_FFMPEG_USE_X86_KERNELS
+#if defined __GNUC__ || defined __clang__
+#define LIB_FFMPEG_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define LIB_FFMPEG_TARGET_AVX2 __attribute__((target("avx2")))
+#else // __GNUC__ || __clang__
+#define LIB_FFMPEG_TARGET_SSE41
+#define LIB_FFMPEG_TARGET_AVX2
+#endif // __GNUC__ || __clang__
+#endif // LIB_FFMPEG_USE_X86_KERNELS
+
+namespace FFmpeg {
+namespace {
+
+#ifndef LIB_FFMPEG_USE_QT_PRIVATE_API
+
+using LineMethod = void(*)(uchar *dst, const uchar *src, int intsCount);
+
+struct LineMethods {
+	LineMethod premultiply = nullptr;
+	LineMethod unpremultiply = nullptr;
+};
+
+void PremultiplyLineScalar(uchar *dst, const uchar *src, int intsCount) {
+	const auto udst = reinterpret_cast<uint*>(dst);
+	const auto usrc = reinterpret_cast<const uint*>(src);
+	for (auto i = 0; i != intsCount; ++i) {
+		udst[i] = qPremultiply(usrc[i]);
+	}
+}
+
+void UnPremultiplyLineScalar(uchar *dst, const uchar *src, int intsCount) {
+	const auto udst = reinterpret_cast<uint*>(dst);
+	const auto usrc = reinterpret_cast<const uint*>(src);
+	for (auto i = 0; i != intsCount; ++i) {
+		udst[i] = qUnpremultiply(usrc[i]);
+	}
+}
+
+#ifdef LIB_FFMPEG_USE_X86_KERNELS
+
+// qUnpremultiply computes (channel * factor + 0x8000) >> 16, where the
+// factor depends on the alpha and on the Qt version. We find the table
+// that gives exactly the same results with the Qt we're running with.
+struct UnpremultiplyFactors {
+	std::array<uint32, 256> values = { { 0 } };
+	bool valid = false;
+};
+
+[[nodiscard]] UnpremultiplyFactors ComputeUnpremultiplyFactors() {
+	const auto candidates = std::array<uint32(*)(uint32), 3>{ {
+		[](uint32 alpha) { return 0x00FF00FFU / alpha; },
+		[](uint32 alpha) { return 0x00FF0000U / alpha; },
+		[](uint32 alpha) { return (0x00FF0000U + (alpha / 2)) / alpha; },
+	} };
+	const auto check = [](const UnpremultiplyFactors &factors) {
+		for (auto alpha = 0U; alpha != 256U; ++alpha) {
+			for (auto channel = 0U; channel != 256U; ++channel) {
+				const auto pixel = (alpha << 24)
+					| (channel << 16)
+					| ((255U - channel) << 8)
+					| (channel / 2);
+				const auto factor = factors.values[alpha];
+				const auto convert = [&](uint32 value) {
+					return ((value * factor + 0x8000U) >> 16) & 0xFFU;
+				};
+				const auto expected = (alpha << 24)
+					| (convert(channel) << 16)
+					| (convert(255U - channel) << 8)
+					| convert(channel / 2);
+				if (qUnpremultiply(pixel) != expected) {
+					return false;
+				}
+			}
+		}
+		return true;
+	};
+	auto result = UnpremultiplyFactors();
+	for (const auto candidate : candidates) {
+		for (auto alpha = 1U; alpha != 256U; ++alpha) {
+			result.values[alpha] = candidate(alpha);
+		}
+		if (check(result)) {
+			result.valid = true;
+			break;
+		}
+	}
+	return result;
+}
+
+[[nodiscard]] const UnpremultiplyFactors &GetUnpremultiplyFactors() {
+	static const auto result = ComputeUnpremultiplyFactors();
+	return result;
+}
+
+[[nodiscard]] bool CpuSupportsSse41() {
+#ifdef _MSC_VER
+	int info[4] = { 0 };
+	__cpuid(info, 1);
+	return (info[2] & (1 << 19)) != 0;
+#else // _MSC_VER
+	return __builtin_cpu_supports("sse4.1");
+#endif // _MSC_VER
+}
+
+[[nodiscard]] bool CpuSupportsAvx2() {
+#ifdef _MSC_VER
+	int info[4] = { 0 };
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+	__cpuid(info, 1);
+	const auto osxsave = (info[2] & (1 << 27)) != 0;
+	const auto avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else // _MSC_VER
+	return __builtin_cpu_supports("avx2");
+#endif // _MSC_VER
+}
+
+// Premultiplication is done on 16 bit channels as in qPremultiply:
+// (x * alpha + ((x * alpha) >> 8) + 0x80) >> 8, the alpha channel
+// is multiplied by 255, which leaves it unchanged with this formula.
+
+LIB_FFMPEG_TARGET_SSE41 inline __m128i PremultiplySse41(__m128i channels) {
+	const auto alpha = _mm_shufflehi_epi16(
+		_mm_shufflelo_epi16(channels, 0xFF),
+		0xFF);
+	const auto factor = _mm_or_si128(
+		alpha,
+		_mm_set1_epi64x(0x00FF000000000000LL));
+	const auto product = _mm_mullo_epi16(channels, factor);
+	return _mm_srli_epi16(
+		_mm_add_epi16(
+			_mm_add_epi16(product, _mm_srli_epi16(product, 8)),
+			_mm_set1_epi16(0x80)),
+		8);
+}
+
+LIB_FFMPEG_TARGET_SSE41 void PremultiplyLineSse41(
+		uchar *dst,
+		const uchar *src,
+		int intsCount) {
+	const auto zero = _mm_setzero_si128();
+	auto i = 0;
+	for (; i + 4 <= intsCount; i += 4) {
+		const auto pixels = _mm_loadu_si128(
+			reinterpret_cast<const __m128i*>(src + i * 4));
+		const auto low = PremultiplySse41(_mm_unpacklo_epi8(pixels, zero));
+		const auto high = PremultiplySse41(_mm_unpackhi_epi8(pixels, zero));
+		_mm_storeu_si128(
+			reinterpret_cast<__m128i*>(dst + i * 4),
+			_mm_packus_epi16(low, high));
+	}
+	PremultiplyLineScalar(dst + i * 4, src + i * 4, intsCount - i);
+}
+
+LIB_FFMPEG_TARGET_AVX2 inline __m256i PremultiplyAvx2(__m256i channels) {
+	const auto alpha = _mm256_shufflehi_epi16(
+		_mm256_shufflelo_epi16(channels, 0xFF),
+		0xFF);
+	const auto factor = _mm256_or_si256(
+		alpha,
+		_mm256_set1_epi64x(0x00FF000000000000LL));
+	const auto product = _mm256_mullo_epi16(channels, factor);
+	return _mm256_srli_epi16(
+		_mm256_add_epi16(
+			_mm256_add_epi16(product, _mm256_srli_epi16(product, 8)),
+			_mm256_set1_epi16(0x80)),
+		8);
+}
+
+LIB_FFMPEG_TARGET_AVX2 void PremultiplyLineAvx2(
+		uchar *dst,
+		const uchar *src,
+		int intsCount) {
+	const auto zero = _mm256_setzero_si256();
+	auto i = 0;
+	for (; i + 8 <= intsCount; i += 8) {
+		const auto pixels = _mm256_loadu_si256(
+			reinterpret_cast<const __m256i*>(src + i * 4));
+		const auto low = PremultiplyAvx2(_mm256_unpacklo_epi8(pixels, zero));
+		const auto high = PremultiplyAvx2(_mm256_unpackhi_epi8(pixels, zero));
+		_mm256_storeu_si256(
+			reinterpret_cast<__m256i*>(dst + i * 4),
+			_mm256_packus_epi16(low, high));
+	}
+	PremultiplyLineSse41(dst + i * 4, src + i * 4, intsCount - i);
+}
+
+// Unpremultiplication is done on 32 bit channels as in qUnpremultiply,
+// the channels are masked, not saturated, as qRgba() does it.
+
+LIB_FFMPEG_TARGET_SSE41 inline __m128i UnPremultiplySse41(
+		__m128i channels,
+		__m128i factor) {
+	return _mm_and_si128(
+		_mm_srli_epi32(
+			_mm_add_epi32(
+				_mm_mullo_epi32(channels, factor),
+				_mm_set1_epi32(0x8000)),
+			16),
+		_mm_set1_epi32(0xFF));
+}
+
+LIB_FFMPEG_TARGET_SSE41 void UnPremultiplyLineSse41(
+		uchar *dst,
+		const uchar *src,
+		int intsCount) {
+	const auto factors = GetUnpremultiplyFactors().values.data();
+	const auto usrc = reinterpret_cast<const uint*>(src);
+	const auto zero = _mm_setzero_si128();
+	const auto alphaMask = _mm_set1_epi32(0xFF000000);
+	auto i = 0;
+	for (; i + 4 <= intsCount; i += 4) {
+		const auto pixels = _mm_loadu_si128(
+			reinterpret_cast<const __m128i*>(src + i * 4));
+		const auto factor = _mm_setr_epi32(
+			factors[usrc[i] >> 24],
+			factors[usrc[i + 1] >> 24],
+			factors[usrc[i + 2] >> 24],
+			factors[usrc[i + 3] >> 24]);
+		const auto low = _mm_unpacklo_epi8(pixels, zero);
+		const auto high = _mm_unpackhi_epi8(pixels, zero);
+		const auto first = _mm_packus_epi32(
+			UnPremultiplySse41(
+				_mm_unpacklo_epi16(low, zero),
+				_mm_shuffle_epi32(factor, 0x00)),
+			UnPremultiplySse41(
+				_mm_unpackhi_epi16(low, zero),
+				_mm_shuffle_epi32(factor, 0x55)));
+		const auto second = _mm_packus_epi32(
+			UnPremultiplySse41(
+				_mm_unpacklo_epi16(high, zero),
+				_mm_shuffle_epi32(factor, 0xAA)),
+			UnPremultiplySse41(
+				_mm_unpackhi_epi16(high, zero),
+				_mm_shuffle_epi32(factor, 0xFF)));
+		_mm_storeu_si128(
+			reinterpret_cast<__m128i*>(dst + i * 4),
+			_mm_blendv_epi8(
+				_mm_packus_epi16(first, second),
+				pixels,
+				alphaMask));
+	}
+	UnPremultiplyLineScalar(dst + i * 4, src + i * 4, intsCount - i);
+}
+
+LIB_FFMPEG_TARGET_AVX2 inline __m256i UnPremultiplyAvx2(
+		__m256i channels,
+		__m256i factor) {
+	return _mm256_and_si256(
+		_mm256_srli_epi32(
+			_mm256_add_epi32(
+				_mm256_mullo_epi32(channels, factor),
+				_mm256_set1_epi32(0x8000)),
+			16),
+		_mm256_set1_epi32(0xFF));
+}
+
+LIB_FFMPEG_TARGET_AVX2 void UnPremultiplyLineAvx2(
+		uchar *dst,
+		const uchar *src,
+		int intsCount) {
+	const auto factors = reinterpret_cast<const int*>(
+		GetUnpremultiplyFactors().values.data());
+	const auto zero = _mm256_setzero_si256();
+	const auto alphaMask = _mm256_set1_epi32(0xFF000000);
+	auto i = 0;
+	for (; i + 8 <= intsCount; i += 8) {
+		const auto pixels = _mm256_loadu_si256(
+			reinterpret_cast<const __m256i*>(src + i * 4));
+		const auto factor = _mm256_i32gather_epi32(
+			factors,
+			_mm256_srli_epi32(pixels, 24),
+			4);
+
+		// Unpacking and packing work inside 128 bit lanes, so pixels
+		// keep their order and each one takes its factor from its lane.
+		const auto low = _mm256_unpacklo_epi8(pixels, zero);
+		const auto high = _mm256_unpackhi_epi8(pixels, zero);
+		const auto first = _mm256_packus_epi32(
+			UnPremultiplyAvx2(
+				_mm256_unpacklo_epi16(low, zero),
+				_mm256_shuffle_epi32(factor, 0x00)),
+			UnPremultiplyAvx2(
+				_mm256_unpackhi_epi16(low, zero),
+				_mm256_shuffle_epi32(factor, 0x55)));
+		const auto second = _mm256_packus_epi32(
+			UnPremultiplyAvx2(
+				_mm256_unpacklo_epi16(high, zero),
+				_mm256_shuffle_epi32(factor, 0xAA)),
+			UnPremultiplyAvx2(
+				_mm256_unpackhi_epi16(high, zero),
+				_mm256_shuffle_epi32(factor, 0xFF)));
+		_mm256_storeu_si256(
+			reinterpret_cast<__m256i*>(dst + i * 4),
+			_mm256_blendv_epi8(
+				_mm256_packus_epi16(first, second),
+				pixels,
+				alphaMask));
+	}
+	UnPremultiplyLineSse41(dst + i * 4, src + i * 4, intsCount - i);
+}
+
+#endif // LIB_FFMPEG_USE_X86_KERNELS
+
+[[nodiscard]] LineMethods ChooseLineMethods() {
+	auto result = LineMethods{
+		.premultiply = PremultiplyLineScalar,
+		.unpremultiply = UnPremultiplyLineScalar,
+	};
+#ifdef LIB_FFMPEG_USE_X86_KERNELS
+	// Other architectures (like NEON on arm64) may add their kernels here.
+	const auto unpremultiply = GetUnpremultiplyFactors().valid;
+	if (CpuSupportsAvx2()) {
+		result.premultiply = PremultiplyLineAvx2;
+		if (unpremultiply) {
+			result.unpremultiply = UnPremultiplyLineAvx2;
+		}
+	} else if (CpuSupportsSse41()) {
+		result.premultiply = PremultiplyLineSse41;
+		if (unpremultiply) {
+			result.unpremultiply = UnPremultiplyLineSse41;
+		}
+	}
+#endif // LIB_FFMPEG_USE_X86_KERNELS
+	return result;
+}
+
+[[nodiscard]] const LineMethods &GetLineMethods() {
+	static const auto result = ChooseLineMethods();
+	return result;
+}
+
+#endif // !LIB_FFMPEG_USE_QT_PRIVATE_API
+
+} // namespace
+
+void UnPremultiplyLine(uchar *dst, const uchar *src, int intsCount) {
+#ifndef LIB_FFMPEG_USE_QT_PRIVATE_API
+	GetLineMethods().unpremultiply(dst, src, intsCount);
+#else // !LIB_FFMPEG_USE_QT_PRIVATE_API
+	static const auto layout = &qPixelLayouts[QImage::Format_ARGB32];
+	const auto usrc = reinterpret_cast<const uint*>(src);
+	layout->storeFromARGB32PM(dst, usrc, 0, intsCount, nullptr, nullptr);
+#endif // LIB_FFMPEG_USE_QT_PRIVATE_API
+}
+
+void PremultiplyLine(uchar *dst, const uchar *src, int intsCount) {
+#ifndef LIB_FFMPEG_USE_QT_PRIVATE_API
+	GetLineMethods().premultiply(dst, src, intsCount);
+#else // !LIB_FFMPEG_USE_QT_PRIVATE_API
+	static const auto layout = &qPixelLayouts[QImage::Format_ARGB32];
+	const auto udst = reinterpret_cast<uint*>(dst);
+	layout->fetchToARGB32PM(udst, src, 0, intsCount, nullptr, nullptr);
+#endif // LIB_FFMPEG_USE_QT_PRIVATE_API
+}
+
+} // namespace FFmpeg
@@ -0,0 +1,17 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+namespace FFmpeg {
+
+// Convert lines of QImage::Format_ARGB32 <-> ARGB32_Premultiplied pixels,
+// dst may be the same as src. Results match qPremultiply / qUnpremultiply.
+void PremultiplyLine(uchar *dst, const uchar *src, int intsCount);
+void UnPremultiplyLine(uchar *dst, const uchar *src, int intsCount);
+
+} // namespace FFmpeg
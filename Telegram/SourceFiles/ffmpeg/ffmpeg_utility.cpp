@@ -7,6 +7,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 */
 #include "ffmpeg/ffmpeg_utility.h"
 
+#include "ffmpeg/ffmpeg_premultiply.h"
 #include "base/algorithm.h"
 #include "logs.h"
 
@@ -17,10 +18,6 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include <QImage>
 
-#ifdef LIB_FFMPEG_USE_QT_PRIVATE_API
-#include <private/qdrawhelper_p.h>
-#endif // LIB_FFMPEG_USE_QT_PRIVATE_API
-
 extern "C" {
 #include <libavutil/opt.h>
 } // extern "C"
@@ -62,34 +59,6 @@ void AlignedImageBufferCleanupHandler(void* data) {
 		&& !(image.bytesPerLine() % kAlignImageBy);
 }
 
-void UnPremultiplyLine(uchar *dst, const uchar *src, int intsCount) {
-	[[maybe_unused]] const auto udst = reinterpret_cast<uint*>(dst);
-	const auto usrc = reinterpret_cast<const uint*>(src);
-
-#ifndef LIB_FFMPEG_USE_QT_PRIVATE_API
-	for (auto i = 0; i != intsCount; ++i) {
-		udst[i] = qUnpremultiply(usrc[i]);
-	}
-#else // !LIB_FFMPEG_USE_QT_PRIVATE_API
-	static const auto layout = &qPixelLayouts[QImage::Format_ARGB32];
-	layout->storeFromARGB32PM(dst, usrc, 0, intsCount, nullptr, nullptr);
-#endif // LIB_FFMPEG_USE_QT_PRIVATE_API
-}
-
-void PremultiplyLine(uchar *dst, const uchar *src, int intsCount) {
-	const auto udst = reinterpret_cast<uint*>(dst);
-	[[maybe_unused]] const auto usrc = reinterpret_cast<const uint*>(src);
-
-#ifndef LIB_FFMPEG_USE_QT_PRIVATE_API
-	for (auto i = 0; i != intsCount; ++i) {
-		udst[i] = qPremultiply(usrc[i]);
-	}
-#else // !LIB_FFMPEG_USE_QT_PRIVATE_API
-	static const auto layout = &qPixelLayouts[QImage::Format_ARGB32];
-	layout->fetchToARGB32PM(udst, src, 0, intsCount, nullptr, nullptr);
-#endif // LIB_FFMPEG_USE_QT_PRIVATE_API
-}
-
 #if !defined TDESKTOP_USE_PACKAGED && !defined Q_OS_WIN && !defined Q_OS_MAC
 [[nodiscard]] auto CheckHwLibs() {
 	auto list = std::deque{
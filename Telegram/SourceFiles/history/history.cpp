@@ -38,6 +38,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "data/data_user.h"
 #include "data/data_document.h"
 #include "data/data_histories.h"
+#include "data/data_history_cache.h"
 #include "lang/lang_keys.h"
 #include "apiwrap.h"
 #include "api/api_chat_participants.h"
@@ -68,6 +69,11 @@ namespace {
 constexpr auto kNewBlockEachMessage = 50;
 constexpr auto kSkipCloudDraftsFor = TimeId(2);
 
+// Rough size of a message with its components and indices, not counting
+// the text, so that we have something to compare with the memory limit.
+constexpr auto kMessageBaseBytes = 1024;
+constexpr auto kMessageMediaBytes = 512;
+
 using UpdateFlag = Data::HistoryUpdate::Flag;
 
 } // namespace
@@ -494,6 +500,11 @@ void History::destroyMessage(not_null<HistoryItem*> item) {
 		session().api().cancelLocalItem(item);
 	}
 
+	owner().unregisterMessage(item);
+	eraseMessage(item);
+}
+
+void History::eraseMessage(not_null<HistoryItem*> item) {
 	const auto documentToCancel = [&] {
 		const auto media = item->isAdminLogEntry()
 			? nullptr
@@ -501,7 +512,6 @@ void History::destroyMessage(not_null<HistoryItem*> item) {
 		return media ? media->document() : nullptr;
 	}();
 
-	owner().unregisterMessage(item);
 	Core::App().notifications().clearFromItem(item);
 
 	auto hack = std::unique_ptr<HistoryItem>(item.get());
@@ -516,6 +526,66 @@ void History::destroyMessage(not_null<HistoryItem*> item) {
 	}
 }
 
+int History::messagesCount() const {
+	return int(_messages.size());
+}
+
+int64 History::messagesBytesEstimate() const {
+	auto result = int64();
+	for (const auto &item : _messages) {
+		const auto &text = item->originalText();
+		result += kMessageBaseBytes
+			+ text.text.size() * sizeof(QChar)
+			+ text.entities.size() * sizeof(EntityInText)
+			+ (item->media() ? kMessageMediaBytes : 0);
+	}
+	return result;
+}
+
+bool History::canUnloadMessage(not_null<HistoryItem*> item) {
+	// Keep everything that the chats list, the unread counters
+	// or some other messages still need.
+	if (!item->isRegular()
+		|| item == lastMessage()
+		|| item == lastServerMessage()
+		|| item == chatListMessage()
+		|| item == _joinedMessage
+		|| item->id == lastKeyboardId
+		|| item->unread(this)
+		|| item->isUnreadMention()
+		|| item->hasUnreadReaction()
+		|| owner().hasItemViews(item)
+		|| owner().hasDependentMessages(item)) {
+		return false;
+	} else if (const auto topic = item->topic()) {
+		if (item == topic->lastMessage()
+			|| item == topic->chatListMessage()) {
+			return false;
+		}
+	}
+	const auto media = item->media();
+	const auto document = media ? media->document() : nullptr;
+	const auto photo = media ? media->photo() : nullptr;
+	return !(document && document->loading())
+		&& !(photo && photo->loading());
+}
+
+void History::unloadMessages() {
+	Expects(isEmpty());
+
+	auto unload = std::vector<not_null<HistoryItem*>>();
+	unload.reserve(_messages.size());
+	for (const auto &item : _messages) {
+		if (canUnloadMessage(item.get())) {
+			unload.push_back(item.get());
+		}
+	}
+	for (const auto item : unload) {
+		owner().unloadMessage(item);
+		eraseMessage(item);
+	}
+}
+
 void History::destroyMessagesByDates(TimeId minDate, TimeId maxDate) {
 	auto toDestroy = std::vector<not_null<HistoryItem*>>();
 	toDestroy.reserve(_messages.size());
@@ -3403,6 +3473,7 @@ void History::clear(ClearType type) {
 		}
 		clearNotifications();
 		owner().notifyHistoryCleared(this);
+		owner().historyCache().remove(peer);
 		if (unreadCountKnown()) {
 			setUnreadCount(0);
 		}
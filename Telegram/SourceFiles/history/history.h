@@ -139,6 +139,13 @@ public:
 	void destroyMessagesByDates(TimeId minDate, TimeId maxDate);
 	void destroyMessagesByTopic(MsgId topicRootId);
 
+	[[nodiscard]] int messagesCount() const;
+	[[nodiscard]] int64 messagesBytesEstimate() const;
+
+	// Frees the messages that will be requested again when they're needed.
+	// The history should not be displayed anywhere while doing that.
+	void unloadMessages();
+
 	void unpinMessagesFor(MsgId topicRootId);
 
 	not_null<HistoryItem*> addNewMessage(
@@ -583,6 +590,9 @@ private:
 	HistoryItem *insertJoinedMessage();
 	void insertMessageToBlocks(not_null<HistoryItem*> item);
 
+	void eraseMessage(not_null<HistoryItem*> item);
+	[[nodiscard]] bool canUnloadMessage(not_null<HistoryItem*> item);
+
 	[[nodiscard]] Dialogs::BadgesState computeBadgesState() const;
 	[[nodiscard]] Dialogs::BadgesState adjustBadgesStateByFolder(
 		Dialogs::BadgesState state) const;
@@ -14,6 +14,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "api/api_sending.h"
 #include "api/api_send_progress.h"
 #include "api/api_unread_things.h"
+#include "api/api_updates.h"
 #include "ui/boxes/confirm_box.h"
 #include "boxes/delete_messages_box.h"
 #include "boxes/send_files_box.h"
@@ -70,6 +71,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "data/data_sponsored_messages.h"
 #include "data/data_file_origin.h"
 #include "data/data_histories.h"
+#include "data/data_history_cache.h"
 #include "data/data_group_call.h"
 #include "data/stickers/data_stickers.h"
 #include "data/stickers/data_custom_emoji.h"
@@ -3396,12 +3398,65 @@ void HistoryWidget::firstLoadMessages() {
 		}
 	}
 
+	if (from == _history && !offsetId && !offset) {
+		firstLoadMessagesFromCache(loadCount);
+	} else {
+		sendFirstLoadRequest(from, offsetId, offset, loadCount);
+	}
+}
+
+void HistoryWidget::firstLoadMessagesFromCache(int loadCount) {
+	Expects(_history != nullptr);
+
+	const auto history = _history;
+	const auto lookupId = ++_firstLoadCacheLookupId;
+	_firstLoadRequest = -1; // hack - wait for the local cache lookup
+	auto &cache = history->owner().historyCache();
+	cache.load(history->peer, crl::guard(this, [=](
+			std::optional<Data::HistoryCacheSlice> slice) {
+		if (_history != history
+			|| _firstLoadRequest != -1
+			|| _firstLoadCacheLookupId != lookupId) {
+			return;
+		} else if (!slice || !slice->pts || !history->isEmpty()) {
+			// Without pts we can't tell what changed in the cached page.
+			_firstLoadRequest = 0;
+			sendFirstLoadRequest(history, MsgId(), 0, loadCount);
+			return;
+		}
+		const auto channel = history->peer->asChannel();
+		const auto actual = channel && (channel->pts() == slice->pts);
+
+		messagesReceived(history->peer, slice->messages, _firstLoadRequest);
+		if (actual || _history != history || history->isEmpty()) {
+			return;
+		}
+
+		// Something happened in the channel since the page was cached.
+		// Load the newer messages and validate the cached ones by the
+		// changes since the pts they were cached with.
+		const auto last = history->lastMessage();
+		if (!last || !last->mainView()) {
+			history->setNotLoadedAtBottom();
+		}
+		session().updates().requestChannelRangeDifference(
+			history,
+			slice->pts);
+		preloadHistoryIfNeeded();
+	}));
+}
+
+void HistoryWidget::sendFirstLoadRequest(
+		not_null<History*> history,
+		MsgId offsetId,
+		int offset,
+		int loadCount) {
 	const auto offsetDate = 0;
 	const auto maxId = 0;
 	const auto minId = 0;
 	const auto historyHash = uint64(0);
+	const auto cacheResult = !offsetId && !offset;
 
-	const auto history = from;
 	const auto type = Data::Histories::RequestType::History;
 	auto &histories = history->owner().histories();
 	_firstLoadRequest = histories.sendRequest(history, type, [=](Fn<void()> finish) {
@@ -3415,6 +3470,9 @@ void HistoryWidget::firstLoadMessages() {
 			MTP_int(minId),
 			MTP_long(historyHash)
 		)).done([=](const MTPmessages_Messages &result) {
+			if (cacheResult) {
+				history->owner().historyCache().store(history->peer, result);
+			}
 			messagesReceived(history->peer, result, _firstLoadRequest);
 			finish();
 		}).fail([=](const MTP::Error &error) {
@@ -145,6 +145,12 @@ public:
 	void loadMessages();
 	void loadMessagesDown();
 	void firstLoadMessages();
+	void firstLoadMessagesFromCache(int loadCount);
+	void sendFirstLoadRequest(
+		not_null<History*> history,
+		MsgId offsetId,
+		int offset,
+		int loadCount);
 	void delayedShowAt(
 		MsgId showAtMsgId,
 		const TextWithEntities &highlightPart,
@@ -699,6 +705,7 @@ private:
 	int _showAtMsgHighlightPartOffsetHint = 0;
 
 	int _firstLoadRequest = 0; // Not real mtpRequestId.
+	uint64 _firstLoadCacheLookupId = 0;
 	int _preloadRequest = 0; // Not real mtpRequestId.
 	int _preloadDownRequest = 0; // Not real mtpRequestId.
 
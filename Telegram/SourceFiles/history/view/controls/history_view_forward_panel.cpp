@@ -13,6 +13,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "history/history_item_components.h"
 #include "history/view/history_view_item_preview.h"
 #include "data/data_session.h"
+#include "data/data_histories.h"
 #include "data/data_media_types.h"
 #include "data/data_forum_topic.h"
 #include "main/main_session.h"
@@ -89,10 +90,13 @@ void ForwardPanel::update(
 	if (!empty()) {
 		Assert(to != nullptr);
 
-		_data.items.front()->history()->owner().itemRemoved(
+		const auto history = _data.items.front()->history();
+		history->owner().itemRemoved(
 		) | rpl::start_with_next([=](not_null<const HistoryItem*> item) {
 			itemRemoved(item);
 		}, _dataLifetime);
+		_dataLifetime.add(
+			history->owner().histories().preventUnload(history));
 
 		if (const auto topic = _to->asTopic()) {
 			topic->destroyed(
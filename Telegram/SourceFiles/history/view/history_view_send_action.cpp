@@ -137,6 +137,10 @@ bool SendActionPainter::updateNeedsAnimating(
 	return updateNeedsAnimating(now, true);
 }
 
+bool SendActionPainter::animating() const {
+	return _sendActionAnimation || _speakingAnimation;
+}
+
 bool SendActionPainter::paint(
 		Painter &p,
 		int x,
@@ -48,6 +48,7 @@ public:
 		int outerWidth,
 		style::color color,
 		crl::time now);
+	[[nodiscard]] bool animating() const;
 
 	bool updateNeedsAnimating(
 		crl::time now,
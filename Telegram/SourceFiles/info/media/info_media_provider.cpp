@@ -17,6 +17,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "history/history_item.h"
 #include "history/history_item_helpers.h"
 #include "data/data_session.h"
+#include "data/data_histories.h"
 #include "data/data_chat.h"
 #include "data/data_channel.h"
 #include "data/data_forum_topic.h"
@@ -75,6 +76,13 @@ Provider::Provider(not_null<AbstractController*> controller)
 		itemRemoved(item);
 	}, _lifetime);
 
+	const auto owner = &_controller->session().data();
+	auto &histories = owner->histories();
+	_lifetime.add(histories.preventUnload(owner->history(_peer)));
+	if (_migrated) {
+		_lifetime.add(histories.preventUnload(owner->history(_migrated)));
+	}
+
 	style::PaletteChanged(
 	) | rpl::start_with_next([=] {
 		for (auto &layout : _layouts) {
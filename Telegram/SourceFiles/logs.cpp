@@ -277,8 +277,26 @@ void _logsWrite(LogDataType type, const QString &msg) {
 namespace Logs {
 namespace {
 
+constexpr auto kAllCategories = uint32(Category::Tcp)
+	| uint32(Category::Mtp);
+
 bool DebugModeEnabled = false;
 
+// Categories not disabled explicitly by SetCategoryEnabled().
+std::atomic<uint32> EnabledCategories = kAllCategories;
+
+// Categories that would reach a file or the in-memory startup buffer.
+std::atomic<uint32> WritingCategories = kAllCategories;
+
+void RefreshWritingCategories() {
+	const auto toFile = LogsData && (LogsStartIndexChosen < 0);
+	const auto toMemory = !toFile && (LogsInMemory != DeletedLogsInMemory);
+	const auto writing = (toFile && DebugEnabled()) || toMemory;
+	WritingCategories = writing
+		? EnabledCategories.load(std::memory_order_relaxed)
+		: uint32(0);
+}
+
 [[maybe_unused]] void MoveOldDataFiles(const QString &wasDir) {
 	if (wasDir.isEmpty()) {
 		return;
@@ -332,6 +350,7 @@ bool DebugModeEnabled = false;
 
 void SetDebugEnabled(bool enabled) {
 	DebugModeEnabled = enabled;
+	RefreshWritingCategories();
 }
 
 bool DebugEnabled() {
@@ -346,6 +365,20 @@ bool WritingEntry() {
 	return WritingEntryFlag;
 }
 
+bool Writing(Category category) {
+	const auto mask = WritingCategories.load(std::memory_order_relaxed);
+	return (mask & uint32(category)) != 0;
+}
+
+void SetCategoryEnabled(Category category, bool enabled) {
+	if (enabled) {
+		EnabledCategories |= uint32(category);
+	} else {
+		EnabledCategories &= ~uint32(category);
+	}
+	RefreshWritingCategories();
+}
+
 void start() {
 	Assert(LogsData == nullptr);
 
@@ -396,6 +429,7 @@ void start() {
 	LOG(("Working dir: %1").arg(cWorkingDir()));
 	LOG(("Command line: %1").arg(launcher.arguments().join(' ')));
 
+	RefreshWritingCategories();
 	if (!LogsData) {
 		LOG(("FATAL: Could not open '%1' for writing log!"
 			).arg(_logsFilePath(LogDataMain, u"_startXX"_q)));
@@ -433,6 +467,7 @@ void finish() {
 	LogsInMemory = DeletedLogsInMemory;
 
 	_logsMutex(LogDataMain, true);
+	RefreshWritingCategories();
 
 	CrashReports::FinishCatching();
 }
@@ -449,6 +484,7 @@ bool instanceChecked() {
 
 		delete LogsData;
 		LogsData = 0;
+		RefreshWritingCategories();
 		LOG(("FATAL: Could not move logging to '%1'!").arg(_logsFilePath(LogDataMain)));
 		return false;
 	}
@@ -468,6 +504,8 @@ bool instanceChecked() {
 	}
 	LogsInMemory = DeletedLogsInMemory;
 
+	RefreshWritingCategories();
+
 	DEBUG_LOG(("Debug logs started."));
 	LogsBeforeSingleInstanceChecked.clear();
 	return true;
@@ -479,6 +517,7 @@ void multipleInstances() {
 		delete LogsInMemory;
 	}
 	LogsInMemory = DeletedLogsInMemory;
+	RefreshWritingCategories();
 
 	if (Logs::DebugEnabled()) {
 		LOG(("WARNING: debug logs are not written in multiple instances mode!"));
@@ -13,10 +13,20 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 namespace Logs {
 
+enum class Category : uchar {
+	Tcp = (1 << 0),
+	Mtp = (1 << 1),
+};
+
 void SetDebugEnabled(bool enabled);
 bool DebugEnabled();
 [[nodiscard]] bool WritingEntry();
 
+// Checked before the record text is built, so that expensive formatting,
+// like full TL dumps, is skipped when nothing would be written anyway.
+[[nodiscard]] bool Writing(Category category);
+void SetCategoryEnabled(Category category, bool enabled);
+
 void start();
 bool started();
 void finish();
@@ -66,14 +76,14 @@ inline MemoryBuffer mb(const void *ptr, uint32 size) {
 } // namespace Logs
 
 #define TCP_LOG(msg) {\
-	if (Logs::DebugEnabled() || !Logs::started()) {\
+	if (Logs::Writing(Logs::Category::Tcp)) {\
 		Logs::writeTcp(QString msg);\
 	}\
 }
 //usage TCP_LOG(("log: %1 %2").arg(1).arg(2))
 
 #define MTP_LOG(dc, msg) {\
-	if (Logs::DebugEnabled() || !Logs::started()) {\
+	if (Logs::Writing(Logs::Category::Mtp)) {\
 		Logs::writeMtp(dc, QString msg);\
 	}\
 }
@@ -22,10 +22,13 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "core/core_settings.h"
 #include "main/main_session.h"
 #include "ui/chat/attach/attach_prepare.h"
+#include "base/options.h"
 
 #include <al.h>
 #include <alc.h>
+#include <alext.h>
 
+#include <atomic>
 #include <numeric>
 
 Q_DECLARE_METATYPE(AudioMsgId);
@@ -51,7 +54,7 @@ namespace Media {
 namespace Audio {
 namespace {
 
-Player::Mixer *MixerInstance = nullptr;
+std::atomic<Player::Mixer*> MixerInstance = nullptr;
 
 // Thread: Any.
 bool ContextErrorHappened() {
@@ -138,6 +141,48 @@ void DestroyPlaybackDevice() {
 	}
 }
 
+// Thread: OpenAL event thread.
+void AL_APIENTRY EventCallback(
+		ALenum eventType,
+		ALuint object,
+		ALuint param,
+		ALsizei length,
+		const ALchar *message,
+		void *userParam) noexcept {
+	// No OpenAL calls are allowed here, so just wake up the Fader.
+	// The context is destroyed before the mixer, see ~Mixer().
+	if (const auto mixer = MixerInstance.load()) {
+		if (eventType == AL_EVENT_TYPE_BUFFER_COMPLETED_SOFT) {
+			mixer->scheduleLoaderCallback(object);
+		}
+		mixer->scheduleFaderCallback();
+	}
+}
+
+// Thread: Any. Must be locked: AudioMutex.
+void EnableEvents() {
+	if (!alIsExtensionPresent("AL_SOFT_events")) {
+		LOG(("Audio Info: AL_SOFT_events not supported."));
+		return;
+	}
+	const auto control = reinterpret_cast<LPALEVENTCONTROLSOFT>(
+		alGetProcAddress("alEventControlSOFT"));
+	const auto callback = reinterpret_cast<LPALEVENTCALLBACKSOFT>(
+		alGetProcAddress("alEventCallbackSOFT"));
+	if (!control || !callback) {
+		return;
+	}
+	const ALenum types[] = {
+		AL_EVENT_TYPE_BUFFER_COMPLETED_SOFT,
+		AL_EVENT_TYPE_SOURCE_STATE_CHANGED_SOFT,
+	};
+	callback(EventCallback, nullptr);
+	control(ALsizei(std::size(types)), types, AL_TRUE);
+	if (PlaybackErrorHappened()) {
+		LOG(("Audio Error: Could not enable AL_SOFT_events."));
+	}
+}
+
 // Thread: Any. Must be locked: AudioMutex.
 bool CreatePlaybackDevice() {
 	if (AudioDevice) return true;
@@ -163,6 +208,8 @@ bool CreatePlaybackDevice() {
 
 	alDistanceModel(AL_NONE);
 
+	EnableEvents();
+
 	return true;
 }
 
@@ -210,7 +257,7 @@ void Finish(not_null<Instance*> instance) {
 
 	// MixerInstance variable should be modified under AudioMutex protection.
 	// So it is modified in the ~Mixer() destructor after all tracks are cleared.
-	delete MixerInstance;
+	delete MixerInstance.load();
 
 	// No sync required already.
 	ClosePlaybackDevice(instance);
@@ -290,12 +337,33 @@ constexpr auto kPreloadSeconds = 2LL; // preload next part if less than 2 second
 constexpr auto kFadeDuration = crl::time(500);
 constexpr auto kCheckPlaybackPositionTimeout = crl::time(100); // 100ms per check audio position
 constexpr auto kCheckPlaybackPositionDelta = 2400LL; // update position called each 2400 samples
-constexpr auto kCheckFadingTimeout = crl::time(7); // 7ms
+
+// OpenAL Soft applies a gain change smoothly during one mixing update,
+// 1024 samples by default, so the gain is set once for each update
+// to the value the fade should reach by its end.
+constexpr auto kFadeStepSamples = int64(1024);
+constexpr auto kFadeStepTimeout = crl::time(20);
+
+// The main thread is asked to keep the device at most that often,
+// it closes the device only after 500ms of silence.
+constexpr auto kStopDetachThrottle = crl::time(200);
+
+constexpr auto kLogWakeupsPeriod = crl::time(10000);
+
+base::options::toggle OptionLogAudioWakeups({
+	.id = kOptionLogAudioWakeups,
+	.name = "Log audio mixer wakeups",
+	.description = "Write to the log how many times per second "
+		"the audio mixer thread wakes up during playback.",
+	.restartRequired = true,
+});
 
 rpl::event_stream<AudioMsgId> UpdatedStream;
 
 } // namespace
 
+const char kOptionLogAudioWakeups[] = "log-audio-wakeups";
+
 rpl::producer<AudioMsgId> Updated() {
 	return UpdatedStream.events();
 }
@@ -316,7 +384,7 @@ float64 ComputeVolume(AudioMsgId::Type type) {
 }
 
 Mixer *mixer() {
-	return Audio::MixerInstance;
+	return Audio::MixerInstance.load();
 }
 
 void Mixer::Track::createStream(AudioMsgId::Type type) {
@@ -580,6 +648,46 @@ void Mixer::scheduleFaderCallback() {
 	});
 }
 
+void Mixer::scheduleLoaderCallback(uint32 source) {
+	// AudioMutex can't be locked on the OpenAL event thread, because
+	// the context is destroyed under it, so check the tracks in Loaders.
+	InvokeQueued(_loader, [loader = _loader, source] {
+		auto load = std::vector<AudioMsgId>();
+		{
+			QMutexLocker lock(&AudioMutex);
+			const auto mixer = Player::mixer();
+			if (!mixer) {
+				return;
+			}
+			for (const auto type : {
+					AudioMsgId::Type::Voice,
+					AudioMsgId::Type::Song,
+					AudioMsgId::Type::Video }) {
+				const auto track = mixer->trackForType(type);
+				if (!track
+					|| !track->isStreamCreated()
+					|| track->stream.source != source) {
+					continue;
+				} else if ((track->loaded || track->loading)
+					&& !track->waitingForBuffer) {
+					continue;
+				}
+				const auto needPreload = (track->withSpeed.position
+					+ kPreloadSeconds * track->state.frequency
+					> (track->withSpeed.bufferedPosition
+						+ track->withSpeed.bufferedLength));
+				if (needPreload) {
+					track->loading = true;
+					load.push_back(track->state.id);
+				}
+			}
+		}
+		for (const auto &audio : load) {
+			loader->onLoad(audio);
+		}
+	});
+}
+
 void Mixer::onUpdated(const AudioMsgId &audio) {
 	if (audio.externalPlayId()) {
 		externalSoundProgress(audio);
@@ -1138,6 +1246,7 @@ float64 Mixer::getVideoVolume() const {
 
 Fader::Fader(QThread *thread) : QObject()
 , _timer(this)
+, _logWakeups(OptionLogAudioWakeups.value())
 , _suppressVolumeAll(1., 1.)
 , _suppressVolumeSong(1., 1.) {
 	moveToThread(thread);
@@ -1156,6 +1265,9 @@ void Fader::onTimer() {
 	QMutexLocker lock(&AudioMutex);
 	if (!mixer()) return;
 
+	const auto now = crl::now();
+	countWakeup(now);
+
 	constexpr auto kMediaPlayerSuppressDuration = crl::time(150);
 
 	auto volumeChangedAll = false;
@@ -1196,12 +1308,13 @@ void Fader::onTimer() {
 	}
 	auto hasFading = (_suppressAll || _suppressSongAnim);
 	auto hasPlaying = false;
+	auto fadeTimeout = kFadeStepTimeout;
 
-	auto updatePlayback = [this, &hasPlaying, &hasFading](AudioMsgId::Type type, int index, float64 volumeMultiplier, bool suppressGainChanged) {
+	auto updatePlayback = [&](AudioMsgId::Type type, int index, float64 volumeMultiplier, bool suppressGainChanged) {
 		auto track = mixer()->trackForType(type, index);
 		if (IsStopped(track->state.state) || track->state.state == State::Paused || !track->isStreamCreated()) return;
 
-		auto emitSignals = updateOnePlayback(track, hasPlaying, hasFading, volumeMultiplier, suppressGainChanged);
+		auto emitSignals = updateOnePlayback(track, hasPlaying, hasFading, fadeTimeout, volumeMultiplier, suppressGainChanged);
 		if (emitSignals & EmitError) error(track->state.id);
 		if (emitSignals & EmitStopped) audioStopped(track->state.id);
 		if (emitSignals & EmitPositionUpdated) playPositionUpdated(track->state.id);
@@ -1220,18 +1333,45 @@ void Fader::onTimer() {
 
 	_volumeChangedSong = _volumeChangedVideo = false;
 
-	if (hasFading) {
-		_timer.start(kCheckFadingTimeout);
-		Audio::StopDetachIfNotUsedSafe();
-	} else if (hasPlaying) {
-		_timer.start(kCheckPlaybackPositionTimeout);
-		Audio::StopDetachIfNotUsedSafe();
+	if (hasFading || hasPlaying) {
+		_timer.start(hasFading ? fadeTimeout : kCheckPlaybackPositionTimeout);
+		if (!_stopDetachPosted || now - _stopDetachPosted >= kStopDetachThrottle) {
+			_stopDetachPosted = now;
+			Audio::StopDetachIfNotUsedSafe();
+		}
 	} else {
+		_stopDetachPosted = 0;
 		Audio::ScheduleDetachIfNotUsedSafe();
+		logWakeups(now);
 	}
 }
 
-int32 Fader::updateOnePlayback(Mixer::Track *track, bool &hasPlaying, bool &hasFading, float64 volumeMultiplier, bool volumeChanged) {
+void Fader::countWakeup(crl::time now) {
+	if (!_logWakeups) {
+		return;
+	} else if (!_wakeupsStarted) {
+		_wakeupsStarted = now;
+	}
+	++_wakeups;
+	if (now - _wakeupsStarted >= kLogWakeupsPeriod) {
+		logWakeups(now);
+	}
+}
+
+void Fader::logWakeups(crl::time now) {
+	if (!_logWakeups || !_wakeupsStarted) {
+		return;
+	}
+	const auto duration = std::max(now - _wakeupsStarted, crl::time(1));
+	LOG(("Audio Info: %1 mixer wakeups in %2 ms, %3 per second."
+		).arg(_wakeups
+		).arg(duration
+		).arg(_wakeups * 1000. / duration, 0, 'f', 1));
+	_wakeups = 0;
+	_wakeupsStarted = 0;
+}
+
+int32 Fader::updateOnePlayback(Mixer::Track *track, bool &hasPlaying, bool &hasFading, crl::time &fadeTimeout, float64 volumeMultiplier, bool volumeChanged) {
 	const auto errorHappened = [&] {
 		if (Audio::PlaybackErrorHappened()) {
 			setStoppedState(track, State::StoppedAtError);
@@ -1308,12 +1448,28 @@ int32 Fader::updateOnePlayback(Mixer::Track *track, bool &hasPlaying, bool &hasF
 			} break;
 			}
 		} else {
-			auto newGain = crl::time(1000) * fadingForSamplesCount / float64(kFadeDuration * track->state.frequency);
+			// Set the gain the fade should have by the end of the next
+			// mixing update and wake up when that update is finished.
+			const auto fadeSamples = int64(kFadeDuration)
+				* track->state.frequency
+				/ 1000;
+			const auto stepSamples = std::max(std::min(
+				kFadeStepSamples,
+				int64(fadeSamples - fadingForSamplesCount)), int64(0));
+			auto newGain = std::min(
+				(fadingForSamplesCount + stepSamples) / float64(fadeSamples),
+				1.);
 			if (track->state.state == State::Pausing || track->state.state == State::Stopping) {
 				newGain = 1. - newGain;
 			}
 			alSourcef(track->stream.source, AL_GAIN, newGain * volumeMultiplier);
 			if (errorHappened()) return EmitError;
+
+			const auto stepTimeout = crl::time((1000 * stepSamples
+				+ track->state.frequency - 1) / track->state.frequency);
+			accumulate_min(
+				fadeTimeout,
+				std::clamp(stepTimeout, crl::time(1), kFadeStepTimeout));
 		}
 	} else if (playing && alState == AL_PLAYING) {
 		if (volumeChanged) {
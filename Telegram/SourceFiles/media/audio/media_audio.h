@@ -62,6 +62,8 @@ constexpr auto kWaveformSamplesCount = 100;
 class Fader;
 class Loaders;
 
+extern const char kOptionLogAudioWakeups[];
+
 [[nodiscard]] rpl::producer<AudioMsgId> Updated();
 
 float64 ComputeVolume(AudioMsgId::Type type);
@@ -182,6 +184,9 @@ public:
 
 	void scheduleFaderCallback();
 
+	// Thread: Any. Wakes up the Loaders when a buffer of source is freed.
+	void scheduleLoaderCallback(uint32 source);
+
 	~Mixer();
 
 private Q_SLOTS:
@@ -347,10 +352,18 @@ private:
 		EmitPositionUpdated = 0x04,
 		EmitNeedToPreload = 0x08,
 	};
-	int32 updateOnePlayback(Mixer::Track *track, bool &hasPlaying, bool &hasFading, float64 volumeMultiplier, bool volumeChanged);
+	int32 updateOnePlayback(Mixer::Track *track, bool &hasPlaying, bool &hasFading, crl::time &fadeTimeout, float64 volumeMultiplier, bool volumeChanged);
 	void setStoppedState(Mixer::Track *track, State state = State::Stopped);
 
+	void countWakeup(crl::time now);
+	void logWakeups(crl::time now);
+
 	QTimer _timer;
+	crl::time _stopDetachPosted = 0;
+
+	const bool _logWakeups = false;
+	int _wakeups = 0;
+	crl::time _wakeupsStarted = 0;
 
 	bool _volumeChangedSong = false;
 	bool _volumeChangedVideo = false;
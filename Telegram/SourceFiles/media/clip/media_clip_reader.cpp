@@ -12,16 +12,18 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "ui/chat/attach/attach_prepare.h"
 #include "ui/painter.h"
 #include "core/file_location.h"
-#include "base/random.h"
 #include "base/invoke_queued.h"
+#include "base/flat_set.h"
 #include "logs.h"
 
 #include <QtCore/QBuffer>
-#include <QtCore/QAbstractEventDispatcher>
 #include <QtCore/QCoreApplication>
 #include <QtCore/QThread>
 #include <QtCore/QFileInfo>
 
+#include <condition_variable>
+#include <mutex>
+
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
@@ -33,8 +35,9 @@ namespace Media {
 namespace Clip {
 namespace {
 
-constexpr auto kClipThreadsCount = 8;
-constexpr auto kAverageGifSize = 320 * 240;
+constexpr auto kMinDecodingInParallel = 2;
+constexpr auto kMaxDecodingInParallel = 8;
+constexpr auto kNeverProcess = 86400 * crl::time(1000);
 constexpr auto kWaitBeforeGifPause = crl::time(200);
 
 QImage PrepareFrame(
@@ -124,9 +127,6 @@ public:
 	explicit Manager(not_null<QThread*> thread);
 	~Manager();
 
-	int loadLevel() const {
-		return _loadLevel;
-	}
 	void append(Reader *reader, const Core::FileLocation &location, const QByteArray &data);
 	void start(Reader *reader);
 	void update(Reader *reader);
@@ -135,11 +135,13 @@ public:
 
 private:
 	void process();
+	void startDecoding(ReaderPrivate *reader, crl::time ms);
+	void decoded(ReaderPrivate *reader, bool keep);
+	void waitForDecoding();
 	void finish();
 	void callback(Reader *reader, Notification notification);
 	void clear();
 
-	QAtomicInt _loadLevel;
 	using ReaderPointers = QMap<Reader*, QAtomicInt>;
 	ReaderPointers _readerPointers;
 	mutable QMutex _readerPointersMutex;
@@ -148,20 +150,18 @@ private:
 	ReaderPointers::iterator unsafeFindReaderPointer(ReaderPrivate *reader);
 
 	bool handleProcessResult(ReaderPrivate *reader, ProcessResult result, crl::time ms);
-
-	enum ResultHandleState {
-		ResultHandleRemove,
-		ResultHandleStop,
-		ResultHandleContinue,
-	};
-	ResultHandleState handleResult(ReaderPrivate *reader, ProcessResult result, crl::time ms);
+	bool handleResult(ReaderPrivate *reader, ProcessResult result, crl::time ms);
 
 	using Readers = QMap<ReaderPrivate*, crl::time>;
 	Readers _readers;
 
+	// Readers being decoded right now in the crl::async threads.
+	base::flat_set<ReaderPrivate*> _decoding;
+	std::mutex _decodingMutex;
+	std::condition_variable _decodingFinished;
+	int _decodingCount = 0;
+
 	QTimer _timer;
-	QThread *_processingInThread = nullptr;
-	bool _needReProcess = false;
 
 };
 
@@ -180,7 +180,15 @@ struct Worker {
 	Manager manager;
 };
 
-std::vector<std::unique_ptr<Worker>>  Workers;
+std::unique_ptr<Worker> SharedWorker;
+
+[[nodiscard]] int MaxDecodingInParallel() {
+	static const auto result = std::clamp(
+		QThread::idealThreadCount(),
+		kMinDecodingInParallel,
+		kMaxDecodingInParallel);
+	return result;
+}
 
 } // namespace
 
@@ -203,21 +211,10 @@ Reader::Reader(const QByteArray &data, Callback &&callback)
 }
 
 void Reader::init(const Core::FileLocation &location, const QByteArray &data) {
-	if (Workers.size() < kClipThreadsCount) {
-		_threadIndex = Workers.size();
-		Workers.push_back(std::make_unique<Worker>());
-	} else {
-		_threadIndex = base::RandomIndex(Workers.size());
-		auto loadLevel = 0x7FFFFFFF;
-		for (int i = 0, l = int(Workers.size()); i < l; ++i) {
-			const auto level = Workers[i]->manager.loadLevel();
-			if (level < loadLevel) {
-				_threadIndex = i;
-				loadLevel = level;
-			}
-		}
+	if (!SharedWorker) {
+		SharedWorker = std::make_unique<Worker>();
 	}
-	Workers[_threadIndex]->manager.append(this, location, data);
+	SharedWorker->manager.append(this, location, data);
 }
 
 Reader::Frame *Reader::frameToShow(int32 *index) const { // 0 means not ready
@@ -294,20 +291,17 @@ void Reader::moveToNextWrite() const {
 	}
 }
 
-void Reader::SafeCallback(
-		Reader *reader,
-		int threadIndex,
-		Notification notification) {
+void Reader::SafeCallback(Reader *reader, Notification notification) {
 	// Check if reader is not deleted already
-	if (Workers.size() > threadIndex
-		&& Workers[threadIndex]->manager.carries(reader)
+	if (SharedWorker
+		&& SharedWorker->manager.carries(reader)
 		&& reader->_callback) {
 		reader->_callback(Notification(notification));
 	}
 }
 
 void Reader::start(FrameRequest request) {
-	if (Workers.size() <= _threadIndex) {
+	if (!SharedWorker) {
 		error();
 	}
 	if (_state == State::Error
@@ -322,7 +316,7 @@ void Reader::start(FrameRequest request) {
 	}
 	_frames[0].request = _frames[1].request = _frames[2].request = request;
 	moveToNextShow();
-	Workers[_threadIndex]->manager.start(this);
+	SharedWorker->manager.start(this);
 }
 
 Reader::FrameInfo Reader::frameInfo(FrameRequest request, crl::time now) {
@@ -338,10 +332,10 @@ Reader::FrameInfo Reader::frameInfo(FrameRequest request, crl::time now) {
 		frame->displayed.storeRelease(1);
 		if (_autoPausedGif.loadAcquire()) {
 			_autoPausedGif.storeRelease(0);
-			if (Workers.size() <= _threadIndex) {
+			if (!SharedWorker) {
 				error();
 			} else if (_state != State::Error) {
-				Workers[_threadIndex]->manager.update(this);
+				SharedWorker->manager.update(this);
 			}
 		}
 	} else {
@@ -379,10 +373,10 @@ Reader::FrameInfo Reader::frameInfo(FrameRequest request, crl::time now) {
 		auto other = frameToWriteNext(true);
 		if (other) other->request = frame->request;
 
-		if (Workers.size() <= _threadIndex) {
+		if (!SharedWorker) {
 			error();
 		} else if (_state != State::Error) {
-			Workers[_threadIndex]->manager.update(this);
+			SharedWorker->manager.update(this);
 		}
 	}
 	return { frame->prepared, frame->index };
@@ -414,13 +408,13 @@ crl::time Reader::getDurationMs() const {
 }
 
 void Reader::pauseResumeVideo() {
-	if (Workers.size() <= _threadIndex) {
+	if (!SharedWorker) {
 		error();
 	}
 	if (_state == State::Error) return;
 
 	_videoPauseRequest.storeRelease(1 - _videoPauseRequest.loadAcquire());
-	Workers[_threadIndex]->manager.start(this);
+	SharedWorker->manager.start(this);
 }
 
 bool Reader::videoPaused() const {
@@ -440,11 +434,11 @@ State Reader::state() const {
 }
 
 void Reader::stop() {
-	if (Workers.size() <= _threadIndex) {
+	if (!SharedWorker) {
 		error();
 	}
 	if (_state != State::Error) {
-		Workers[_threadIndex]->manager.stop(this);
+		SharedWorker->manager.stop(this);
 		_width = _height = 0;
 	}
 }
@@ -703,7 +697,6 @@ Manager::Manager(not_null<QThread*> thread) {
 
 void Manager::append(Reader *reader, const Core::FileLocation &location, const QByteArray &data) {
 	reader->_private = new ReaderPrivate(reader, location, data);
-	_loadLevel.fetchAndAddRelaxed(kAverageGifSize);
 	update(reader);
 }
 
@@ -756,8 +749,8 @@ auto Manager::constUnsafeFindReaderPointer(ReaderPrivate *reader) const
 }
 
 void Manager::callback(Reader *reader, Notification notification) {
-	crl::on_main([=, threadIndex = reader->threadIndex()] {
-		Reader::SafeCallback(reader, threadIndex, notification);
+	crl::on_main([=] {
+		Reader::SafeCallback(reader, notification);
 	});
 }
 
@@ -783,7 +776,6 @@ bool Manager::handleProcessResult(ReaderPrivate *reader, ProcessResult result, c
 	}
 
 	if (result == ProcessResult::Started) {
-		_loadLevel.fetchAndAddRelaxed(reader->_width * reader->_height - kAverageGifSize);
 		it.key()->_durationMs = reader->_durationMs;
 	}
 	// See if we need to pause GIF because it is not displayed right now.
@@ -824,16 +816,9 @@ bool Manager::handleProcessResult(ReaderPrivate *reader, ProcessResult result, c
 	return true;
 }
 
-Manager::ResultHandleState Manager::handleResult(ReaderPrivate *reader, ProcessResult result, crl::time ms) {
+bool Manager::handleResult(ReaderPrivate *reader, ProcessResult result, crl::time ms) {
 	if (!handleProcessResult(reader, result, ms)) {
-		_loadLevel.fetchAndAddRelaxed(-1 * (reader->_width > 0 ? reader->_width * reader->_height : kAverageGifSize));
-		delete reader;
-		return ResultHandleRemove;
-	}
-
-	_processingInThread->eventDispatcher()->processEvents(QEventLoop::AllEvents);
-	if (_processingInThread->isInterruptionRequested()) {
-		return ResultHandleStop;
+		return false;
 	}
 
 	if (result == ProcessResult::Repaint) {
@@ -853,25 +838,22 @@ Manager::ResultHandleState Manager::handleResult(ReaderPrivate *reader, ProcessR
 		}
 		return handleResult(reader, reader->finishProcess(ms), ms);
 	}
-
-	return ResultHandleContinue;
+	return true;
 }
 
 void Manager::process() {
-	if (_processingInThread) {
-		_needReProcess = true;
-		return;
-	}
-
 	_timer.stop();
-	_processingInThread = thread();
 
 	bool checkAllReaders = false;
-	auto ms = crl::now(), minms = ms + 86400 * crl::time(1000);
+	auto ms = crl::now();
 	{
 		QMutexLocker lock(&_readerPointersMutex);
 		for (auto it = _readerPointers.begin(), e = _readerPointers.end(); it != e; ++it) {
 			if (it->loadAcquire() && it.key()->_private != nullptr) {
+				if (_decoding.contains(it.key()->_private)) {
+					// Will be applied when the decoding is finished.
+					continue;
+				}
 				auto i = _readers.find(it.key()->_private);
 				if (i == _readers.cend()) {
 					_readers.insert(it.key()->_private, 0);
@@ -894,50 +876,87 @@ void Manager::process() {
 		checkAllReaders = (_readers.size() > _readerPointers.size());
 	}
 
+	auto ready = std::vector<std::pair<crl::time, ReaderPrivate*>>();
+	auto minms = ms + kNeverProcess;
 	for (auto i = _readers.begin(), e = _readers.end(); i != e;) {
 		ReaderPrivate *reader = i.key();
-		if (i.value() <= ms) {
-			ResultHandleState state = handleResult(reader, reader->process(ms), ms);
-			if (state == ResultHandleRemove) {
-				i = _readers.erase(i);
-				continue;
-			} else if (state == ResultHandleStop) {
-				_processingInThread = nullptr;
-				return;
-			}
-			ms = crl::now();
-			if (reader->_videoPausedAtMs) {
-				i.value() = ms + 86400 * 1000ULL;
-			} else if (reader->_nextFrameWhen && reader->_started) {
-				i.value() = reader->_nextFrameWhen;
-			} else {
-				i.value() = (ms + 86400 * 1000ULL);
-			}
+		if (_decoding.contains(reader)) {
+			++i;
+			continue;
 		} else if (checkAllReaders) {
 			QMutexLocker lock(&_readerPointersMutex);
 			auto it = constUnsafeFindReaderPointer(reader);
 			if (it == _readerPointers.cend()) {
-				_loadLevel.fetchAndAddRelaxed(-1 * (reader->_width > 0 ? reader->_width * reader->_height : kAverageGifSize));
 				delete reader;
 				i = _readers.erase(i);
 				continue;
 			}
 		}
-		if (!reader->_autoPausedGif && i.value() < minms) {
+		if (reader->_autoPausedGif) {
+			// Processed again when the reader is updated from outside.
+			i.value() = ms + kNeverProcess;
+		} else if (i.value() <= ms) {
+			ready.emplace_back(i.value(), reader);
+		} else if (i.value() < minms) {
 			minms = i.value();
 		}
 		++i;
 	}
 
-	ms = crl::now();
-	if (_needReProcess || minms <= ms) {
-		_needReProcess = false;
-		_timer.start(1);
+	// Frames that should've been shown earlier are decoded first. The ones
+	// that didn't get a decoding slot are started when some slot is freed.
+	ranges::sort(ready, ranges::less(), [](const auto &pair) {
+		return pair.first;
+	});
+	const auto slots = MaxDecodingInParallel() - int(_decoding.size());
+	for (const auto &[when, reader] : ready | ranges::views::take(slots)) {
+		startDecoding(reader, ms);
+	}
+
+	_timer.start(minms - ms);
+}
+
+void Manager::startDecoding(ReaderPrivate *reader, crl::time ms) {
+	_decoding.emplace(reader);
+	{
+		std::unique_lock lock(_decodingMutex);
+		++_decodingCount;
+	}
+	crl::async([=] {
+		const auto keep = handleResult(reader, reader->process(ms), ms);
+		InvokeQueued(this, [=] { decoded(reader, keep); });
+
+		std::unique_lock lock(_decodingMutex);
+		--_decodingCount;
+		_decodingFinished.notify_all();
+	});
+}
+
+void Manager::decoded(ReaderPrivate *reader, bool keep) {
+	if (!_decoding.remove(reader)) {
+		return;
+	}
+	const auto i = _readers.find(reader);
+	Assert(i != _readers.end());
+	if (!keep) {
+		delete reader;
+		_readers.erase(i);
 	} else {
-		_timer.start(minms - ms);
+		const auto ms = crl::now();
+		if (reader->_videoPausedAtMs) {
+			i.value() = ms + kNeverProcess;
+		} else if (reader->_nextFrameWhen && reader->_started) {
+			i.value() = reader->_nextFrameWhen;
+		} else {
+			i.value() = ms + kNeverProcess;
+		}
 	}
+	process();
+}
 
-	_processingInThread = nullptr;
+void Manager::waitForDecoding() {
+	std::unique_lock lock(_decodingMutex);
+	_decodingFinished.wait(lock, [&] { return !_decodingCount; });
 }
 
 void Manager::finish() {
@@ -954,6 +973,10 @@ void Manager::clear() {
 		_readerPointers.clear();
 	}
 
+	// Readers can't be deleted while they're being decoded.
+	waitForDecoding();
+	_decoding.clear();
+
 	for (Readers::iterator i = _readers.begin(), e = _readers.end(); i != e; ++i) {
 		delete i.key();
 	}
@@ -1006,7 +1029,7 @@ Ui::PreparedFileInformation PrepareForSending(
 }
 
 void Finish() {
-	Workers.clear();
+	SharedWorker = nullptr;
 }
 
 Reader *const ReaderPointer::BadPointer = reinterpret_cast<Reader*>(1);
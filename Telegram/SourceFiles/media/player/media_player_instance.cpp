@@ -10,6 +10,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "data/data_document.h"
 #include "data/data_session.h"
 #include "data/data_changes.h"
+#include "data/data_histories.h"
 #include "data/data_streaming.h"
 #include "data/data_file_click_handler.h"
 #include "base/options.h"
@@ -240,11 +241,17 @@ void Instance::setHistory(
 		not_null<Data*> data,
 		History *history,
 		Main::Session *sessionFallback) {
+	data->unloadLock.destroy();
 	if (history) {
 		data->history = history->migrateToOrMe();
 		data->topicRootId = 0;
 		data->migrated = data->history->migrateFrom();
 		setSession(data, &history->session());
+
+		// Keep the playlist items loaded while the track is playing.
+		auto &histories = history->owner().histories();
+		data->unloadLock = histories.preventUnload(data->history);
+		data->unloadLock.add(histories.preventUnload(data->migrated));
 	} else {
 		data->history = data->migrated = nullptr;
 		setSession(data, sessionFallback);
@@ -258,6 +265,7 @@ void Instance::setSession(not_null<Data*> data, Main::Session *session) {
 	data->playlistLifetime.destroy();
 	data->playlistOtherLifetime.destroy();
 	data->sessionLifetime.destroy();
+	data->unloadLock.destroy();
 	data->session = session;
 	if (session) {
 		session->account().sessionChanges(
@@ -188,6 +188,7 @@ private:
 		rpl::lifetime playlistLifetime;
 		rpl::lifetime playlistOtherLifetime;
 		rpl::lifetime sessionLifetime;
+		rpl::lifetime unloadLock;
 		rpl::event_stream<> playlistChanges;
 		History *history = nullptr;
 		MsgId topicRootId = 0;
@@ -0,0 +1,132 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "media/streaming/media_streaming_frame_pool.h"
+
+namespace Media {
+namespace Streaming {
+namespace {
+
+// Enough for a couple of 1080p frames, the last released image
+// is kept even if it is larger than that.
+constexpr auto kMaxPoolImagesBytes = int64(16 * 1024 * 1024);
+constexpr auto kMaxPoolSwscales = 4;
+
+} // namespace
+
+QImage FramePool::takeImage(QSize size, QImage &&previous) {
+	QMutexLocker lock(&_mutex);
+	if (FFmpeg::GoodStorageForFrame(previous, size)) {
+		++_stats.imagesReused;
+		return std::move(previous);
+	}
+	releaseImageLocked(std::move(previous));
+	const auto good = [&](const QImage &image) {
+		return FFmpeg::GoodStorageForFrame(image, size);
+	};
+	const auto i = ranges::find_if(_images, good);
+	if (i != end(_images)) {
+		auto result = std::move(*i);
+		_images.erase(i);
+		_imagesBytes -= result.sizeInBytes();
+		++_stats.imagesReused;
+		return result;
+	}
+	++_stats.imagesAllocated;
+	lock.unlock();
+
+	return FFmpeg::CreateFrameStorage(size);
+}
+
+void FramePool::releaseImage(QImage &&image) {
+	QMutexLocker lock(&_mutex);
+	releaseImageLocked(std::move(image));
+}
+
+void FramePool::releaseImageLocked(QImage &&image) {
+	// If someone still holds this image we can't write to it anymore.
+	if (image.isNull() || !image.isDetached()) {
+		return;
+	}
+	const auto bytes = int64(image.sizeInBytes());
+	while (!_images.empty()
+		&& _imagesBytes + bytes > kMaxPoolImagesBytes) {
+		_imagesBytes -= _images.front().sizeInBytes();
+		_images.erase(begin(_images));
+	}
+	_images.push_back(std::move(image));
+	_imagesBytes += bytes;
+}
+
+void FramePool::clearImages() {
+	QMutexLocker lock(&_mutex);
+	_images.clear();
+	_imagesBytes = 0;
+}
+
+FFmpeg::SwscalePointer FramePool::takeSwscale(
+		QSize srcSize,
+		int srcFormat,
+		QSize dstSize,
+		int dstFormat,
+		FFmpeg::SwscalePointer &&previous) {
+	const auto good = [&](const FFmpeg::SwscalePointer &swscale) {
+		if (!swscale) {
+			return false;
+		}
+		const auto &deleter = swscale.get_deleter();
+		return (deleter.srcSize == srcSize)
+			&& (deleter.srcFormat == srcFormat)
+			&& (deleter.dstSize == dstSize)
+			&& (deleter.dstFormat == dstFormat);
+	};
+	QMutexLocker lock(&_mutex);
+	if (good(previous)) {
+		++_stats.swscalesReused;
+		return std::move(previous);
+	}
+	releaseSwscaleLocked(std::move(previous));
+	const auto i = ranges::find_if(_swscales, good);
+	if (i != end(_swscales)) {
+		auto result = std::move(*i);
+		_swscales.erase(i);
+		++_stats.swscalesReused;
+		return result;
+	}
+	++_stats.swscalesCreated;
+	lock.unlock();
+
+	return FFmpeg::MakeSwscalePointer(srcSize, srcFormat, dstSize, dstFormat);
+}
+
+void FramePool::releaseSwscale(FFmpeg::SwscalePointer &&swscale) {
+	QMutexLocker lock(&_mutex);
+	releaseSwscaleLocked(std::move(swscale));
+}
+
+void FramePool::releaseSwscaleLocked(FFmpeg::SwscalePointer &&swscale) {
+	if (!swscale) {
+		return;
+	} else if (_swscales.size() == kMaxPoolSwscales) {
+		_swscales.erase(begin(_swscales));
+	}
+	_swscales.push_back(std::move(swscale));
+}
+
+void FramePool::countConversion(crl::profile_time duration) {
+	QMutexLocker lock(&_mutex);
+	++_stats.framesConverted;
+	_stats.conversionTime += duration;
+}
+
+FramePoolStats FramePool::stats() const {
+	QMutexLocker lock(&_mutex);
+	return _stats;
+}
+
+} // namespace Streaming
+} // namespace Media
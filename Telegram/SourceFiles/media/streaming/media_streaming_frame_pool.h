@@ -0,0 +1,68 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include "ffmpeg/ffmpeg_utility.h"
+
+#include <QtCore/QMutex>
+
+namespace Media {
+namespace Streaming {
+
+struct FramePoolStats {
+	int64 imagesAllocated = 0;
+	int64 imagesReused = 0;
+	int64 swscalesCreated = 0;
+	int64 swscalesReused = 0;
+	int64 framesConverted = 0;
+	crl::profile_time conversionTime = 0;
+
+	[[nodiscard]] crl::profile_time conversionTimePerFrame() const {
+		return framesConverted ? (conversionTime / framesConverted) : 0;
+	}
+};
+
+// Keeps frame buffers and scaling contexts released by a video track,
+// so that the next frames of the same size are converted without
+// allocating new ones. Used both from the main thread and the track queue.
+//
+// The kept images are limited by their size in bytes and are dropped
+// by the track when it is paused or changes its output frame format.
+class FramePool final {
+public:
+	// Returns an image good for a frame of this size.
+	// The previous storage is put to the pool if it isn't good.
+	[[nodiscard]] QImage takeImage(QSize size, QImage &&previous = QImage());
+	void releaseImage(QImage &&image);
+	void clearImages();
+
+	[[nodiscard]] FFmpeg::SwscalePointer takeSwscale(
+		QSize srcSize,
+		int srcFormat,
+		QSize dstSize,
+		int dstFormat,
+		FFmpeg::SwscalePointer &&previous = FFmpeg::SwscalePointer());
+	void releaseSwscale(FFmpeg::SwscalePointer &&swscale);
+
+	void countConversion(crl::profile_time duration);
+	[[nodiscard]] FramePoolStats stats() const;
+
+private:
+	void releaseImageLocked(QImage &&image);
+	void releaseSwscaleLocked(FFmpeg::SwscalePointer &&swscale);
+
+	mutable QMutex _mutex;
+	std::vector<QImage> _images;
+	int64 _imagesBytes = 0;
+	std::vector<FFmpeg::SwscalePointer> _swscales;
+	FramePoolStats _stats;
+
+};
+
+} // namespace Streaming
+} // namespace Media
@@ -7,6 +7,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 */
 #pragma once
 
+#include "base/bytes.h"
+
 namespace Storage {
 class StreamedFileDownloader;
 } // namespace Storage
@@ -30,6 +32,9 @@ public:
 	[[nodiscard]] virtual Storage::Cache::Key baseCacheKey() const = 0;
 	[[nodiscard]] virtual int64 size() const = 0;
 
+	// The whole file if it is available in memory for the loader lifetime.
+	[[nodiscard]] virtual bytes::const_span mapped() const = 0;
+
 	virtual void load(int64 offset) = 0;
 	virtual void cancel(int64 offset) = 0;
 	virtual void resetPriorities() = 0;
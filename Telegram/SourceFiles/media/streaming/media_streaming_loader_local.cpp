@@ -18,10 +18,26 @@ namespace {
 // This is the maximum file size in Telegram API.
 constexpr auto kMaxFileSize = 8000 * int64(512 * 1024);
 
+// Small local files are read to memory at once and played from there.
+constexpr auto kMaxSnapshotSize = 8 * 1024 * 1024;
+
 [[nodiscard]] int64 ValidateLocalSize(int64 size) {
 	return (size > 0 && size <= kMaxFileSize) ? size : 0;
 }
 
+[[nodiscard]] bytes::const_span MapLocalDevice(
+		not_null<QIODevice*> device,
+		int64 size) {
+	// Local files are in the download folders or anywhere on the disk,
+	// they can be truncated while playing and reading a mapped page past
+	// the new end crashes with SIGBUS. So we don't map them, small ones
+	// are copied to a private snapshot and others are read by parts.
+	if (const auto buffer = qobject_cast<QBuffer*>(device.get())) {
+		return bytes::make_span(buffer->data()).subspan(0, size);
+	}
+	return {};
+}
+
 } // namespace
 
 LoaderLocal::LoaderLocal(std::unique_ptr<QIODevice> device)
@@ -31,6 +47,17 @@ LoaderLocal::LoaderLocal(std::unique_ptr<QIODevice> device)
 
 	if (!_size || !_device->open(QIODevice::ReadOnly)) {
 		fail();
+	} else if (_size <= kMaxSnapshotSize
+		&& qobject_cast<QFile*>(_device.get())) {
+		_snapshot = _device->readAll();
+		if (_snapshot.size() == _size) {
+			_mapped = bytes::make_span(_snapshot);
+		} else {
+			_snapshot = QByteArray();
+			_device->seek(0);
+		}
+	} else {
+		_mapped = MapLocalDevice(_device.get(), _size);
 	}
 }
 
@@ -42,6 +69,10 @@ int64 LoaderLocal::size() const {
 	return _size;
 }
 
+bytes::const_span LoaderLocal::mapped() const {
+	return _mapped;
+}
+
 void LoaderLocal::load(int64 offset) {
 	if (_device->pos() != offset && !_device->seek(offset)) {
 		fail();
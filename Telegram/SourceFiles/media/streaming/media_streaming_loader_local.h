@@ -22,6 +22,7 @@ public:
 
 	[[nodiscard]] Storage::Cache::Key baseCacheKey() const override;
 	[[nodiscard]] int64 size() const override;
+	[[nodiscard]] bytes::const_span mapped() const override;
 
 	void load(int64 offset) override;
 	void cancel(int64 offset) override;
@@ -43,6 +44,8 @@ private:
 
 	const std::unique_ptr<QIODevice> _device;
 	const int64 _size = 0;
+	QByteArray _snapshot;
+	bytes::const_span _mapped;
 	rpl::event_stream<LoadedPart> _parts;
 
 };
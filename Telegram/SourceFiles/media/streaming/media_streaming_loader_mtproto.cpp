@@ -35,6 +35,10 @@ int64 LoaderMtproto::size() const {
 	return _size;
 }
 
+bytes::const_span LoaderMtproto::mapped() const {
+	return {};
+}
+
 void LoaderMtproto::load(int64 offset) {
 	crl::on_main(this, [=] {
 		if (_downloader) {
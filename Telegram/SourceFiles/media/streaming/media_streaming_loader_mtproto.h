@@ -25,6 +25,7 @@ public:
 
 	[[nodiscard]] Storage::Cache::Key baseCacheKey() const override;
 	[[nodiscard]] int64 size() const override;
+	[[nodiscard]] bytes::const_span mapped() const override;
 
 	void load(int64 offset) override;
 	void cancel(int64 offset) override;
@@ -844,6 +844,7 @@ Reader::Reader(
 : _loader(std::move(loader))
 , _cache(cache)
 , _cacheHelper(cache ? InitCacheHelper(_loader->baseCacheKey()) : nullptr)
+, _mapped(_loader->mapped())
 , _slices(_loader->size(), _cacheHelper != nullptr) {
 	_loader->parts(
 	) | rpl::start_with_next([=](LoadedPart &&part) {
@@ -1242,6 +1243,11 @@ Reader::FillState Reader::fill(
 		return FillState::Failed;
 	};
 
+	if (!_mapped.empty()) {
+		bytes::copy(buffer, _mapped.subspan(offset, buffer.size()));
+		return FillState::Success;
+	}
+
 	checkForSomethingMoreReceived();
 	if (_streamingError) {
 		return FillState::Failed;
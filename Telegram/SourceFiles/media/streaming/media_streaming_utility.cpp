@@ -8,6 +8,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "media/streaming/media_streaming_utility.h"
 
 #include "media/streaming/media_streaming_common.h"
+#include "media/streaming/media_streaming_frame_pool.h"
 #include "ui/image/image_prepare.h"
 #include "ui/painter.h"
 #include "ffmpeg/ffmpeg_utility.h"
@@ -135,7 +136,9 @@ QImage ConvertFrame(
 		Stream &stream,
 		not_null<AVFrame*> frame,
 		QSize resize,
-		QImage storage) {
+		QImage storage,
+		not_null<FramePool*> pool) {
+	const auto started = crl::profile();
 	const auto frameSize = QSize(frame->width, frame->height);
 	if (frameSize.isEmpty()) {
 		LOG(("Streaming Error: Bad frame size %1,%2"
@@ -152,9 +155,7 @@ QImage ConvertFrame(
 		resize.transpose();
 	}
 
-	if (!FFmpeg::GoodStorageForFrame(storage, resize)) {
-		storage = FFmpeg::CreateFrameStorage(resize);
-	}
+	storage = pool->takeImage(resize, std::move(storage));
 
 	const auto format = AV_PIX_FMT_BGRA;
 	const auto hasDesiredFormat = (frame->format == format);
@@ -175,10 +176,12 @@ QImage ConvertFrame(
 			from += deltaFrom;
 		}
 	} else {
-		stream.swscale = MakeSwscalePointer(
-			frame,
+		stream.swscale = pool->takeSwscale(
+			frameSize,
+			frame->format,
 			resize,
-			&stream.swscale);
+			format,
+			std::move(stream.swscale));
 		if (!stream.swscale) {
 			return QImage();
 		}
@@ -202,6 +205,7 @@ QImage ConvertFrame(
 	}
 
 	FFmpeg::ClearFrameMemory(frame);
+	pool->countConversion(crl::profile() - started);
 	return storage;
 }
 
@@ -419,15 +423,14 @@ QImage PrepareByRequest(
 		const AVRational &aspect,
 		int rotation,
 		const FrameRequest &request,
-		QImage storage) {
+		QImage storage,
+		not_null<FramePool*> pool) {
 	Expects(!request.outer.isEmpty() || hasAlpha);
 
 	const auto outer = request.outer.isEmpty()
 		? original.size()
 		: request.outer;
-	if (!FFmpeg::GoodStorageForFrame(storage, outer)) {
-		storage = FFmpeg::CreateFrameStorage(outer);
-	}
+	storage = pool->takeImage(outer, std::move(storage));
 
 	if (hasAlpha && request.keepAlpha) {
 		storage.fill(Qt::transparent);
@@ -13,6 +13,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 namespace Media {
 namespace Streaming {
 
+class FramePool;
+
 struct TimePoint {
 	crl::time trackTime = kTimeUnknown;
 	crl::time worldTime = kTimeUnknown;
@@ -63,7 +65,8 @@ struct Stream {
 	Stream &stream,
 	not_null<AVFrame*> frame,
 	QSize resize,
-	QImage storage);
+	QImage storage,
+	not_null<FramePool*> pool);
 [[nodiscard]] FrameYUV ExtractYUV(Stream &stream, AVFrame *frame);
 
 struct ExpandDecision {
@@ -92,7 +95,8 @@ void FillBlurredBackground(QPainter &p, QSize outer, QImage bg);
 	const AVRational &aspect,
 	int rotation,
 	const FrameRequest &request,
-	QImage storage);
+	QImage storage,
+	not_null<FramePool*> pool);
 
 } // namespace Streaming
 } // namespace Media
@@ -24,7 +24,8 @@ static_assert(kDisplaySkipped != kTimeUnknown);
 
 [[nodiscard]] QImage ConvertToARGB32(
 		FrameFormat format,
-		const FrameYUV &data) {
+		const FrameYUV &data,
+		not_null<FramePool*> pool) {
 	Expects(data.y.data != nullptr);
 	Expects(data.u.data != nullptr);
 	Expects((format == FrameFormat::NV12) || (data.v.data != nullptr));
@@ -34,8 +35,8 @@ static_assert(kDisplaySkipped != kTimeUnknown);
 	//	resize.transpose();
 	//}
 
-	auto result = FFmpeg::CreateFrameStorage(data.size);
-	const auto swscale = FFmpeg::MakeSwscalePointer(
+	const auto started = crl::profile();
+	auto swscale = pool->takeSwscale(
 		data.size,
 		(format == FrameFormat::YUV420
 			? AV_PIX_FMT_YUV420P
@@ -45,6 +46,7 @@ static_assert(kDisplaySkipped != kTimeUnknown);
 	if (!swscale) {
 		return QImage();
 	}
+	auto result = pool->takeImage(data.size);
 
 	// AV_NUM_DATA_POINTERS defined in AVFrame struct
 	const uint8_t *srcData[AV_NUM_DATA_POINTERS] = {
@@ -71,6 +73,8 @@ static_assert(kDisplaySkipped != kTimeUnknown);
 		dstData,
 		dstLinesize);
 
+	pool->releaseSwscale(std::move(swscale));
+	pool->countConversion(crl::profile() - started);
 	return result;
 }
 
@@ -173,6 +177,8 @@ private:
 	// For initial frame skipping for an exact seek.
 	FFmpeg::FramePointer _initialSkippingFrame;
 
+	FrameFormat _rasterizedFormat = FrameFormat::None;
+
 };
 
 VideoTrackObject::VideoTrackObject(
@@ -473,9 +479,10 @@ void VideoTrackObject::rasterizeFrame(not_null<Frame*> frame) {
 			return;
 		}
 		if (!frame->original.isNull()) {
-			frame->original = QImage();
+			const auto pool = _shared->pool();
+			pool->releaseImage(base::take(frame->original));
 			for (auto &[_, prepared] : frame->prepared) {
-				prepared.image = QImage();
+				pool->releaseImage(base::take(prepared.image));
 			}
 		}
 		frame->format = nv12 ? FrameFormat::NV12 : FrameFormat::YUV420;
@@ -491,7 +498,8 @@ void VideoTrackObject::rasterizeFrame(not_null<Frame*> frame) {
 			frameWithData,
 			chooseOriginalResize(
 				{ frameWithData->width, frameWithData->height }),
-			std::move(frame->original));
+			std::move(frame->original),
+			_shared->pool());
 		if (frame->original.isNull()) {
 			frame->prepared.clear();
 			fail(Error::InvalidData);
@@ -499,11 +507,19 @@ void VideoTrackObject::rasterizeFrame(not_null<Frame*> frame) {
 		}
 		frame->format = FrameFormat::ARGB32;
 	}
+	if (_rasterizedFormat != frame->format) {
+		// Images pooled for the previous output format won't be needed.
+		if (_rasterizedFormat != FrameFormat::None) {
+			_shared->pool()->clearImages();
+		}
+		_rasterizedFormat = frame->format;
+	}
 
 	VideoTrack::PrepareFrameByRequests(
 		frame,
 		_stream.aspect,
-		_stream.rotation);
+		_stream.rotation,
+		_shared->pool());
 
 	Ensures(VideoTrack::IsRasterized(frame));
 }
@@ -540,6 +556,7 @@ void VideoTrackObject::pause(crl::time time) {
 		return;
 	} else if (_pausedTime == kTimeUnknown) {
 		_pausedTime = time;
+		_shared->pool()->clearImages();
 	}
 }
 
@@ -680,7 +697,8 @@ bool VideoTrackObject::processFirstFrame() {
 		_stream,
 		frameWithData,
 		QSize(),
-		QImage());
+		QImage(),
+		_shared->pool());
 	if (frame.isNull()) {
 		return false;
 	}
@@ -1059,6 +1077,10 @@ VideoTrack::FrameWithIndex VideoTrack::Shared::frameForPaintWithIndex() {
 	};
 }
 
+not_null<FramePool*> VideoTrack::Shared::pool() {
+	return &_pool;
+}
+
 VideoTrack::VideoTrack(
 	const PlaybackOptions &options,
 	Stream &&stream,
@@ -1214,7 +1236,10 @@ QImage VideoTrack::frameImage(
 	if (frame->original.isNull()
 		&& (frame->format == FrameFormat::YUV420
 			|| frame->format == FrameFormat::NV12)) {
-		frame->original = ConvertToARGB32(frame->format, frame->yuv);
+		frame->original = ConvertToARGB32(
+			frame->format,
+			frame->yuv,
+			_shared->pool());
 	}
 	if (GoodForRequest(
 			frame->original,
@@ -1244,7 +1269,8 @@ QImage VideoTrack::frameImage(
 			_streamAspect,
 			_streamRotation,
 			useRequest,
-			std::move(j->second.image));
+			std::move(j->second.image),
+			_shared->pool());
 		return j->second.image;
 	}
 	return i->second.image;
@@ -1255,7 +1281,10 @@ QImage VideoTrack::currentFrameImage() {
 	if (frame->original.isNull()
 		&& (frame->format == FrameFormat::YUV420
 			|| frame->format == FrameFormat::NV12)) {
-		frame->original = ConvertToARGB32(frame->format, frame->yuv);
+		frame->original = ConvertToARGB32(
+			frame->format,
+			frame->yuv,
+			_shared->pool());
 	}
 	return frame->original;
 }
@@ -1269,7 +1298,8 @@ void VideoTrack::unregisterInstance(not_null<const Instance*> instance) {
 void VideoTrack::PrepareFrameByRequests(
 		not_null<Frame*> frame,
 		const AVRational &aspect,
-		int rotation) {
+		int rotation,
+		not_null<FramePool*> pool) {
 	Expects(frame->format != FrameFormat::ARGB32
 		|| !frame->original.isNull());
 
@@ -1289,7 +1319,7 @@ void VideoTrack::PrepareFrameByRequests(
 			auto j = begin;
 			for (; j != i; ++j) {
 				if (j->second.request == prepared.request) {
-					prepared.image = QImage();
+					pool->releaseImage(base::take(prepared.image));
 					break;
 				}
 			}
@@ -1300,7 +1330,8 @@ void VideoTrack::PrepareFrameByRequests(
 					aspect,
 					rotation,
 					prepared.request,
-					std::move(prepared.image));
+					std::move(prepared.image),
+					pool);
 			}
 		}
 	}
@@ -1337,6 +1368,16 @@ rpl::producer<> VideoTrack::waitingForData() const {
 }
 
 VideoTrack::~VideoTrack() {
+	const auto stats = _shared->pool()->stats();
+	DEBUG_LOG(("Streaming Info: Video frames pool, "
+		"images %1 allocated %2 reused, "
+		"swscale %3 created %4 reused, "
+		"%5 mcs per conversion."
+		).arg(stats.imagesAllocated
+		).arg(stats.imagesReused
+		).arg(stats.swscalesCreated
+		).arg(stats.swscalesReused
+		).arg(stats.conversionTimePerFrame()));
 	_wrapped.with([shared = std::move(_shared)](Implementation &unwrapped) {
 		unwrapped.interrupt();
 	});
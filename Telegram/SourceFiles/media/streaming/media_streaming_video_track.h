@@ -8,6 +8,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #pragma once
 
 #include "media/streaming/media_streaming_utility.h"
+#include "media/streaming/media_streaming_frame_pool.h"
 
 #include <crl/crl_object_on_queue.h>
 
@@ -138,6 +139,9 @@ private:
 		[[nodiscard]] not_null<Frame*> frameForPaint();
 		[[nodiscard]] FrameWithIndex frameForPaintWithIndex();
 
+		// Called from both threads.
+		[[nodiscard]] not_null<FramePool*> pool();
+
 	private:
 		[[nodiscard]] not_null<Frame*> getFrame(int index);
 		[[nodiscard]] not_null<const Frame*> getFrame(int index) const;
@@ -148,6 +152,7 @@ private:
 
 		static constexpr auto kFramesCount = 4;
 		std::array<Frame, kFramesCount> _frames;
+		FramePool _pool;
 
 		// (_counter % 2) == 1 main thread can write _delay.
 		// (_counter % 2) == 0 crl::queue can read _delay.
@@ -158,7 +163,8 @@ private:
 	static void PrepareFrameByRequests(
 		not_null<Frame*> frame,
 		const AVRational &aspect,
-		int rotation);
+		int rotation,
+		not_null<FramePool*> pool);
 	[[nodiscard]] static bool IsDecoded(not_null<const Frame*> frame);
 	[[nodiscard]] static bool IsRasterized(not_null<const Frame*> frame);
 	[[nodiscard]] static bool IsStale(
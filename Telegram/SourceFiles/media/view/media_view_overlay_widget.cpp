@@ -53,6 +53,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "history/view/reactions/history_view_reactions_selector.h"
 #include "data/data_session.h"
 #include "data/data_changes.h"
+#include "data/data_histories.h"
 #include "data/data_channel.h"
 #include "data/data_chat.h"
 #include "data/data_user.h"
@@ -5380,6 +5381,14 @@ void OverlayWidget::setContext(
 		}
 	}
 	_user = _peer ? _peer->asUser() : nullptr;
+
+	_historyUnloadLock.destroy();
+	if (_history) {
+		// Navigation uses the shared media of the loaded messages.
+		auto &histories = _history->owner().histories();
+		_historyUnloadLock = histories.preventUnload(_history);
+		_historyUnloadLock.add(histories.preventUnload(_migrated));
+	}
 }
 
 void OverlayWidget::setStoriesPeer(PeerData *peer) {
@@ -660,6 +660,7 @@ private:
 	MsgId _topicRootId = 0;
 	PeerData *_peer = nullptr;
 	UserData *_user = nullptr; // if user profile photos overview
+	rpl::lifetime _historyUnloadLock;
 
 	// We save the information about the reason of the current mediaview show:
 	// did we open a peer profile photo or a photo from some message.
@@ -0,0 +1,48 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#include "mtproto/details/mtproto_decrypt_worker.h"
+
+namespace MTP::details {
+
+DecryptWorker::DecryptWorker() : _thread([=] { run(); }) {
+}
+
+DecryptWorker::~DecryptWorker() {
+	{
+		auto lock = std::unique_lock(_mutex);
+		_finished = true;
+	}
+	_variable.notify_one();
+	_thread.join();
+}
+
+void DecryptWorker::push(FnMut<void()> task) {
+	{
+		auto lock = std::unique_lock(_mutex);
+		_tasks.push_back(std::move(task));
+	}
+	_variable.notify_one();
+}
+
+void DecryptWorker::run() {
+	auto lock = std::unique_lock(_mutex);
+	while (true) {
+		_variable.wait(lock, [&] { return _finished || !_tasks.empty(); });
+		if (_finished) {
+			return;
+		}
+		auto task = std::move(_tasks.front());
+		_tasks.pop_front();
+
+		lock.unlock();
+		task();
+		lock.lock();
+	}
+}
+
+} // namespace MTP::details
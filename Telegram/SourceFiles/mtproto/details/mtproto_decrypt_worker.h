@@ -0,0 +1,39 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop application for the Telegram messaging service.
+
+For license and copyright information please follow this link:
+https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
+*/
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace MTP::details {
+
+// A thread that helps the session threads decrypt large batches.
+//
+// The session thread waits for the result, so it can't rely on the shared
+// crl::async() pool, that may be busy with long tasks like image decoding.
+class DecryptWorker final {
+public:
+	DecryptWorker();
+	~DecryptWorker();
+
+	void push(FnMut<void()> task);
+
+private:
+	void run();
+
+	std::mutex _mutex;
+	std::condition_variable _variable;
+	std::deque<FnMut<void()>> _tasks;
+	bool _finished = false;
+	std::thread _thread;
+
+};
+
+} // namespace MTP::details
@@ -8,6 +8,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "mtproto/mtp_instance.h"
 
 #include "mtproto/details/mtproto_dcenter.h"
+#include "mtproto/details/mtproto_decrypt_worker.h"
 #include "mtproto/details/mtproto_rsa_public_key.h"
 #include "mtproto/special_config_request.h"
 #include "mtproto/session.h"
@@ -87,6 +88,7 @@ public:
 	// Thread safe.
 	[[nodiscard]] QString deviceModel() const;
 	[[nodiscard]] QString systemVersion() const;
+	[[nodiscard]] DecryptWorker &decryptWorker() const;
 
 	// Main thread.
 	void requestConfig();
@@ -230,6 +232,10 @@ private:
 	mutable QMutex _deviceModelMutex;
 	QString _customDeviceModel;
 
+	// Created by the first session that decrypts a large batch.
+	mutable QMutex _decryptWorkerMutex;
+	mutable std::unique_ptr<DecryptWorker> _decryptWorker;
+
 	rpl::variable<DcId> _mainDcId = Fields::kDefaultMainDc;
 	bool _mainDcIdForced = false;
 	base::flat_map<DcId, std::unique_ptr<Dcenter>> _dcenters;
@@ -897,6 +903,14 @@ QString Instance::Private::systemVersion() const {
 	return _systemVersion;
 }
 
+DecryptWorker &Instance::Private::decryptWorker() const {
+	QMutexLocker lock(&_decryptWorkerMutex);
+	if (!_decryptWorker) {
+		_decryptWorker = std::make_unique<DecryptWorker>();
+	}
+	return *_decryptWorker;
+}
+
 void Instance::Private::unpaused() {
 	for (const auto &[shiftedDcId, session] : _sessions) {
 		session->unpaused();
@@ -1800,6 +1814,9 @@ void Instance::Private::prepareToDestroy() {
 			thread->wait();
 		}
 	}
+
+	// No session thread can wait for the worker now.
+	_decryptWorker = nullptr;
 }
 
 Instance::Instance(Mode mode, Fields &&fields)
@@ -1978,6 +1995,10 @@ QString Instance::systemVersion() const {
 	return _private->systemVersion();
 }
 
+details::DecryptWorker &Instance::decryptWorker() const {
+	return _private->decryptWorker();
+}
+
 void Instance::setUpdatesHandler(Fn<void(const Response&)> handler) {
 	_private->setUpdatesHandler(std::move(handler));
 }
@@ -15,6 +15,7 @@ namespace details {
 
 class Dcenter;
 class Session;
+class DecryptWorker;
 
 [[nodiscard]] int GetNextRequestId();
 
@@ -81,6 +82,7 @@ public:
 	[[nodiscard]] bool isTestMode() const;
 	[[nodiscard]] QString deviceModel() const;
 	[[nodiscard]] QString systemVersion() const;
+	[[nodiscard]] details::DecryptWorker &decryptWorker() const;
 
 	// Main thread.
 	void dcPersistentKeyChanged(DcId dcId, const AuthKeyPtr &persistentKey);
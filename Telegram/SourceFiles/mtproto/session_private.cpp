@@ -9,6 +9,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include "mtproto/details/mtproto_bound_key_creator.h"
 #include "mtproto/details/mtproto_dcenter.h"
+#include "mtproto/details/mtproto_decrypt_worker.h"
 #include "mtproto/details/mtproto_dump_to_text.h"
 #include "mtproto/details/mtproto_rsa_public_key.h"
 #include "mtproto/session.h"
@@ -21,6 +22,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "base/unixtime.h"
 #include "base/platform/base_platform_info.h"
 
+#include <QtCore/QSemaphore>
+
 #include <ksandbox.h>
 #include <zlib.h>
 
@@ -60,6 +63,20 @@ constexpr auto kSendStateRequestWaiting = crl::time(1000);
 // How much time to wait for some more requests, when sending msg acks.
 constexpr auto kAckSendWaiting = 10 * crl::time(1000);
 
+// Received packet layout, see handleReceived().
+constexpr auto kExternalHeaderIntsCount = 6U; // 2 auth_key_id, 4 msg_key
+constexpr auto kEncryptedHeaderIntsCount = 8U; // 2 salt, 2 session, 2 msg_id, 1 seq_no, 1 length
+constexpr auto kMinimalEncryptedIntsCount = kEncryptedHeaderIntsCount + 4U; // + 1 data + 3 padding
+constexpr auto kMinimalIntsCount = kExternalHeaderIntsCount + kMinimalEncryptedIntsCount;
+
+// Decrypt received packets in parallel only if there is enough work.
+constexpr auto kParallelDecryptMinPacketSize = 64 * 1024;
+constexpr auto kParallelDecryptMinBatchSize = 256 * 1024;
+
+// Don't keep larger decrypt buffers between received batches.
+constexpr auto kKeepDecryptBufferSize = 1024 * 1024;
+constexpr auto kKeepDecryptBuffersCount = 4;
+
 auto SyncTimeRequestDuration = kFastRequestDuration;
 
 using namespace details;
@@ -136,6 +153,85 @@ void WrapInvokeAfter(
 	return different;
 }
 
+// Returns the bytes of a serialized TL string without copying them.
+[[nodiscard]] bytes::const_span ReadSerializedBytes(
+		const mtpPrime *from,
+		const mtpPrime *end) {
+	if (from >= end) {
+		return {};
+	}
+	const auto available = uint32(end - from) * kIntSize;
+	const auto data = reinterpret_cast<const uchar*>(from);
+	const auto small = (data[0] < 254);
+	if (!small && data[0] != 254) {
+		return {};
+	}
+	const auto length = small
+		? uint32(data[0])
+		: (uint32(data[1])
+			| (uint32(data[2]) << 8)
+			| (uint32(data[3]) << 16));
+	const auto offset = small ? 1U : 4U;
+	if (offset + length > available) {
+		return {};
+	}
+	return bytes::make_span(data + offset, length);
+}
+
+// The gzip trailer keeps the unpacked size modulo 2^32, use it as a hint.
+// It comes from the server unchecked, so we don't reserve more than a few
+// megabytes by it, the buffer grows while the data is actually inflated.
+[[nodiscard]] int UnpackedIntsCountHint(bytes::const_span packed) {
+	constexpr auto kMinGzipSize = 18U; // 10 header + 8 trailer
+	constexpr auto kMaxDeflateRatio = 1032U;
+	constexpr auto kMaxHintSize = 4U * 1024 * 1024;
+
+	const auto packedLen = uint32(packed.size());
+	const auto fallback = int(packedLen / kIntSize) + 1;
+	if (packedLen < kMinGzipSize) {
+		return fallback;
+	}
+	const auto trailer = reinterpret_cast<const uchar*>(
+		packed.data() + packedLen - 4);
+	const auto unpacked = uint32(trailer[0])
+		| (uint32(trailer[1]) << 8)
+		| (uint32(trailer[2]) << 16)
+		| (uint32(trailer[3]) << 24);
+	if (!unpacked || uint64(unpacked) > uint64(packedLen) * kMaxDeflateRatio) {
+		return fallback;
+	}
+	// One more int, so that Z_STREAM_END arrives with some space left.
+	return int(std::min(unpacked, kMaxHintSize) / kIntSize) + 1;
+}
+
+[[nodiscard]] uint32 EncryptedIntsCount(const mtpBuffer &received) {
+	return (uint32(received.size()) - kExternalHeaderIntsCount) & ~0x03U;
+}
+
+// Decrypts the packet to the (already resized) buffer and checks msg_key.
+[[nodiscard]] bool DecryptReceived(
+		const mtpBuffer &received,
+		mtpBuffer &decrypted,
+		const AuthKeyPtr &encryptionKey) {
+	const auto ints = received.constData();
+	const auto encryptedInts = ints + kExternalHeaderIntsCount;
+	const auto encryptedBytesCount = uint32(decrypted.size()) * kIntSize;
+	const auto msgKey = *(MTPint128*)(ints + 2);
+
+	aesIgeDecrypt(encryptedInts, decrypted.data(), encryptedBytesCount, encryptionKey, msgKey);
+
+	std::array<uchar, 32> sha256Buffer = { { 0 } };
+
+	SHA256_CTX msgKeyLargeContext;
+	SHA256_Init(&msgKeyLargeContext);
+	SHA256_Update(&msgKeyLargeContext, encryptionKey->partForMsgKey(false), 32);
+	SHA256_Update(&msgKeyLargeContext, decrypted.constData(), encryptedBytesCount);
+	SHA256_Final(sha256Buffer.data(), &msgKeyLargeContext);
+
+	constexpr auto kMsgKeyShift = 8U;
+	return !ConstTimeIsDifferent(&msgKey, sha256Buffer.data() + kMsgKeyShift, sizeof(msgKey));
+}
+
 } // namespace
 
 SessionPrivate::SessionPrivate(
@@ -1238,37 +1334,28 @@ void SessionPrivate::handleReceived() {
 
 	onReceivedSome();
 
-	while (!_connection->received().empty()) {
-		auto intsBuffer = std::move(_connection->received().front());
-		_connection->received().pop_front();
-
-		constexpr auto kExternalHeaderIntsCount = 6U; // 2 auth_key_id, 4 msg_key
-		constexpr auto kEncryptedHeaderIntsCount = 8U; // 2 salt, 2 session, 2 msg_id, 1 seq_no, 1 length
-		constexpr auto kMinimalEncryptedIntsCount = kEncryptedHeaderIntsCount + 4U; // + 1 data + 3 padding
-		constexpr auto kMinimalIntsCount = kExternalHeaderIntsCount + kMinimalEncryptedIntsCount;
-		auto intsCount = uint32(intsBuffer.size());
-		auto ints = intsBuffer.constData();
-		if ((intsCount < kMinimalIntsCount) || (intsCount > kMaxMessageLength / kIntSize)) {
-			LOG(("TCP Error: bad message received, len %1").arg(intsCount * kIntSize));
-			return restart();
-		}
-		if (_keyId != *(uint64*)ints) {
-			LOG(("TCP Error: bad auth_key_id %1 instead of %2 received").arg(_keyId).arg(*(uint64*)ints));
-			return restart();
-		}
-
+	// Take the whole queue at once, so that all the packets are decrypted
+	// in one pass (in parallel, if there is enough data) and reusing the
+	// decrypt buffers, and only then handled one by one in order.
+	//
+	// If some packet is bad we still handle the good ones before it
+	// and restart only after that, like when they are handled one by one.
+	const auto guard = gsl::finally([&] { releaseReceivedBatch(); });
+	const auto takenAll = takeReceivedBatch();
+	decryptReceivedBatch();
+
+	for (auto i = 0, count = int(_receivedBatch.size()); i != count; ++i) {
 		constexpr auto kMinPaddingSize = 12U;
 		constexpr auto kMaxPaddingSize = 1024U;
 
-		auto encryptedInts = ints + kExternalHeaderIntsCount;
-		auto encryptedIntsCount = (intsCount - kExternalHeaderIntsCount) & ~0x03U;
-		auto encryptedBytesCount = encryptedIntsCount * kIntSize;
-		auto decryptedBuffer = QByteArray(encryptedBytesCount, Qt::Uninitialized);
-		auto msgKey = *(MTPint128*)(ints + 2);
-
-		aesIgeDecrypt(encryptedInts, decryptedBuffer.data(), encryptedBytesCount, _encryptionKey, msgKey);
+		const auto &decrypted = _decryptedBatch[i];
+		auto encryptedBytesCount = uint32(decrypted.buffer.size()) * kIntSize;
+		if (!decrypted.verified) {
+			LOG(("TCP Error: bad SHA256 hash after aesDecrypt in message"));
+			return restart();
+		}
 
-		auto decryptedInts = reinterpret_cast<const mtpPrime*>(decryptedBuffer.constData());
+		auto decryptedInts = decrypted.buffer.constData();
 		auto serverSalt = *(uint64*)&decryptedInts[0];
 		auto session = *(uint64*)&decryptedInts[2];
 		auto msgId = *(uint64*)&decryptedInts[4];
@@ -1280,20 +1367,6 @@ void SessionPrivate::handleReceived() {
 		// Can underflow, but it is an unsigned type, so we just check the range later.
 		auto paddingSize = static_cast<uint32>(encryptedBytesCount) - static_cast<uint32>(fullDataLength);
 
-		std::array<uchar, 32> sha256Buffer = { { 0 } };
-
-		SHA256_CTX msgKeyLargeContext;
-		SHA256_Init(&msgKeyLargeContext);
-		SHA256_Update(&msgKeyLargeContext, _encryptionKey->partForMsgKey(false), 32);
-		SHA256_Update(&msgKeyLargeContext, decryptedInts, encryptedBytesCount);
-		SHA256_Final(sha256Buffer.data(), &msgKeyLargeContext);
-
-		constexpr auto kMsgKeyShift = 8U;
-		if (ConstTimeIsDifferent(&msgKey, sha256Buffer.data() + kMsgKeyShift, sizeof(msgKey))) {
-			LOG(("TCP Error: bad SHA256 hash after aesDecrypt in message"));
-			return restart();
-		}
-
 		if ((messageLength > kMaxMessageLength)
 			|| (messageLength & 0x03)
 			|| (paddingSize < kMinPaddingSize)
@@ -1406,11 +1479,113 @@ void SessionPrivate::handleReceived() {
 			}
 		}
 	}
-	if (_connection->needHttpWait()) {
+	if (!takenAll) {
+		return restart();
+	} else if (_connection->needHttpWait()) {
 		_sessionData->queueSendAnything();
 	}
 }
 
+bool SessionPrivate::takeReceivedBatch() {
+	auto &received = _connection->received();
+	_receivedBatch.reserve(received.size());
+	while (!received.empty()) {
+		auto intsBuffer = std::move(received.front());
+		received.pop_front();
+
+		auto intsCount = uint32(intsBuffer.size());
+		auto ints = intsBuffer.constData();
+		if ((intsCount < kMinimalIntsCount) || (intsCount > kMaxMessageLength / kIntSize)) {
+			LOG(("TCP Error: bad message received, len %1").arg(intsCount * kIntSize));
+			return false;
+		}
+		if (_keyId != *(uint64*)ints) {
+			LOG(("TCP Error: bad auth_key_id %1 instead of %2 received").arg(_keyId).arg(*(uint64*)ints));
+			return false;
+		}
+		_receivedBatch.push_back(std::move(intsBuffer));
+	}
+	return true;
+}
+
+void SessionPrivate::decryptReceivedBatch() {
+	const auto count = int(_receivedBatch.size());
+	if (int(_decryptedBatch.size()) < count) {
+		_decryptedBatch.resize(count);
+	}
+	auto parallel = std::vector<int>();
+	auto parallelSize = int64();
+	for (auto i = 0; i != count; ++i) {
+		const auto intsCount = EncryptedIntsCount(_receivedBatch[i]);
+		_decryptedBatch[i].buffer.resize(intsCount);
+		if (intsCount * kIntSize >= kParallelDecryptMinPacketSize) {
+			parallel.push_back(i);
+			parallelSize += intsCount * kIntSize;
+		}
+	}
+	if (parallel.size() < 2 || parallelSize < kParallelDecryptMinBatchSize) {
+		parallel.clear();
+	}
+	const auto started = crl::now();
+	const auto key = _encryptionKey;
+	const auto decrypt = [&](int index) {
+		auto &decrypted = _decryptedBatch[index];
+		decrypted.verified = DecryptReceived(
+			_receivedBatch[index],
+			decrypted.buffer,
+			key);
+	};
+
+	// Every second large packet goes to the worker thread,
+	// everything else is decrypted here while we wait for it.
+	auto offloaded = std::vector<int>();
+	for (auto i = 1; i < int(parallel.size()); i += 2) {
+		offloaded.push_back(parallel[i]);
+	}
+	auto semaphore = QSemaphore();
+	if (!offloaded.empty()) {
+		_instance->decryptWorker().push([&] {
+			for (const auto index : offloaded) {
+				decrypt(index);
+			}
+			semaphore.release();
+		});
+	}
+	for (auto i = 0; i != count; ++i) {
+		if (!ranges::contains(offloaded, i)) {
+			decrypt(i);
+		}
+	}
+	if (!offloaded.empty()) {
+		semaphore.acquire();
+	}
+
+	if (count > 1 && Logs::DebugEnabled()) {
+		auto size = int64();
+		for (auto i = 0; i != count; ++i) {
+			size += _decryptedBatch[i].buffer.size() * kIntSize;
+		}
+		DEBUG_LOG(("MTP Info: decrypted %1 packets (%2 in parallel), "
+			"%3 bytes in %4 ms."
+			).arg(count
+			).arg(int(offloaded.size())
+			).arg(size
+			).arg(crl::now() - started));
+	}
+}
+
+void SessionPrivate::releaseReceivedBatch() {
+	_receivedBatch.clear();
+	if (int(_decryptedBatch.size()) > kKeepDecryptBuffersCount) {
+		_decryptedBatch.resize(kKeepDecryptBuffersCount);
+	}
+	for (auto &decrypted : _decryptedBatch) {
+		if (decrypted.buffer.capacity() > kKeepDecryptBufferSize / kIntSize) {
+			decrypted.buffer = mtpBuffer();
+		}
+	}
+}
+
 SessionPrivate::HandleResult SessionPrivate::handleOneReceived(
 		const mtpPrime *from,
 		const mtpPrime *end,
@@ -1972,15 +2147,14 @@ SessionPrivate::HandleResult SessionPrivate::handleBindResponse(
 }
 
 mtpBuffer SessionPrivate::ungzip(const mtpPrime *from, const mtpPrime *end) const {
-	mtpBuffer result; // * 4 because of mtpPrime type
-	result.resize(0);
-
-	MTPstring packed;
-	if (!packed.read(from, end)) { // read packed string as serialized mtp string type
+	// Inflate straight from the received data, without copying it to an
+	// MTPstring first, and allocate the output by the gzip size hint.
+	const auto packed = ReadSerializedBytes(from, end);
+	if (packed.empty()) {
 		LOG(("RPC Error: could not read gziped bytes."));
-		return result;
+		return mtpBuffer();
 	}
-	uint32 packedLen = packed.v.size(), unpackedChunk = packedLen;
+	const auto packedLen = uint32(packed.size());
 
 	z_stream stream;
 	stream.zalloc = 0;
@@ -1991,32 +2165,42 @@ mtpBuffer SessionPrivate::ungzip(const mtpPrime *from, const mtpPrime *end) cons
 	int res = inflateInit2(&stream, 16 + MAX_WBITS);
 	if (res != Z_OK) {
 		LOG(("RPC Error: could not init zlib stream, code: %1").arg(res));
-		return result;
+		return mtpBuffer();
 	}
 	stream.avail_in = packedLen;
-	stream.next_in = reinterpret_cast<Bytef*>(packed.v.data());
-
-	stream.avail_out = 0;
-	while (!stream.avail_out) {
-		result.resize(result.size() + unpackedChunk);
-		stream.avail_out = unpackedChunk * sizeof(mtpPrime);
-		stream.next_out = (Bytef*)&result[result.size() - unpackedChunk];
-		int res = inflate(&stream, Z_NO_FLUSH);
-		if (res != Z_OK && res != Z_STREAM_END) {
+	stream.next_in = reinterpret_cast<Bytef*>(
+		const_cast<bytes::type*>(packed.data()));
+
+	auto result = mtpBuffer(UnpackedIntsCountHint(packed));
+	stream.avail_out = result.size() * sizeof(mtpPrime);
+	stream.next_out = reinterpret_cast<Bytef*>(result.data());
+	while (true) {
+		if (!stream.avail_out) {
+			// The size hint was wrong, grow the buffer geometrically.
+			const auto was = int(result.size());
+			const auto add = std::max(was / 2, int(packedLen / kIntSize) + 1);
+			result.resize(was + add);
+			stream.avail_out = add * sizeof(mtpPrime);
+			stream.next_out = reinterpret_cast<Bytef*>(result.data() + was);
+		}
+		const auto res = inflate(&stream, Z_NO_FLUSH);
+		if (res == Z_STREAM_END) {
+			break;
+		} else if (res != Z_OK) {
 			inflateEnd(&stream);
 			LOG(("RPC Error: could not unpack gziped data, code: %1").arg(res));
-			DEBUG_LOG(("RPC Error: bad gzip: %1").arg(Logs::mb(packed.v.constData(), packedLen).str()));
+			DEBUG_LOG(("RPC Error: bad gzip: %1").arg(Logs::mb(packed.data(), packedLen).str()));
 			return mtpBuffer();
 		}
 	}
-	if (stream.avail_out & 0x03) {
-		uint32 badSize = result.size() * sizeof(mtpPrime) - stream.avail_out;
-		LOG(("RPC Error: bad length of unpacked data %1").arg(badSize));
-		DEBUG_LOG(("RPC Error: bad unpacked data %1").arg(Logs::mb(result.data(), badSize).str()));
+	const auto unpackedBytes = uint32(stream.total_out);
+	inflateEnd(&stream);
+	if (unpackedBytes & 0x03) {
+		LOG(("RPC Error: bad length of unpacked data %1").arg(unpackedBytes));
+		DEBUG_LOG(("RPC Error: bad unpacked data %1").arg(Logs::mb(result.data(), unpackedBytes).str()));
 		return mtpBuffer();
 	}
-	result.resize(result.size() - (stream.avail_out >> 2));
-	inflateEnd(&stream);
+	result.resize(unpackedBytes / kIntSize);
 	if (!result.size()) {
 		LOG(("RPC Error: bad length of unpacked data 0"));
 	}
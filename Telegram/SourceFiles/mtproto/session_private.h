@@ -85,6 +85,11 @@ private:
 	void onReceivedSome();
 
 	void handleReceived();
+	// Returns false if a bad packet was found, the packets before it
+	// are taken to the batch anyway.
+	[[nodiscard]] bool takeReceivedBatch();
+	void decryptReceivedBatch();
+	void releaseReceivedBatch();
 
 	void retryByTimer();
 	void waitConnectedFailed();
@@ -225,6 +230,13 @@ private:
 	uint32 _messagesCounter = 0;
 	bool _sessionMarkedAsStarted = false;
 
+	struct DecryptedPacket {
+		mtpBuffer buffer;
+		bool verified = false;
+	};
+	std::vector<mtpBuffer> _receivedBatch;
+	std::vector<DecryptedPacket> _decryptedBatch;
+
 	QVector<MTPlong> _ackRequestData;
 	QVector<MTPlong> _resendRequestData;
 	base::flat_set<mtpMsgId> _stateRequestData;
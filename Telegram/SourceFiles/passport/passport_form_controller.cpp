@@ -1562,7 +1562,7 @@ void FormController::subscribeToUploader() {
 	}, _uploaderSubscriptions);
 
 	session().uploader().secureProgress(
-	) | rpl::start_with_next([=](const UploadSecureProgress &data) {
+	) | rpl::start_with_next([=](const UploadProgress &data) {
 		scanUploadProgress(data);
 	}, _uploaderSubscriptions);
 
@@ -1623,7 +1623,7 @@ void FormController::scanUploadDone(const Storage::UploadSecureDone &data) {
 }
 
 void FormController::scanUploadProgress(
-		const Storage::UploadSecureProgress &data) {
+		const Storage::UploadProgress &data) {
 	if (const auto file = findEditFile(data.fullId)) {
 		Assert(file->uploadData != nullptr);
 
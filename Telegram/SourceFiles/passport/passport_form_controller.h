@@ -16,7 +16,7 @@ class mtpFileLoader;
 
 namespace Storage {
 struct UploadSecureDone;
-struct UploadSecureProgress;
+struct UploadProgress;
 } // namespace Storage
 
 namespace Window {
@@ -513,7 +513,7 @@ private:
 		EditFile &file,
 		UploadScanData &&data);
 	void scanUploadDone(const Storage::UploadSecureDone &data);
-	void scanUploadProgress(const Storage::UploadSecureProgress &data);
+	void scanUploadProgress(const Storage::UploadProgress &data);
 	void scanUploadFail(const FullMsgId &fullId);
 	void scanDeleteRestore(
 		not_null<const Value*> value,
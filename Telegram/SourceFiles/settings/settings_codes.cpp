@@ -12,6 +12,8 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "mainwindow.h"
 #include "data/data_session.h"
 #include "data/data_cloud_themes.h"
+#include "data/data_histories.h"
+#include "history/history.h"
 #include "main/main_session.h"
 #include "main/main_account.h"
 #include "main/main_domain.h"
@@ -31,6 +33,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "api/api_updates.h"
 #include "base/qt/qt_common_adapters.h"
 #include "base/custom_app_icon.h"
+#include "ui/text/format_values.h"
 #include "boxes/abstract_box.h" // Ui::show().
 
 #include <zlib.h>
@@ -161,6 +164,30 @@ auto GenerateCodes() {
 			window->showSettings(Settings::Folders::Id());
 		}
 	});
+	codes.emplace(u"messagesmemory"_q, [](SessionController *window) {
+		if (!window) {
+			return;
+		}
+		constexpr auto kShowHistories = 20;
+		auto usage = window->session().data().histories().collectMemoryUsage();
+		ranges::sort(usage, ranges::greater(), &Data::Histories::MemoryUsage::bytes);
+		auto messages = 0;
+		auto bytes = int64();
+		for (const auto &entry : usage) {
+			messages += entry.messages;
+			bytes += entry.bytes;
+		}
+		auto text = u"Loaded messages: %1, about %2.\n"_q.arg(
+			QString::number(messages),
+			Ui::FormatSizeText(bytes));
+		for (const auto &entry : usage | ranges::views::take(kShowHistories)) {
+			text += u"\n%1: %2, %3"_q.arg(
+				entry.history->peer->name(),
+				QString::number(entry.messages),
+				Ui::FormatSizeText(entry.bytes));
+		}
+		Ui::show(Ui::MakeInformBox(text));
+	});
 	codes.emplace(u"registertg"_q, [](SessionController *window) {
 		Core::Application::RegisterUrlScheme();
 		Ui::Toast::Show("Forced custom scheme register.");
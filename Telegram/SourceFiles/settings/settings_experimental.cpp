@@ -24,6 +24,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "info/profile/info_profile_actions.h"
 #include "lang/lang_keys.h"
 #include "mainwindow.h"
+#include "media/audio/media_audio.h"
 #include "media/player/media_player_instance.h"
 #include "webview/webview_embed.h"
 #include "window/main_window.h"
@@ -33,6 +34,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "window/notifications_manager.h"
 #include "storage/localimageloader.h"
 #include "data/data_document_resolver.h"
+#include "data/stickers/data_custom_emoji.h"
 #include "styles/style_settings.h"
 #include "styles/style_layers.h"
 
@@ -150,12 +152,15 @@ void SetupExperimental(
 	addToggle(Ui::GL::kOptionAllowLinuxNvidiaOpenGL);
 	addToggle(Ui::kOptionUseSmallMsgBubbleRadius);
 	addToggle(Media::Player::kOptionDisableAutoplayNext);
+	addToggle(Media::Player::kOptionLogAudioWakeups);
 	addToggle(kOptionSendLargePhotos);
 	addToggle(Webview::kOptionWebviewDebugEnabled);
 	addToggle(kOptionAutoScrollInactiveChat);
 	addToggle(Window::Notifications::kOptionGNotification);
 	addToggle(Core::kOptionFreeType);
+	addToggle(Core::kOptionSkipNetworkLogs);
 	addToggle(Data::kOptionExternalVideoPlayer);
+	addToggle(Data::kOptionLogCustomEmojiCache);
 	addToggle(Window::kOptionNewWindowsSizeAsFirst);
 }
 
@@ -25,13 +25,43 @@ constexpr auto TdfMagicLen = int(sizeof(TdfMagic));
 
 constexpr auto kStrongIterationsCount = 100'000;
 
+// Write latencies are bucketed by powers of two milliseconds.
+constexpr auto kLatencyBuckets = 12;
+constexpr auto kLogLatenciesEach = 256;
+
 struct WriteEntry {
 	QString basePath;
 	QString base;
-	QByteArray data;
-	QByteArray md5;
+	std::vector<WritePart> parts;
+	const char *kind = nullptr;
+	crl::time queued = 0;
+};
+
+struct WriteLatencies {
+	std::array<int, kLatencyBuckets> buckets = { { 0 } };
+	crl::time max = 0;
+	int written = 0;
+	int coalesced = 0;
 };
 
+[[nodiscard]] QByteArray PrepareEncryptedData(
+		QByteArray toEncrypt,
+		const MTP::AuthKeyPtr &key) {
+	// prepare for encryption
+	uint32 size = toEncrypt.size(), fullSize = size;
+	if (fullSize & 0x0F) {
+		fullSize += 0x10 - (fullSize & 0x0F);
+		toEncrypt.resize(fullSize);
+		base::RandomFill(toEncrypt.data() + size, fullSize - size);
+	}
+	*(uint32*)toEncrypt.data() = size;
+	QByteArray encrypted(0x10 + fullSize, Qt::Uninitialized); // 128bit of sha1 - key128, sizeof(data), data
+	hashSha1(toEncrypt.constData(), toEncrypt.size(), encrypted.data());
+	MTP::aesEncryptLocal(toEncrypt.constData(), encrypted.data() + 0x10, fullSize, key, encrypted.constData());
+
+	return encrypted;
+}
+
 class WriteManager final {
 public:
 	explicit WriteManager(crl::weak_on_thread<WriteManager> weak);
@@ -41,10 +71,22 @@ public:
 	void writeSyncAll();
 
 private:
+	struct Prepared {
+		QByteArray data;
+		QByteArray md5;
+	};
+
 	void scheduleWrite();
 	void writeScheduled();
 	bool writeOneScheduledNow();
 	void writeNow(WriteEntry &&entry);
+	bool writePrepared(const WriteEntry &entry, const Prepared &prepared);
+
+	[[nodiscard]] static Prepared Prepare(const WriteEntry &entry);
+
+	void countLatency(const WriteEntry &entry);
+	void countCoalesced(const WriteEntry &entry);
+	void logLatencies() const;
 
 	template <typename File>
 	[[nodiscard]] bool open(File &file, const WriteEntry &entry, char postfix);
@@ -57,6 +99,9 @@ private:
 	crl::weak_on_thread<WriteManager> _weak;
 	std::deque<WriteEntry> _scheduled;
 
+	base::flat_map<QString, WriteLatencies> _latencies;
+	int _writtenTillLog = 0;
+
 };
 
 class AsyncWriteManager final {
@@ -81,6 +126,8 @@ void WriteManager::write(WriteEntry &&entry) {
 	if (i == end(_scheduled)) {
 		_scheduled.push_back(std::move(entry));
 	} else {
+		// The older snapshot is dropped before it was even encrypted.
+		countCoalesced(*i);
 		*i = std::move(entry);
 	}
 	scheduleWrite();
@@ -89,12 +136,53 @@ void WriteManager::write(WriteEntry &&entry) {
 void WriteManager::writeSync(WriteEntry &&entry) {
 	const auto i = ranges::find(_scheduled, entry.base, &WriteEntry::base);
 	if (i != end(_scheduled)) {
+		countCoalesced(*i);
 		_scheduled.erase(i);
 	}
 	writeNow(std::move(entry));
 }
 
 void WriteManager::writeNow(WriteEntry &&entry) {
+	writePrepared(entry, Prepare(entry));
+	countLatency(entry);
+}
+
+WriteManager::Prepared WriteManager::Prepare(const WriteEntry &entry) {
+	auto result = Prepared();
+	auto buffer = QBuffer(&result.data);
+	const auto opened = buffer.open(QIODevice::WriteOnly);
+	Assert(opened);
+	auto stream = QDataStream(&buffer);
+
+	auto md5 = HashMd5();
+	auto fullSize = 0;
+	for (const auto &part : entry.parts) {
+		const auto data = part.key
+			? PrepareEncryptedData(part.data, part.key)
+			: part.data;
+		stream << data;
+		quint32 len = data.isNull() ? 0xffffffff : data.size();
+		if (QSysInfo::ByteOrder != QSysInfo::BigEndian) {
+			len = qbswap(len);
+		}
+		md5.feed(&len, sizeof(len));
+		md5.feed(data.constData(), data.size());
+		fullSize += sizeof(len) + data.size();
+	}
+	stream.setDevice(nullptr);
+	buffer.close();
+
+	md5.feed(&fullSize, sizeof(fullSize));
+	qint32 version = AppVersion;
+	md5.feed(&version, sizeof(version));
+	md5.feed(TdfMagic, TdfMagicLen);
+	result.md5 = QByteArray((const char*)md5.result(), 0x10);
+	return result;
+}
+
+bool WriteManager::writePrepared(
+		const WriteEntry &entry,
+		const Prepared &prepared) {
 	const auto path = [&](char postfix) {
 		return this->path(entry, postfix);
 	};
@@ -102,8 +190,8 @@ void WriteManager::writeNow(WriteEntry &&entry) {
 		return this->open(file, entry, postfix);
 	};
 	const auto write = [&](auto &file) {
-		file.write(entry.data);
-		file.write(entry.md5);
+		file.write(prepared.data);
+		file.write(prepared.md5);
 	};
 	const auto safe = path('s');
 	const auto simple = path('0');
@@ -114,7 +202,7 @@ void WriteManager::writeNow(WriteEntry &&entry) {
 		if (save.commit()) {
 			QFile::remove(simple);
 			QFile::remove(backup);
-			return;
+			return true;
 		}
 		LOG(("Storage Error: Could not commit '%1'.").arg(safe));
 	}
@@ -126,18 +214,64 @@ void WriteManager::writeNow(WriteEntry &&entry) {
 
 		QFile::remove(backup);
 		if (base::Platform::RenameWithOverwrite(simple, safe)) {
-			return;
+			return true;
 		}
 		QFile::remove(safe);
 		LOG(("Storage Error: Could not rename '%1' to '%2', removing.").arg(
 			simple,
 			safe));
 	}
+	return false;
+}
+
+void WriteManager::countLatency(const WriteEntry &entry) {
+	const auto latency = crl::now() - entry.queued;
+	auto &latencies = _latencies[QString::fromLatin1(entry.kind)];
+	auto bucket = 0;
+	while (bucket + 1 < kLatencyBuckets
+		&& (crl::time(1) << bucket) <= latency) {
+		++bucket;
+	}
+	++latencies.buckets[bucket];
+	++latencies.written;
+	accumulate_max(latencies.max, latency);
+
+	if (++_writtenTillLog == kLogLatenciesEach) {
+		_writtenTillLog = 0;
+		logLatencies();
+	}
+}
+
+void WriteManager::countCoalesced(const WriteEntry &entry) {
+	++_latencies[QString::fromLatin1(entry.kind)].coalesced;
+}
+
+void WriteManager::logLatencies() const {
+	for (const auto &[kind, latencies] : _latencies) {
+		auto buckets = QStringList();
+		for (auto i = 0; i != kLatencyBuckets; ++i) {
+			if (const auto count = latencies.buckets[i]) {
+				const auto last = (i + 1 == kLatencyBuckets);
+				buckets.push_back(u"%1%2ms: %3"_q
+					.arg(last ? '>' : '<')
+					.arg(crl::time(1) << (last ? (i - 1) : i))
+					.arg(count));
+			}
+		}
+		DEBUG_LOG(("Storage Latency: '%1' written %2, coalesced %3, "
+			"max %4ms, %5"
+			).arg(kind
+			).arg(latencies.written
+			).arg(latencies.coalesced
+			).arg(latencies.max
+			).arg(buckets.join(", ")));
+	}
 }
 
 void WriteManager::writeSyncAll() {
 	while (writeOneScheduledNow()) {
 	}
+	logLatencies();
 }
 
 bool WriteManager::writeOneScheduledNow() {
@@ -398,50 +532,43 @@ FileWriteDescriptor::~FileWriteDescriptor() {
 
 void FileWriteDescriptor::init(const QString &name) {
 	_base = _basePath + name;
-	_buffer.setBuffer(&_safeData);
-	const auto opened = _buffer.open(QIODevice::WriteOnly);
-	Assert(opened);
-	_stream.setDevice(&_buffer);
+}
+
+void FileWriteDescriptor::setKind(const char *kind) {
+	_kind = kind;
 }
 
 void FileWriteDescriptor::writeData(const QByteArray &data) {
-	if (!_stream.device()) {
+	if (_finished) {
 		return;
 	}
-	_stream << data;
-	quint32 len = data.isNull() ? 0xffffffff : data.size();
-	if (QSysInfo::ByteOrder != QSysInfo::BigEndian) {
-		len = qbswap(len);
-	}
-	_md5.feed(&len, sizeof(len));
-	_md5.feed(data.constData(), data.size());
-	_fullSize += sizeof(len) + data.size();
+	_parts.push_back({ .data = data });
 }
 
 void FileWriteDescriptor::writeEncrypted(
-	EncryptedDescriptor &data,
-	const MTP::AuthKeyPtr &key) {
-	writeData(PrepareEncrypted(data, key));
+		EncryptedDescriptor &data,
+		const MTP::AuthKeyPtr &key) {
+	if (_finished) {
+		return;
+	}
+	// The encryption itself is done in the write thread,
+	// here we only take a snapshot of the serialized data.
+	data.finish();
+	_parts.push_back({ .data = data.data, .key = key });
 }
 
 void FileWriteDescriptor::finish() {
-	if (!_stream.device()) {
+	if (_finished) {
 		return;
 	}
-
-	_stream.setDevice(nullptr);
-	_md5.feed(&_fullSize, sizeof(_fullSize));
-	qint32 version = AppVersion;
-	_md5.feed(&version, sizeof(version));
-	_md5.feed(TdfMagic, TdfMagicLen);
-
-	_buffer.close();
+	_finished = true;
 
 	auto entry = WriteEntry{
 		.basePath = _basePath,
 		.base = _base,
-		.data = _safeData,
-		.md5 = QByteArray((const char*)_md5.result(), 0x10)
+		.parts = std::move(_parts),
+		.kind = _kind,
+		.queued = crl::now(),
 	};
 	if (_sync) {
 		Manager.writeSync(std::move(entry));
@@ -454,21 +581,7 @@ void FileWriteDescriptor::finish() {
 		EncryptedDescriptor &data,
 		const MTP::AuthKeyPtr &key) {
 	data.finish();
-	QByteArray &toEncrypt(data.data);
-
-	// prepare for encryption
-	uint32 size = toEncrypt.size(), fullSize = size;
-	if (fullSize & 0x0F) {
-		fullSize += 0x10 - (fullSize & 0x0F);
-		toEncrypt.resize(fullSize);
-		base::RandomFill(toEncrypt.data() + size, fullSize - size);
-	}
-	*(uint32*)toEncrypt.data() = size;
-	QByteArray encrypted(0x10 + fullSize, Qt::Uninitialized); // 128bit of sha1 - key128, sizeof(data), data
-	hashSha1(toEncrypt.constData(), toEncrypt.size(), encrypted.data());
-	MTP::aesEncryptLocal(toEncrypt.constData(), encrypted.data() + 0x10, fullSize, key, encrypted.constData());
-
-	return encrypted;
+	return PrepareEncryptedData(data.data, key);
 }
 
 bool ReadFile(
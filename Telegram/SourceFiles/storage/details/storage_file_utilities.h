@@ -52,6 +52,11 @@ struct EncryptedDescriptor final {
 	EncryptedDescriptor &data,
 	const MTP::AuthKeyPtr &key);
 
+struct WritePart {
+	QByteArray data;
+	MTP::AuthKeyPtr key; // If not null the data is encrypted before write.
+};
+
 class FileWriteDescriptor final {
 public:
 	FileWriteDescriptor(
@@ -64,6 +69,9 @@ public:
 		bool sync = false);
 	~FileWriteDescriptor();
 
+	// Kind of the file for the write latency statistics.
+	void setKind(const char *kind);
+
 	void writeData(const QByteArray &data);
 	void writeEncrypted(
 		EncryptedDescriptor &data,
@@ -74,13 +82,11 @@ private:
 	void finish();
 
 	const QString _basePath;
-	QBuffer _buffer;
-	QDataStream _stream;
-	QByteArray _safeData;
 	QString _base;
-	HashMd5 _md5;
-	int _fullSize = 0;
+	std::vector<WritePart> _parts;
+	const char *_kind = "other";
 	bool _sync = false;
+	bool _finished = false;
 
 };
 
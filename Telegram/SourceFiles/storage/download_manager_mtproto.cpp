@@ -21,7 +21,7 @@ namespace {
 
 constexpr auto kKillSessionTimeout = 15 * crl::time(1000);
 constexpr auto kStartWaitedInSession = 4 * kDownloadPartSize;
-constexpr auto kMaxWaitedInSession = 16 * kDownloadPartSize;
+constexpr auto kMaxWaitedInSession = 32 * kDownloadPartSize;
 constexpr auto kStartSessionsCount = 1;
 constexpr auto kMaxSessionsCount = 8;
 constexpr auto kMaxTrackedSessionRemoves = 64;
@@ -33,6 +33,9 @@ constexpr auto kRemoveSessionAfterTimeouts = 4;
 constexpr auto kResetDownloadPrioritiesTimeout = crl::time(200);
 constexpr auto kBadRequestDurationThreshold = 8 * crl::time(1000);
 
+// We try to keep in flight this many times the bandwidth-delay product.
+constexpr auto kWaitedBandwidthDelayFactor = 2;
+
 // Each (session remove by timeouts) we wait for time:
 // kRetryAddSessionTimeout * max(removesCount, kMaxTrackedSessionRemoves)
 // and for successes in all remaining sessions:
@@ -259,16 +262,7 @@ void DownloadManagerMtproto::requestSucceeded(
 		});
 		return;
 	}
-	if (amountAtRequestStart == data.maxWaitedAmount
-		&& data.maxWaitedAmount < kMaxWaitedInSession) {
-		data.maxWaitedAmount = std::min(
-			data.maxWaitedAmount + kDownloadPartSize,
-			kMaxWaitedInSession);
-		DEBUG_LOG(("Download (%1,%2) increased max waited amount %3."
-			).arg(dcId
-			).arg(index
-			).arg(data.maxWaitedAmount));
-	}
+	updateMaxWaitedAmount(dcId, data, amountAtRequestStart, duration);
 	data.successes = std::min(data.successes + 1, kMaxTrackedSuccesses);
 	const auto notEnough = ranges::any_of(
 		dc.sessions,
@@ -298,6 +292,74 @@ void DownloadManagerMtproto::requestSucceeded(
 		).arg(dc.sessions.size()));
 }
 
+void DownloadManagerMtproto::updateMaxWaitedAmount(
+		MTP::DcId dcId,
+		DcSessionBalanceData &data,
+		int amountAtRequestStart,
+		crl::time duration) {
+	data.minDuration = data.minDuration
+		? std::min(data.minDuration, duration)
+		: std::max(duration, crl::time(1));
+
+	// Count the parts actually delivered during at least one round trip.
+	// If the window wasn't full the session was limited by us, not by the
+	// link, and such a sample may only raise the estimate.
+	const auto now = crl::now();
+	data.delivered += kDownloadPartSize;
+	if (amountAtRequestStart < data.maxWaitedAmount) {
+		data.deliveredLimited = true;
+	}
+	if (!data.deliveredSince) {
+		data.deliveredSince = now - duration;
+	} else if (now - data.deliveredSince >= data.minDuration) {
+		const auto sample = int64(data.delivered) * 1000
+			/ std::max(now - data.deliveredSince, crl::time(1));
+		if (!data.deliveredLimited || sample > data.bytesPerSecond) {
+			data.bytesPerSecond = data.bytesPerSecond
+				? ((data.bytesPerSecond * 3 + sample) / 4)
+				: sample;
+		}
+		data.deliveredSince = now;
+		data.delivered = 0;
+		data.deliveredLimited = false;
+	}
+
+	const auto bandwidthDelay = data.bytesPerSecond
+		* data.minDuration
+		/ 1000;
+	const auto target = !data.bytesPerSecond
+		? (data.maxWaitedAmount + kDownloadPartSize)
+		: int(std::clamp(
+			(bandwidthDelay * kWaitedBandwidthDelayFactor
+				+ kDownloadPartSize - 1) / kDownloadPartSize,
+			int64(kStartWaitedInSession / kDownloadPartSize),
+			int64(kMaxWaitedInSession / kDownloadPartSize))
+		) * kDownloadPartSize;
+
+	const auto was = data.maxWaitedAmount;
+	if (amountAtRequestStart == data.maxWaitedAmount
+		&& data.maxWaitedAmount < kMaxWaitedInSession) {
+		// The window was full, grow it up to the estimated target at once.
+		data.maxWaitedAmount = std::clamp(
+			target,
+			data.maxWaitedAmount + kDownloadPartSize,
+			kMaxWaitedInSession);
+	} else if (target < data.maxWaitedAmount) {
+		// Don't keep more in flight than the link needs, so that a
+		// request with a higher priority doesn't wait behind too much.
+		data.maxWaitedAmount -= kDownloadPartSize;
+	}
+	if (data.maxWaitedAmount != was) {
+		DEBUG_LOG(("Download (%1) changed max waited amount %2 -> %3, "
+			"speed: %4 B/s, rtt: %5 ms."
+			).arg(dcId
+			).arg(was
+			).arg(data.maxWaitedAmount
+			).arg(data.bytesPerSecond
+			).arg(data.minDuration));
+	}
+}
+
 int DownloadManagerMtproto::chooseSessionIndex(MTP::DcId dcId) const {
 	const auto i = _balanceData.find(dcId);
 	Assert(i != end(_balanceData));
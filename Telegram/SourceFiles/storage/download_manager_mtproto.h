@@ -81,6 +81,13 @@ private:
 		int requested = 0;
 		int successes = 0; // Since last timeout in this dc in any session.
 		int maxWaitedAmount = 0;
+
+		// Bandwidth-delay product estimation for the in-flight window.
+		int64 bytesPerSecond = 0;
+		crl::time minDuration = 0;
+		crl::time deliveredSince = 0;
+		int delivered = 0;
+		bool deliveredLimited = false;
 	};
 	struct DcBalanceData {
 		DcBalanceData();
@@ -103,6 +110,11 @@ private:
 	void killSessions(MTP::DcId dcId);
 
 	void resetGeneration();
+	void updateMaxWaitedAmount(
+		MTP::DcId dcId,
+		DcSessionBalanceData &data,
+		int amountAtRequestStart,
+		crl::time duration);
 	void sessionTimedOut(MTP::DcId dcId, int index);
 	void removeSession(MTP::DcId dcId);
 
@@ -26,8 +26,22 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 namespace Storage {
 namespace {
 
-// max 512kb uploaded at the same time in each session
-constexpr auto kMaxUploadFileParallelSize = MTP::kUploadSessionsCount * 512 * 1024;
+// Each upload session starts with 512kb uploaded at the same time and
+// then adjusts that window by how fast the parts are being uploaded.
+constexpr auto kUploadWindowInitial = int64(512 * 1024);
+constexpr auto kUploadWindowMin = int64(128 * 1024);
+constexpr auto kUploadWindowMax = int64(4 * 1024 * 1024);
+
+// Parts uploaded faster than that grow the window of their session,
+// parts uploaded slower than that shrink it in half.
+constexpr auto kFastPartThreshold = crl::time(1000);
+constexpr auto kSlowPartThreshold = 4 * crl::time(1000);
+
+// That many files are uploaded at the same time, taking turns.
+constexpr auto kMaxFilesInParallel = 4;
+
+// Documents are read and hashed in the background that much ahead.
+constexpr auto kReadAheadSize = int64(2 * 1024 * 1024);
 
 constexpr auto kDocumentMaxPartsCountDefault = 4000;
 
@@ -46,9 +60,6 @@ constexpr auto kDocumentUploadPartSize3 = 256 * 1024;
 // 512kb for large document ( <= 1500mb )
 constexpr auto kDocumentUploadPartSize4 = 512 * 1024;
 
-// One part each half second, if not uploaded faster.
-constexpr auto kUploadRequestInterval = crl::time(500);
-
 // How much time without upload causes additional session kill.
 constexpr auto kKillSessionTimeout = 15 * crl::time(1000);
 
@@ -58,6 +69,42 @@ constexpr auto kKillSessionTimeout = 15 * crl::time(1000);
 
 } // namespace
 
+// Reads document parts and feeds them to the md5 hash on a background
+// thread. Parts are read in order and only one read() at a time.
+class Uploader::PartsReader final {
+public:
+	PartsReader(
+		QString filepath,
+		QByteArray content,
+		int64 size,
+		int64 partSize,
+		bool hash);
+
+	[[nodiscard]] std::vector<QByteArray> read(int index, int count);
+	[[nodiscard]] QByteArray md5Hex();
+
+private:
+	[[nodiscard]] QByteArray readPart(int index);
+
+	const QString _filepath;
+	const QByteArray _content;
+	const int64 _size = 0;
+	const int64 _partSize = 0;
+	const bool _hash = false;
+
+	std::unique_ptr<QFile> _file;
+	HashMd5 _md5Hash;
+
+};
+
+struct Uploader::Request {
+	FullMsgId fullId;
+	int64 size = 0;
+	int dcIndex = 0;
+	bool docPart = false;
+	crl::time sent = 0;
+};
+
 struct Uploader::File {
 	File(const SendMediaReady &media);
 	File(const std::shared_ptr<FileLoadResult> &file);
@@ -68,23 +115,91 @@ struct Uploader::File {
 	std::shared_ptr<FileLoadResult> file;
 	SendMediaReady media;
 	int32 partsCount = 0;
-	mutable int64 fileSentSize = 0;
+	int64 partsSize = 0;
+	int64 fileSentSize = 0;
 
 	uint64 id() const;
 	SendMediaType type() const;
 	uint64 thumbId() const;
 	const QString &filename() const;
 
-	HashMd5 md5Hash;
+	[[nodiscard]] UploadFileParts &parts();
+	[[nodiscard]] uint64 partsOfId() const;
+	[[nodiscard]] bool hasPartsToSend();
+	[[nodiscard]] bool hasPartReady();
+	[[nodiscard]] bool uploaded();
+	[[nodiscard]] int64 bytesPerSecond() const;
 
-	std::unique_ptr<QFile> docFile;
+	std::shared_ptr<PartsReader> reader;
+	std::deque<QByteArray> docReadyParts;
+	bool docReading = false;
 	int64 docSize = 0;
 	int64 docPartSize = 0;
+	int docReadParts = 0;
 	int docSentParts = 0;
+	int docDoneParts = 0;
 	int docPartsCount = 0;
 
+	int requestsCount = 0;
+	crl::time started = 0;
+	int64 doneSize = 0;
+
 };
 
+Uploader::PartsReader::PartsReader(
+	QString filepath,
+	QByteArray content,
+	int64 size,
+	int64 partSize,
+	bool hash)
+: _filepath(std::move(filepath))
+, _content(std::move(content))
+, _size(size)
+, _partSize(partSize)
+, _hash(hash) {
+}
+
+std::vector<QByteArray> Uploader::PartsReader::read(int index, int count) {
+	auto result = std::vector<QByteArray>();
+	result.reserve(count);
+	for (auto i = index; i != index + count; ++i) {
+		auto part = readPart(i);
+		if (part.isEmpty()) {
+			return {};
+		}
+		result.push_back(std::move(part));
+	}
+	return result;
+}
+
+QByteArray Uploader::PartsReader::readPart(int index) {
+	const auto offset = index * _partSize;
+	auto result = QByteArray();
+	if (_content.isEmpty()) {
+		if (!_file) {
+			_file = std::make_unique<QFile>(_filepath);
+			if (!_file->open(QIODevice::ReadOnly)) {
+				return QByteArray();
+			}
+		}
+		result = _file->read(_partSize);
+	} else {
+		result = _content.mid(offset, _partSize);
+	}
+	if (result.size() != std::min(_partSize, _size - offset)) {
+		return QByteArray();
+	} else if (_hash) {
+		_md5Hash.feed(result.constData(), result.size());
+	}
+	return result;
+}
+
+QByteArray Uploader::PartsReader::md5Hex() {
+	auto result = QByteArray(32, Qt::Uninitialized);
+	hashMd5Hex(_md5Hash.result(), result.data());
+	return result;
+}
+
 Uploader::File::File(const SendMediaReady &media) : media(media) {
 	partsCount = media.parts.size();
 	if (type() == SendMediaType::File
@@ -93,9 +208,18 @@ Uploader::File::File(const SendMediaReady &media) : media(media) {
 		setDocSize(media.file.isEmpty()
 			? media.data.size()
 			: media.filesize);
+		reader = std::make_shared<PartsReader>(
+			media.file,
+			media.data,
+			docSize,
+			docPartSize,
+			(docSize <= kUseBigFilesFrom));
 	} else {
 		docSize = docPartSize = docPartsCount = 0;
 	}
+	for (const auto &part : parts()) {
+		partsSize += part.size();
+	}
 }
 Uploader::File::File(const std::shared_ptr<FileLoadResult> &file)
 : file(file) {
@@ -107,9 +231,18 @@ Uploader::File::File(const std::shared_ptr<FileLoadResult> &file)
 		|| type() == SendMediaType::ThemeFile
 		|| type() == SendMediaType::Audio) {
 		setDocSize(file->filesize);
+		reader = std::make_shared<PartsReader>(
+			file->filepath,
+			file->content,
+			docSize,
+			docPartSize,
+			(docSize <= kUseBigFilesFrom));
 	} else {
 		docSize = docPartSize = docPartsCount = 0;
 	}
+	for (const auto &part : parts()) {
+		partsSize += part.size();
+	}
 }
 
 void Uploader::File::setDocSize(int64 size) {
@@ -150,10 +283,46 @@ const QString &Uploader::File::filename() const {
 	return file ? file->filename : media.filename;
 }
 
+UploadFileParts &Uploader::File::parts() {
+	return file
+		? ((type() == SendMediaType::Photo
+			|| type() == SendMediaType::Secure)
+			? file->fileparts
+			: file->thumbparts)
+		: media.parts;
+}
+
+uint64 Uploader::File::partsOfId() const {
+	return file
+		? ((type() == SendMediaType::Photo
+			|| type() == SendMediaType::Secure)
+			? file->id
+			: file->thumbId)
+		: media.thumbId;
+}
+
+bool Uploader::File::hasPartsToSend() {
+	return !parts().isEmpty() || (docSentParts < docPartsCount);
+}
+
+bool Uploader::File::hasPartReady() {
+	return !parts().isEmpty() || !docReadyParts.empty();
+}
+
+bool Uploader::File::uploaded() {
+	return !hasPartsToSend() && !requestsCount;
+}
+
+int64 Uploader::File::bytesPerSecond() const {
+	const auto duration = started ? (crl::now() - started) : 0;
+	return (duration > 0) ? (doneSize * 1000 / duration) : 0;
+}
+
 Uploader::Uploader(not_null<ApiWrap*> api)
 : _api(api)
-, _nextTimer([=] { sendNext(); })
 , _stopSessionsTimer([=] { stopSessions(); }) {
+	ranges::fill(_windows, kUploadWindowInitial);
+
 	const auto session = &_api->session();
 	photoReady(
 	) | rpl::start_with_next([=](UploadedMedia &&data) {
@@ -188,8 +357,8 @@ Uploader::Uploader(not_null<ApiWrap*> api)
 	}, _lifetime);
 
 	photoProgress(
-	) | rpl::start_with_next([=](const FullMsgId &fullId) {
-		processPhotoProgress(fullId);
+	) | rpl::start_with_next([=](const UploadProgress &data) {
+		processPhotoProgress(data.fullId);
 	}, _lifetime);
 
 	photoFailed(
@@ -198,8 +367,8 @@ Uploader::Uploader(not_null<ApiWrap*> api)
 	}, _lifetime);
 
 	documentProgress(
-	) | rpl::start_with_next([=](const FullMsgId &fullId) {
-		processDocumentProgress(fullId);
+	) | rpl::start_with_next([=](const UploadProgress &data) {
+		processDocumentProgress(data.fullId);
 	}, _lifetime);
 
 	documentFailed(
@@ -275,6 +444,10 @@ Main::Session &Uploader::session() const {
 	return _api->session();
 }
 
+FullMsgId Uploader::currentUploadId() const {
+	return queue.empty() ? FullMsgId() : queue.begin()->first;
+}
+
 void Uploader::uploadMedia(
 		const FullMsgId &msgId,
 		const SendMediaReady &media) {
@@ -356,24 +529,6 @@ void Uploader::upload(
 	sendNext();
 }
 
-void Uploader::currentFailed() {
-	auto j = queue.find(uploadingId);
-	if (j != queue.end()) {
-		const auto [msgId, file] = std::move(*j);
-		queue.erase(j);
-		notifyFailed(msgId, file);
-	}
-
-	cancelRequests();
-	dcMap.clear();
-	uploadingId = FullMsgId();
-	sentSize = 0;
-	for (int i = 0; i < MTP::kUploadSessionsCount; ++i) {
-		sentSizes[i] = 0;
-	}
-
-	sendNext();
-}
 
 void Uploader::notifyFailed(FullMsgId id, const File &file) {
 	const auto type = file.type();
@@ -390,10 +545,19 @@ void Uploader::notifyFailed(FullMsgId id, const File &file) {
 	} else if (type == SendMediaType::Secure) {
 		_secureFailed.fire_copy(id);
 	} else {
-		Unexpected("Type in Uploader::currentFailed.");
+		Unexpected("Type in Uploader::notifyFailed.");
 	}
 }
 
+void Uploader::fileFailed(const FullMsgId &fullId) {
+	cancelRequests(fullId);
+	if (const auto i = queue.find(fullId); i != end(queue)) {
+		auto node = queue.extract(i);
+		notifyFailed(node.key(), node.mapped());
+	}
+	sendNext();
+}
+
 void Uploader::stopSessions() {
 	for (int i = 0; i < MTP::kUploadSessionsCount; ++i) {
 		_api->instance().stopSession(MTP::uploadDcId(i));
@@ -401,9 +565,10 @@ void Uploader::stopSessions() {
 }
 
 void Uploader::sendNext() {
-	if (sentSize >= kMaxUploadFileParallelSize || _pausedId.msg) {
+	if (_pausedId.msg) {
 		return;
 	}
+	finishUploaded();
 
 	const auto stopping = _stopSessionsTimer.isActive();
 	if (queue.empty()) {
@@ -416,233 +581,295 @@ void Uploader::sendNext() {
 	if (stopping) {
 		_stopSessionsTimer.cancel();
 	}
-	auto i = uploadingId.msg ? queue.find(uploadingId) : queue.begin();
-	if (!uploadingId.msg) {
-		uploadingId = i->first;
-	} else if (i == queue.end()) {
-		i = queue.begin();
-		uploadingId = i->first;
+	while (sendPart()) {
 	}
-	auto &uploadingData = i->second;
-
-	auto todc = 0;
-	for (auto dc = 1; dc != MTP::kUploadSessionsCount; ++dc) {
-		if (sentSizes[dc] < sentSizes[todc]) {
-			todc = dc;
-		}
-	}
-
-	auto &parts = uploadingData.file
-		? ((uploadingData.type() == SendMediaType::Photo
-			|| uploadingData.type() == SendMediaType::Secure)
-			? uploadingData.file->fileparts
-			: uploadingData.file->thumbparts)
-		: uploadingData.media.parts;
-	const auto partsOfId = uploadingData.file
-		? ((uploadingData.type() == SendMediaType::Photo
-			|| uploadingData.type() == SendMediaType::Secure)
-			? uploadingData.file->id
-			: uploadingData.file->thumbId)
-		: uploadingData.media.thumbId;
-	if (parts.isEmpty()) {
-		if (uploadingData.docSentParts >= uploadingData.docPartsCount) {
-			if (requestsSent.empty() && docRequestsSent.empty()) {
-				const auto options = uploadingData.file
-					? uploadingData.file->to.options
-					: Api::SendOptions();
-				const auto edit = uploadingData.file &&
-					uploadingData.file->to.replaceMediaOf;
-				const auto attachedStickers = uploadingData.file
-					? uploadingData.file->attachedStickers
-					: std::vector<MTPInputDocument>();
-				if (uploadingData.type() == SendMediaType::Photo) {
-					auto photoFilename = uploadingData.filename();
-					if (!photoFilename.endsWith(u".jpg"_q, Qt::CaseInsensitive)) {
-						// Server has some extensions checking for inputMediaUploadedPhoto,
-						// so force the extension to be .jpg anyway. It doesn't matter,
-						// because the filename from inputFile is not used anywhere.
-						photoFilename += u".jpg"_q;
-					}
-					const auto md5 = uploadingData.file
-						? uploadingData.file->filemd5
-						: uploadingData.media.jpeg_md5;
-					const auto file = MTP_inputFile(
-						MTP_long(uploadingData.id()),
-						MTP_int(uploadingData.partsCount),
-						MTP_string(photoFilename),
-						MTP_bytes(md5));
-					_photoReady.fire({
-						.fullId = uploadingId,
-						.info = {
-							.file = file,
-							.attachedStickers = attachedStickers,
-						},
-						.options = options,
-						.edit = edit,
-					});
-				} else if (uploadingData.type() == SendMediaType::File
-					|| uploadingData.type() == SendMediaType::ThemeFile
-					|| uploadingData.type() == SendMediaType::Audio) {
-					QByteArray docMd5(32, Qt::Uninitialized);
-					hashMd5Hex(uploadingData.md5Hash.result(), docMd5.data());
-
-					const auto file = (uploadingData.docSize > kUseBigFilesFrom)
-						? MTP_inputFileBig(
-							MTP_long(uploadingData.id()),
-							MTP_int(uploadingData.docPartsCount),
-							MTP_string(uploadingData.filename()))
-						: MTP_inputFile(
-							MTP_long(uploadingData.id()),
-							MTP_int(uploadingData.docPartsCount),
-							MTP_string(uploadingData.filename()),
-							MTP_bytes(docMd5));
-					const auto thumb = [&]() -> std::optional<MTPInputFile> {
-						if (!uploadingData.partsCount) {
-							return std::nullopt;
-						}
-						const auto thumbFilename = uploadingData.file
-							? uploadingData.file->thumbname
-							: (u"thumb."_q + uploadingData.media.thumbExt);
-						const auto thumbMd5 = uploadingData.file
-							? uploadingData.file->thumbmd5
-							: uploadingData.media.jpeg_md5;
-						return MTP_inputFile(
-							MTP_long(uploadingData.thumbId()),
-							MTP_int(uploadingData.partsCount),
-							MTP_string(thumbFilename),
-							MTP_bytes(thumbMd5));
-					}();
-					_documentReady.fire({
-						.fullId = uploadingId,
-						.info = {
-							.file = file,
-							.thumb = thumb,
-							.attachedStickers = attachedStickers,
-						},
-						.options = options,
-						.edit = edit,
-					});
-				} else if (uploadingData.type() == SendMediaType::Secure) {
-					_secureReady.fire({
-						uploadingId,
-						uploadingData.id(),
-						uploadingData.partsCount });
-				}
-				queue.erase(uploadingId);
-				uploadingId = FullMsgId();
-				sendNext();
+	readAhead();
+}
+
+FullMsgId Uploader::chooseNextFile() {
+	// Files take turns, so that a large document doesn't hold back
+	// the ones sent right after it.
+	auto first = FullMsgId();
+	auto active = 0;
+	for (auto &[fullId, file] : queue) {
+		if (!file.hasPartsToSend()) {
+			continue;
+		} else if (file.hasPartReady()) {
+			if (fullId > _lastSentId) {
+				return fullId;
+			} else if (!first) {
+				first = fullId;
 			}
-			return;
 		}
-
-		auto &content = uploadingData.file
-			? uploadingData.file->content
-			: uploadingData.media.data;
-		QByteArray toSend;
-		if (content.isEmpty()) {
-			if (!uploadingData.docFile) {
-				const auto filepath = uploadingData.file
-					? uploadingData.file->filepath
-					: uploadingData.media.file;
-				uploadingData.docFile = std::make_unique<QFile>(filepath);
-				if (!uploadingData.docFile->open(QIODevice::ReadOnly)) {
-					currentFailed();
-					return;
-				}
-			}
-			toSend = uploadingData.docFile->read(uploadingData.docPartSize);
-			if (uploadingData.docSize <= kUseBigFilesFrom) {
-				uploadingData.md5Hash.feed(toSend.constData(), toSend.size());
-			}
-		} else {
-			const auto offset = uploadingData.docSentParts
-				* uploadingData.docPartSize;
-			toSend = content.mid(offset, uploadingData.docPartSize);
-			if ((uploadingData.type() == SendMediaType::File
-				|| uploadingData.type() == SendMediaType::ThemeFile
-				|| uploadingData.type() == SendMediaType::Audio)
-				&& uploadingData.docSentParts <= kUseBigFilesFrom) {
-				uploadingData.md5Hash.feed(toSend.constData(), toSend.size());
-			}
+		if (++active == kMaxFilesInParallel) {
+			break;
 		}
-		if ((toSend.size() > uploadingData.docPartSize)
-			|| ((toSend.size() < uploadingData.docPartSize
-				&& uploadingData.docSentParts + 1 != uploadingData.docPartsCount))) {
-			currentFailed();
-			return;
+	}
+	return first;
+}
+
+int Uploader::chooseDcIndex(int64 size) const {
+	auto result = -1;
+	auto resultLeft = int64();
+	for (auto i = 0; i != MTP::kUploadSessionsCount; ++i) {
+		const auto left = _windows[i] - _sentSizes[i];
+		if (_sentSizes[i] > 0 && left < size) {
+			continue;
+		} else if (result < 0 || left > resultLeft) {
+			result = i;
+			resultLeft = left;
 		}
-		mtpRequestId requestId;
-		if (uploadingData.docSize > kUseBigFilesFrom) {
+	}
+	return result;
+}
+
+bool Uploader::sendPart() {
+	const auto fullId = chooseNextFile();
+	if (!fullId) {
+		return false;
+	}
+	auto &file = queue.find(fullId)->second;
+	auto &parts = file.parts();
+	const auto docPart = parts.isEmpty();
+	const auto size = docPart
+		? int64(file.docReadyParts.front().size())
+		: int64(parts.begin().value().size());
+	const auto dcIndex = chooseDcIndex(size);
+	if (dcIndex < 0) {
+		return false;
+	}
+
+	const auto done = [=](const MTPBool &result, mtpRequestId requestId) {
+		partLoaded(result, requestId);
+	};
+	const auto fail = [=](const MTP::Error &error, mtpRequestId requestId) {
+		partFailed(error, requestId);
+	};
+	auto requestId = mtpRequestId();
+	if (docPart) {
+		const auto bytes = std::move(file.docReadyParts.front());
+		file.docReadyParts.pop_front();
+		const auto index = file.docSentParts++;
+		if (file.docSize > kUseBigFilesFrom) {
 			requestId = _api->request(MTPupload_SaveBigFilePart(
-				MTP_long(uploadingData.id()),
-				MTP_int(uploadingData.docSentParts),
-				MTP_int(uploadingData.docPartsCount),
-				MTP_bytes(toSend)
-			)).done([=](const MTPBool &result, mtpRequestId requestId) {
-				partLoaded(result, requestId);
-			}).fail([=](const MTP::Error &error, mtpRequestId requestId) {
-				partFailed(error, requestId);
-			}).toDC(MTP::uploadDcId(todc)).send();
+				MTP_long(file.id()),
+				MTP_int(index),
+				MTP_int(file.docPartsCount),
+				MTP_bytes(bytes)
+			)).done(done).fail(fail).toDC(MTP::uploadDcId(dcIndex)).send();
 		} else {
 			requestId = _api->request(MTPupload_SaveFilePart(
-				MTP_long(uploadingData.id()),
-				MTP_int(uploadingData.docSentParts),
-				MTP_bytes(toSend)
-			)).done([=](const MTPBool &result, mtpRequestId requestId) {
-				partLoaded(result, requestId);
-			}).fail([=](const MTP::Error &error, mtpRequestId requestId) {
-				partFailed(error, requestId);
-			}).toDC(MTP::uploadDcId(todc)).send();
+				MTP_long(file.id()),
+				MTP_int(index),
+				MTP_bytes(bytes)
+			)).done(done).fail(fail).toDC(MTP::uploadDcId(dcIndex)).send();
 		}
-		docRequestsSent.emplace(requestId, uploadingData.docSentParts);
-		dcMap.emplace(requestId, todc);
-		sentSize += uploadingData.docPartSize;
-		sentSizes[todc] += uploadingData.docPartSize;
-
-		uploadingData.docSentParts++;
 	} else {
-		auto part = parts.begin();
-
-		const auto requestId = _api->request(MTPupload_SaveFilePart(
-			MTP_long(partsOfId),
+		const auto part = parts.begin();
+		requestId = _api->request(MTPupload_SaveFilePart(
+			MTP_long(file.partsOfId()),
 			MTP_int(part.key()),
 			MTP_bytes(part.value())
-		)).done([=](const MTPBool &result, mtpRequestId requestId) {
-			partLoaded(result, requestId);
-		}).fail([=](const MTP::Error &error, mtpRequestId requestId) {
-			partFailed(error, requestId);
-		}).toDC(MTP::uploadDcId(todc)).send();
-		requestsSent.emplace(requestId, part.value());
-		dcMap.emplace(requestId, todc);
-		sentSize += part.value().size();
-		sentSizes[todc] += part.value().size();
-
+		)).done(done).fail(fail).toDC(MTP::uploadDcId(dcIndex)).send();
 		parts.erase(part);
 	}
-	_nextTimer.callOnce(kUploadRequestInterval);
+	const auto now = crl::now();
+	_requests.emplace(requestId, Request{
+		.fullId = fullId,
+		.size = size,
+		.dcIndex = dcIndex,
+		.docPart = docPart,
+		.sent = now,
+	});
+	_sentSizes[dcIndex] += size;
+	_lastSentId = fullId;
+	++file.requestsCount;
+	if (!file.started) {
+		file.started = now;
+	}
+	return true;
+}
+
+void Uploader::readAhead() {
+	auto active = 0;
+	for (auto &[fullId, file] : queue) {
+		if (!file.hasPartsToSend()) {
+			continue;
+		}
+		readParts(fullId, file);
+		if (++active == kMaxFilesInParallel) {
+			break;
+		}
+	}
+}
+
+void Uploader::readParts(const FullMsgId &fullId, File &file) {
+	if (!file.reader || file.docReading) {
+		return;
+	}
+	const auto ahead = std::max(int(kReadAheadSize / file.docPartSize), 1);
+	const auto count = std::min(
+		ahead - int(file.docReadyParts.size()),
+		file.docPartsCount - file.docReadParts);
+	if (count <= 0) {
+		return;
+	}
+	const auto index = file.docReadParts;
+	file.docReadParts += count;
+	file.docReading = true;
+	crl::async([=, weak = base::make_weak(this), reader = file.reader] {
+		auto parts = reader->read(index, count);
+		crl::on_main(weak, [=, parts = std::move(parts)]() mutable {
+			partsRead(fullId, reader, std::move(parts));
+		});
+	});
+}
+
+void Uploader::partsRead(
+		const FullMsgId &fullId,
+		const std::shared_ptr<PartsReader> &reader,
+		std::vector<QByteArray> &&parts) {
+	const auto i = queue.find(fullId);
+	if (i == end(queue) || i->second.reader != reader) {
+		return;
+	}
+	auto &file = i->second;
+	file.docReading = false;
+	if (parts.empty()) {
+		fileFailed(fullId);
+		return;
+	}
+	for (auto &part : parts) {
+		file.docReadyParts.push_back(std::move(part));
+	}
+	sendNext();
+}
+
+void Uploader::finishUploaded() {
+	// Messages to the same chat are sent in the order they were queued.
+	auto ready = std::vector<FullMsgId>();
+	auto waiting = base::flat_set<PeerId>();
+	for (auto &[fullId, file] : queue) {
+		if (waiting.contains(fullId.peer)) {
+			continue;
+		} else if (!file.uploaded()) {
+			waiting.emplace(fullId.peer);
+		} else {
+			ready.push_back(fullId);
+		}
+	}
+	for (const auto &fullId : ready) {
+		if (const auto i = queue.find(fullId); i != end(queue)) {
+			auto node = queue.extract(i);
+			fileReady(node.key(), node.mapped());
+		}
+	}
+}
+
+void Uploader::fileReady(const FullMsgId &fullId, File &file) {
+	const auto options = file.file
+		? file.file->to.options
+		: Api::SendOptions();
+	const auto edit = file.file &&
+		file.file->to.replaceMediaOf;
+	const auto attachedStickers = file.file
+		? file.file->attachedStickers
+		: std::vector<MTPInputDocument>();
+	if (file.type() == SendMediaType::Photo) {
+		auto photoFilename = file.filename();
+		if (!photoFilename.endsWith(u".jpg"_q, Qt::CaseInsensitive)) {
+			// Server has some extensions checking for inputMediaUploadedPhoto,
+			// so force the extension to be .jpg anyway. It doesn't matter,
+			// because the filename from inputFile is not used anywhere.
+			photoFilename += u".jpg"_q;
+		}
+		const auto md5 = file.file
+			? file.file->filemd5
+			: file.media.jpeg_md5;
+		const auto inputFile = MTP_inputFile(
+			MTP_long(file.id()),
+			MTP_int(file.partsCount),
+			MTP_string(photoFilename),
+			MTP_bytes(md5));
+		_photoReady.fire({
+			.fullId = fullId,
+			.info = {
+				.file = inputFile,
+				.attachedStickers = attachedStickers,
+			},
+			.options = options,
+			.edit = edit,
+		});
+	} else if (file.type() == SendMediaType::File
+		|| file.type() == SendMediaType::ThemeFile
+		|| file.type() == SendMediaType::Audio) {
+		const auto docMd5 = file.reader->md5Hex();
+		const auto inputFile = (file.docSize > kUseBigFilesFrom)
+			? MTP_inputFileBig(
+				MTP_long(file.id()),
+				MTP_int(file.docPartsCount),
+				MTP_string(file.filename()))
+			: MTP_inputFile(
+				MTP_long(file.id()),
+				MTP_int(file.docPartsCount),
+				MTP_string(file.filename()),
+				MTP_bytes(docMd5));
+		const auto thumb = [&]() -> std::optional<MTPInputFile> {
+			if (!file.partsCount) {
+				return std::nullopt;
+			}
+			const auto thumbFilename = file.file
+				? file.file->thumbname
+				: (u"thumb."_q + file.media.thumbExt);
+			const auto thumbMd5 = file.file
+				? file.file->thumbmd5
+				: file.media.jpeg_md5;
+			return MTP_inputFile(
+				MTP_long(file.thumbId()),
+				MTP_int(file.partsCount),
+				MTP_string(thumbFilename),
+				MTP_bytes(thumbMd5));
+		}();
+		_documentReady.fire({
+			.fullId = fullId,
+			.info = {
+				.file = inputFile,
+				.thumb = thumb,
+				.attachedStickers = attachedStickers,
+			},
+			.options = options,
+			.edit = edit,
+		});
+	} else if (file.type() == SendMediaType::Secure) {
+		_secureReady.fire({
+			fullId,
+			file.id(),
+			file.partsCount });
+	}
 }
 
 void Uploader::cancel(const FullMsgId &msgId) {
-	if (uploadingId == msgId) {
-		currentFailed();
+	const auto i = queue.find(msgId);
+	if (i == end(queue)) {
+		return;
+	} else if (i->second.started) {
+		fileFailed(msgId);
 	} else {
-		queue.erase(msgId);
+		queue.erase(i);
+		sendNext();
 	}
 }
 
 void Uploader::cancelAll() {
-	const auto single = queue.empty() ? uploadingId : queue.begin()->first;
+	const auto single = currentUploadId();
 	if (!single) {
 		return;
 	}
 	_pausedId = single;
-	if (uploadingId) {
-		currentFailed();
-	}
+	cancelRequests();
 	while (!queue.empty()) {
-		const auto [msgId, file] = std::move(*queue.begin());
-		queue.erase(queue.begin());
-		notifyFailed(msgId, file);
+		auto node = queue.extract(queue.begin());
+		notifyFailed(node.key(), node.mapped());
 	}
 	clear();
 	unpause();
@@ -660,101 +887,128 @@ void Uploader::unpause() {
 void Uploader::confirm(const FullMsgId &msgId) {
 }
 
-void Uploader::cancelRequests() {
-	for (const auto &requestData : requestsSent) {
-		_api->request(requestData.first).cancel();
+void Uploader::cancelRequests(const FullMsgId &fullId) {
+	for (auto i = begin(_requests); i != end(_requests);) {
+		if (i->second.fullId == fullId) {
+			_api->request(i->first).cancel();
+			_sentSizes[i->second.dcIndex] -= i->second.size;
+			i = _requests.erase(i);
+		} else {
+			++i;
+		}
 	}
-	requestsSent.clear();
-	for (const auto &requestData : docRequestsSent) {
-		_api->request(requestData.first).cancel();
+}
+
+void Uploader::cancelRequests() {
+	for (const auto &[requestId, request] : base::take(_requests)) {
+		_api->request(requestId).cancel();
 	}
-	docRequestsSent.clear();
+	ranges::fill(_sentSizes, int64(0));
 }
 
 void Uploader::clear() {
 	queue.clear();
 	cancelRequests();
-	dcMap.clear();
-	sentSize = 0;
+	_lastSentId = FullMsgId();
 	for (int i = 0; i < MTP::kUploadSessionsCount; ++i) {
 		_api->instance().stopSession(MTP::uploadDcId(i));
-		sentSizes[i] = 0;
+		_windows[i] = kUploadWindowInitial;
 	}
 	_stopSessionsTimer.cancel();
 }
 
+void Uploader::adjustWindow(const Request &request) {
+	// Grow the window only if it was mostly used, otherwise
+	// fast parts don't tell us anything about the connection.
+	const auto duration = crl::now() - request.sent;
+	const auto inFlight = _sentSizes[request.dcIndex];
+	auto &window = _windows[request.dcIndex];
+	if (duration < kFastPartThreshold) {
+		if (inFlight * 2 >= window) {
+			window = std::min(window + request.size, kUploadWindowMax);
+		}
+	} else if (duration > kSlowPartThreshold) {
+		window = std::max(window / 2, kUploadWindowMin);
+	}
+}
+
 void Uploader::partLoaded(const MTPBool &result, mtpRequestId requestId) {
-	auto j = docRequestsSent.end();
-	auto i = requestsSent.find(requestId);
-	if (i == requestsSent.cend()) {
-		j = docRequestsSent.find(requestId);
-	}
-	if (i != requestsSent.cend() || j != docRequestsSent.cend()) {
-		if (mtpIsFalse(result)) { // failed to upload current file
-			currentFailed();
-			return;
-		} else {
-			auto dcIt = dcMap.find(requestId);
-			if (dcIt == dcMap.cend()) { // must not happen
-				currentFailed();
-				return;
-			}
-			auto dc = dcIt->second;
-			dcMap.erase(dcIt);
-
-			int64 sentPartSize = 0;
-			auto k = queue.find(uploadingId);
-			Assert(k != queue.cend());
-			auto &[fullId, file] = *k;
-			if (i != requestsSent.cend()) {
-				sentPartSize = i->second.size();
-				requestsSent.erase(i);
-			} else {
-				sentPartSize = file.docPartSize;
-				docRequestsSent.erase(j);
-			}
-			sentSize -= sentPartSize;
-			sentSizes[dc] -= sentPartSize;
-			if (file.type() == SendMediaType::Photo) {
-				file.fileSentSize += sentPartSize;
-				const auto photo = session().data().photo(file.id());
-				if (photo->uploading() && file.file) {
-					photo->uploadingData->size = file.file->partssize;
-					photo->uploadingData->offset = file.fileSentSize;
-				}
-				_photoProgress.fire_copy(fullId);
-			} else if (file.type() == SendMediaType::File
-				|| file.type() == SendMediaType::ThemeFile
-				|| file.type() == SendMediaType::Audio) {
-				const auto document = session().data().document(file.id());
-				if (document->uploading()) {
-					const auto doneParts = file.docSentParts
-						- int(docRequestsSent.size());
-					document->uploadingData->offset = std::min(
-						document->uploadingData->size,
-						doneParts * file.docPartSize);
-				}
-				_documentProgress.fire_copy(fullId);
-			} else if (file.type() == SendMediaType::Secure) {
-				file.fileSentSize += sentPartSize;
-				_secureProgress.fire_copy({
-					fullId,
-					file.fileSentSize,
-					file.file->partssize });
-			}
+	const auto request = _requests.take(requestId);
+	if (!request) {
+		sendNext();
+		return;
+	}
+	adjustWindow(*request);
+	_sentSizes[request->dcIndex] -= request->size;
+
+	const auto i = queue.find(request->fullId);
+	if (i == end(queue)) {
+		sendNext();
+		return;
+	} else if (mtpIsFalse(result)) { // failed to upload this file
+		fileFailed(request->fullId);
+		return;
+	}
+	auto &[fullId, file] = *i;
+	--file.requestsCount;
+	file.doneSize += request->size;
+	const auto bytesPerSecond = file.bytesPerSecond();
+	if (file.type() == SendMediaType::Photo) {
+		file.fileSentSize += request->size;
+		const auto photo = session().data().photo(file.id());
+		if (photo->uploading() && file.file) {
+			photo->uploadingData->size = file.file->partssize;
+			photo->uploadingData->offset = file.fileSentSize;
+		}
+		_photoProgress.fire({
+			.fullId = fullId,
+			.offset = file.fileSentSize,
+			.size = file.partsSize,
+			.bytesPerSecond = bytesPerSecond,
+		});
+	} else if (file.type() == SendMediaType::File
+		|| file.type() == SendMediaType::ThemeFile
+		|| file.type() == SendMediaType::Audio) {
+		if (request->docPart) {
+			++file.docDoneParts;
+		}
+		const auto offset = std::min(
+			file.docSize,
+			file.docDoneParts * file.docPartSize);
+		const auto document = session().data().document(file.id());
+		if (document->uploading()) {
+			document->uploadingData->offset = std::min(
+				document->uploadingData->size,
+				offset);
 		}
+		_documentProgress.fire({
+			.fullId = fullId,
+			.offset = offset,
+			.size = file.docSize,
+			.bytesPerSecond = bytesPerSecond,
+		});
+	} else if (file.type() == SendMediaType::Secure) {
+		file.fileSentSize += request->size;
+		_secureProgress.fire({
+			.fullId = fullId,
+			.offset = file.fileSentSize,
+			.size = file.partsSize,
+			.bytesPerSecond = bytesPerSecond,
+		});
 	}
 
 	sendNext();
 }
 
 void Uploader::partFailed(const MTP::Error &error, mtpRequestId requestId) {
-	// failed to upload current file
-	if ((requestsSent.find(requestId) != requestsSent.cend())
-		|| (docRequestsSent.find(requestId) != docRequestsSent.cend())) {
-		currentFailed();
+	if (const auto request = _requests.take(requestId)) {
+		_sentSizes[request->dcIndex] -= request->size;
+
+		// failed to upload this file
+		fileFailed(request->fullId);
+	} else {
+		sendNext();
 	}
-	sendNext();
 }
 
 } // namespace Storage
@@ -9,6 +9,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 
 #include "api/api_common.h"
 #include "base/timer.h"
+#include "base/weak_ptr.h"
 #include "mtproto/facade.h"
 
 class ApiWrap;
@@ -35,10 +36,11 @@ struct UploadedMedia {
 	bool edit = false;
 };
 
-struct UploadSecureProgress {
+struct UploadProgress {
 	FullMsgId fullId;
 	int64 offset = 0;
 	int64 size = 0;
+	int64 bytesPerSecond = 0;
 };
 
 struct UploadSecureDone {
@@ -47,16 +49,14 @@ struct UploadSecureDone {
 	int partsCount = 0;
 };
 
-class Uploader final : public QObject {
+class Uploader final : public QObject, public base::has_weak_ptr {
 public:
 	explicit Uploader(not_null<ApiWrap*> api);
 	~Uploader();
 
 	[[nodiscard]] Main::Session &session() const;
 
-	[[nodiscard]] FullMsgId currentUploadId() const {
-		return uploadingId;
-	}
+	[[nodiscard]] FullMsgId currentUploadId() const;
 
 	void uploadMedia(const FullMsgId &msgId, const SendMediaReady &image);
 	void upload(
@@ -79,13 +79,13 @@ public:
 	rpl::producer<UploadSecureDone> secureReady() const {
 		return _secureReady.events();
 	}
-	rpl::producer<FullMsgId> photoProgress() const {
+	rpl::producer<UploadProgress> photoProgress() const {
 		return _photoProgress.events();
 	}
-	rpl::producer<FullMsgId> documentProgress() const {
+	rpl::producer<UploadProgress> documentProgress() const {
 		return _documentProgress.events();
 	}
-	rpl::producer<UploadSecureProgress> secureProgress() const {
+	rpl::producer<UploadProgress> secureProgress() const {
 		return _secureProgress.events();
 	}
 	rpl::producer<FullMsgId> photoFailed() const {
@@ -104,9 +104,25 @@ public:
 
 private:
 	struct File;
+	struct Request;
+	class PartsReader;
+
+	[[nodiscard]] FullMsgId chooseNextFile();
+	[[nodiscard]] int chooseDcIndex(int64 size) const;
+	bool sendPart();
+	void readAhead();
+	void readParts(const FullMsgId &fullId, File &file);
+	void partsRead(
+		const FullMsgId &fullId,
+		const std::shared_ptr<PartsReader> &reader,
+		std::vector<QByteArray> &&parts);
+	void finishUploaded();
+	void fileReady(const FullMsgId &fullId, File &file);
+	void fileFailed(const FullMsgId &fullId);
 
 	void partLoaded(const MTPBool &result, mtpRequestId requestId);
 	void partFailed(const MTP::Error &error, mtpRequestId requestId);
+	void adjustWindow(const Request &request);
 
 	void processPhotoProgress(const FullMsgId &msgId);
 	void processPhotoFailed(const FullMsgId &msgId);
@@ -114,7 +130,7 @@ private:
 	void processDocumentFailed(const FullMsgId &msgId);
 
 	void notifyFailed(FullMsgId id, const File &file);
-	void currentFailed();
+	void cancelRequests(const FullMsgId &fullId);
 	void cancelRequests();
 
 	void sendProgressUpdate(
@@ -123,23 +139,21 @@ private:
 		int progress = 0);
 
 	const not_null<ApiWrap*> _api;
-	base::flat_map<mtpRequestId, QByteArray> requestsSent;
-	base::flat_map<mtpRequestId, int32> docRequestsSent;
-	base::flat_map<mtpRequestId, int32> dcMap;
-	uint32 sentSize = 0; // FileSize: Right now any file size fits 32 bit.
-	uint32 sentSizes[MTP::kUploadSessionsCount] = { 0 };
+	base::flat_map<mtpRequestId, Request> _requests;
+	int64 _sentSizes[MTP::kUploadSessionsCount] = { 0 };
+	int64 _windows[MTP::kUploadSessionsCount] = { 0 };
 
-	FullMsgId uploadingId;
+	FullMsgId _lastSentId;
 	FullMsgId _pausedId;
 	std::map<FullMsgId, File> queue;
-	base::Timer _nextTimer, _stopSessionsTimer;
+	base::Timer _stopSessionsTimer;
 
 	rpl::event_stream<UploadedMedia> _photoReady;
 	rpl::event_stream<UploadedMedia> _documentReady;
 	rpl::event_stream<UploadSecureDone> _secureReady;
-	rpl::event_stream<FullMsgId> _photoProgress;
-	rpl::event_stream<FullMsgId> _documentProgress;
-	rpl::event_stream<UploadSecureProgress> _secureProgress;
+	rpl::event_stream<UploadProgress> _photoProgress;
+	rpl::event_stream<UploadProgress> _documentProgress;
+	rpl::event_stream<UploadProgress> _secureProgress;
 	rpl::event_stream<FullMsgId> _photoFailed;
 	rpl::event_stream<FullMsgId> _documentFailed;
 	rpl::event_stream<FullMsgId> _secureFailed;
@@ -48,6 +48,7 @@ constexpr auto kThumbnailQuality = 87;
 constexpr auto kThumbnailSize = 320;
 constexpr auto kPhotoUploadPartSize = 32 * 1024;
 constexpr auto kRecompressAfterBpp = 4;
+constexpr auto kMaxTaskThreads = 4;
 
 using Ui::ValidateThumbDimensions;
 
@@ -258,7 +259,10 @@ SendMediaReady::SendMediaReady(
 	}
 }
 
-TaskQueue::TaskQueue(crl::time stopTimeoutMs) {
+TaskQueue::TaskQueue(crl::time stopTimeoutMs, int threadsLimit)
+: _threadsLimit((threadsLimit > 0)
+	? threadsLimit
+	: std::clamp(QThread::idealThreadCount() - 1, 1, kMaxTaskThreads)) {
 	if (stopTimeoutMs > 0) {
 		_stopTimer = new QTimer(this);
 		connect(_stopTimer, SIGNAL(timeout()), this, SLOT(stop()));
@@ -270,95 +274,152 @@ TaskQueue::TaskQueue(crl::time stopTimeoutMs) {
 TaskId TaskQueue::addTask(std::unique_ptr<Task> &&task) {
 	const auto result = task->id();
 	{
-		QMutexLocker lock(&_tasksToProcessMutex);
+		QMutexLocker lock(&_tasksMutex);
+		_tasksToFinish.push_back({ .id = result });
 		_tasksToProcess.push_back(std::move(task));
 	}
 
-	wakeThread();
+	wakeThreads();
 
 	return result;
 }
 
 void TaskQueue::addTasks(std::vector<std::unique_ptr<Task>> &&tasks) {
 	{
-		QMutexLocker lock(&_tasksToProcessMutex);
+		QMutexLocker lock(&_tasksMutex);
 		for (auto &task : tasks) {
+			_tasksToFinish.push_back({ .id = task->id() });
 			_tasksToProcess.push_back(std::move(task));
 		}
 	}
 
-	wakeThread();
+	wakeThreads();
 }
 
-void TaskQueue::wakeThread() {
-	if (!_thread) {
-		_thread = new QThread();
+void TaskQueue::wakeThreads() {
+	const auto required = [&] {
+		QMutexLocker lock(&_tasksMutex);
+		return int(_tasksToProcess.size()) + _tasksInProcess;
+	}();
+	const auto threads = std::min(required, _threadsLimit);
+	while (int(_threads.size()) < threads) {
+		startThread();
+	}
+	if (_stopTimer) _stopTimer->stop();
+	taskAdded();
+}
 
-		_worker = new TaskQueueWorker(this);
-		_worker->moveToThread(_thread);
+void TaskQueue::startThread() {
+	const auto thread = _threads.emplace_back(new QThread());
+	const auto worker = _workers.emplace_back(new TaskQueueWorker(this));
+	worker->moveToThread(thread);
 
-		connect(this, SIGNAL(taskAdded()), _worker, SLOT(onTaskAdded()));
-		connect(_worker, SIGNAL(taskProcessed()), this, SLOT(onTaskProcessed()));
+	connect(this, SIGNAL(taskAdded()), worker, SLOT(onTaskAdded()));
+	connect(worker, SIGNAL(taskProcessed()), this, SLOT(onTaskProcessed()));
 
-		_thread->start();
+	thread->start();
+}
+
+std::unique_ptr<Task> TaskQueue::takeTaskToProcess() {
+	QMutexLocker lock(&_tasksMutex);
+	if (_tasksToProcess.empty()) {
+		return nullptr;
 	}
-	if (_stopTimer) _stopTimer->stop();
-	taskAdded();
+	auto result = std::move(_tasksToProcess.front());
+	_tasksToProcess.pop_front();
+	++_tasksInProcess;
+	return result;
+}
+
+bool TaskQueue::taskProcessed(std::unique_ptr<Task> task) {
+	QMutexLocker lock(&_tasksMutex);
+	--_tasksInProcess;
+	const auto i = ranges::find(_tasksToFinish, task->id(), &Finishing::id);
+	if (i == end(_tasksToFinish)) {
+		return false; // Was cancelled while processing.
+	}
+	i->task = std::move(task);
+
+	// Tasks after the first one wait until it is finished.
+	return (i == begin(_tasksToFinish));
 }
 
 void TaskQueue::cancelTask(TaskId id) {
-	const auto removeFrom = [&](std::deque<std::unique_ptr<Task>> &queue) {
+	auto removed = std::unique_ptr<Task>();
+	auto finishNext = false;
+	{
+		QMutexLocker lock(&_tasksMutex);
 		const auto proj = [](const std::unique_ptr<Task> &task) {
 			return task->id();
 		};
-		auto i = ranges::find(queue, id, proj);
-		if (i != queue.end()) {
-			queue.erase(i);
+		const auto i = ranges::find(_tasksToProcess, id, proj);
+		if (i != end(_tasksToProcess)) {
+			removed = std::move(*i);
+			_tasksToProcess.erase(i);
 		}
-	};
-	{
-		QMutexLocker lock(&_tasksToProcessMutex);
-		removeFrom(_tasksToProcess);
-		if (_taskInProcessId == id) {
-			_taskInProcessId = TaskId();
+		const auto j = ranges::find(_tasksToFinish, id, &Finishing::id);
+		if (j != end(_tasksToFinish)) {
+			if (j->task) {
+				removed = std::move(j->task);
+			}
+			const auto first = (j == begin(_tasksToFinish));
+			_tasksToFinish.erase(j);
+			finishNext = first
+				&& !_tasksToFinish.empty()
+				&& _tasksToFinish.front().task;
 		}
 	}
-	QMutexLocker lock(&_tasksToFinishMutex);
-	removeFrom(_tasksToFinish);
+	if (finishNext) {
+		// The next tasks were processed, but waited for the cancelled one.
+		QMetaObject::invokeMethod(
+			this,
+			[=] { onTaskProcessed(); },
+			Qt::QueuedConnection);
+	}
 }
 
 void TaskQueue::onTaskProcessed() {
 	do {
 		auto task = std::unique_ptr<Task>();
 		{
-			QMutexLocker lock(&_tasksToFinishMutex);
-			if (_tasksToFinish.empty()) break;
-			task = std::move(_tasksToFinish.front());
+			QMutexLocker lock(&_tasksMutex);
+			if (_tasksToFinish.empty() || !_tasksToFinish.front().task) {
+				break;
+			}
+			task = std::move(_tasksToFinish.front().task);
 			_tasksToFinish.pop_front();
 		}
 		task->finish();
 	} while (true);
 
 	if (_stopTimer) {
-		QMutexLocker lock(&_tasksToProcessMutex);
-		if (_tasksToProcess.empty() && !_taskInProcessId) {
+		QMutexLocker lock(&_tasksMutex);
+		if (_tasksToProcess.empty() && !_tasksInProcess) {
 			_stopTimer->start();
 		}
 	}
 }
 
 void TaskQueue::stop() {
-	if (_thread) {
-		_thread->requestInterruption();
-		_thread->quit();
-		DEBUG_LOG(("Waiting for taskThread to finish"));
-		_thread->wait();
-		delete base::take(_worker);
-		delete base::take(_thread);
+	for (const auto thread : _threads) {
+		thread->requestInterruption();
+		thread->quit();
+	}
+	if (!_threads.empty()) {
+		DEBUG_LOG(("Waiting for taskThreads to finish"));
+	}
+	for (const auto thread : _threads) {
+		thread->wait();
+	}
+	for (const auto worker : base::take(_workers)) {
+		delete worker;
+	}
+	for (const auto thread : base::take(_threads)) {
+		delete thread;
 	}
 	_tasksToProcess.clear();
 	_tasksToFinish.clear();
-	_taskInProcessId = TaskId();
+	_tasksInProcess = 0;
 }
 
 TaskQueue::~TaskQueue() {
@@ -370,38 +431,17 @@ void TaskQueueWorker::onTaskAdded() {
 	if (_inTaskAdded) return;
 	_inTaskAdded = true;
 
-	bool someTasksLeft = false;
-	do {
-		auto task = std::unique_ptr<Task>();
-		{
-			QMutexLocker lock(&_queue->_tasksToProcessMutex);
-			if (!_queue->_tasksToProcess.empty()) {
-				task = std::move(_queue->_tasksToProcess.front());
-				_queue->_tasksToProcess.pop_front();
-				_queue->_taskInProcessId = task->id();
-			}
+	while (!thread()->isInterruptionRequested()) {
+		auto task = _queue->takeTaskToProcess();
+		if (!task) {
+			break;
 		}
-
-		if (task) {
-			task->process();
-			bool emitTaskProcessed = false;
-			{
-				QMutexLocker lockToProcess(&_queue->_tasksToProcessMutex);
-				if (_queue->_taskInProcessId == task->id()) {
-					_queue->_taskInProcessId = TaskId();
-					someTasksLeft = !_queue->_tasksToProcess.empty();
-
-					QMutexLocker lockToFinish(&_queue->_tasksToFinishMutex);
-					emitTaskProcessed = _queue->_tasksToFinish.empty();
-					_queue->_tasksToFinish.push_back(std::move(task));
-				}
-			}
-			if (emitTaskProcessed) {
-				taskProcessed();
-			}
+		task->process();
+		if (_queue->taskProcessed(std::move(task))) {
+			taskProcessed();
 		}
 		QCoreApplication::processEvents();
-	} while (someTasksLeft && !thread()->isInterruptionRequested());
+	}
 
 	_inTaskAdded = false;
 }
@@ -91,7 +91,11 @@ class TaskQueue : public QObject {
 	Q_OBJECT
 
 public:
-	explicit TaskQueue(crl::time stopTimeoutMs = 0); // <= 0 - never stop worker
+	// Tasks are processed in parallel by up to threadsLimit workers,
+	// but finish() is always called in the order the tasks were added.
+	explicit TaskQueue(
+		crl::time stopTimeoutMs = 0, // <= 0 - never stop workers
+		int threadsLimit = 0); // <= 0 - choose by the cores count
 
 	TaskId addTask(std::unique_ptr<Task> &&task);
 	void addTasks(std::vector<std::unique_ptr<Task>> &&tasks);
@@ -109,14 +113,23 @@ public Q_SLOTS:
 private:
 	friend class TaskQueueWorker;
 
-	void wakeThread();
+	struct Finishing {
+		TaskId id = TaskId();
+		std::unique_ptr<Task> task; // Set when processed.
+	};
+
+	void wakeThreads();
+	void startThread();
+	[[nodiscard]] std::unique_ptr<Task> takeTaskToProcess();
+	[[nodiscard]] bool taskProcessed(std::unique_ptr<Task> task);
 
 	std::deque<std::unique_ptr<Task>> _tasksToProcess;
-	std::deque<std::unique_ptr<Task>> _tasksToFinish;
-	TaskId _taskInProcessId = TaskId();
-	QMutex _tasksToProcessMutex, _tasksToFinishMutex;
-	QThread *_thread = nullptr;
-	TaskQueueWorker *_worker = nullptr;
+	std::deque<Finishing> _tasksToFinish;
+	int _tasksInProcess = 0;
+	QMutex _tasksMutex;
+	const int _threadsLimit = 1;
+	std::vector<QThread*> _threads;
+	std::vector<TaskQueueWorker*> _workers;
 	QTimer *_stopTimer = nullptr;
 
 };
@@ -125,6 +125,206 @@ auto EmptyMessageDraftSources()
 
 } // namespace
 
+namespace details {
+
+struct MapData {
+	QByteArray selfSerialized;
+	base::flat_map<PeerId, FileKey> draftsMap;
+	base::flat_map<PeerId, FileKey> draftCursorsMap;
+	base::flat_map<PeerId, bool> draftsNotReadMap;
+	quint64 locationsKey = 0;
+	quint64 reportSpamStatusesKey = 0;
+	quint64 trustedBotsKey = 0;
+	quint64 recentStickersKeyOld = 0;
+	quint64 installedStickersKey = 0;
+	quint64 featuredStickersKey = 0;
+	quint64 recentStickersKey = 0;
+	quint64 favedStickersKey = 0;
+	quint64 archivedStickersKey = 0;
+	quint64 installedMasksKey = 0;
+	quint64 recentMasksKey = 0;
+	quint64 archivedMasksKey = 0;
+	quint64 installedCustomEmojiKey = 0;
+	quint64 featuredCustomEmojiKey = 0;
+	quint64 archivedCustomEmojiKey = 0;
+	quint64 savedGifsKey = 0;
+	quint64 legacyBackgroundKeyDay = 0;
+	quint64 legacyBackgroundKeyNight = 0;
+	quint64 legacyBackgroundKeyOldOld = 0;
+	quint64 userSettingsKey = 0;
+	quint64 recentHashtagsAndBotsKey = 0;
+	quint64 exportSettingsKey = 0;
+};
+
+} // namespace details
+
+namespace {
+
+[[nodiscard]] std::optional<MapData> ReadMapData(QDataStream &stream) {
+	auto result = MapData();
+	while (!stream.atEnd()) {
+		quint32 keyType;
+		stream >> keyType;
+		switch (keyType) {
+		case lskDraft: {
+			quint32 count = 0;
+			stream >> count;
+			for (quint32 i = 0; i < count; ++i) {
+				FileKey key;
+				quint64 peerIdSerialized;
+				stream >> key >> peerIdSerialized;
+				const auto peerId = DeserializePeerId(peerIdSerialized);
+				result.draftsMap.emplace(peerId, key);
+				result.draftsNotReadMap.emplace(peerId, true);
+			}
+		} break;
+		case lskSelfSerialized: {
+			stream >> result.selfSerialized;
+		} break;
+		case lskDraftPosition: {
+			quint32 count = 0;
+			stream >> count;
+			for (quint32 i = 0; i < count; ++i) {
+				FileKey key;
+				quint64 peerIdSerialized;
+				stream >> key >> peerIdSerialized;
+				const auto peerId = DeserializePeerId(peerIdSerialized);
+				result.draftCursorsMap.emplace(peerId, key);
+			}
+		} break;
+		case lskLegacyImages:
+		case lskLegacyStickerImages:
+		case lskLegacyAudios: {
+			quint32 count = 0;
+			stream >> count;
+			for (quint32 i = 0; i < count; ++i) {
+				FileKey key;
+				quint64 first, second;
+				qint32 size;
+				stream >> key >> first >> second >> size;
+				// Just ignore the key, it will be removed as a leaked one.
+			}
+		} break;
+		case lskLocations: {
+			stream >> result.locationsKey;
+		} break;
+		case lskReportSpamStatusesOld: {
+			stream >> result.reportSpamStatusesKey;
+		} break;
+		case lskTrustedBots: {
+			stream >> result.trustedBotsKey;
+		} break;
+		case lskRecentStickersOld: {
+			stream >> result.recentStickersKeyOld;
+		} break;
+		case lskBackgroundOldOld: {
+			// Night mode is applied on the main thread, see readMapWith().
+			stream >> result.legacyBackgroundKeyOldOld;
+		} break;
+		case lskBackgroundOld: {
+			stream >> result.legacyBackgroundKeyDay >> result.legacyBackgroundKeyNight;
+		} break;
+		case lskUserSettings: {
+			stream >> result.userSettingsKey;
+		} break;
+		case lskRecentHashtagsAndBots: {
+			stream >> result.recentHashtagsAndBotsKey;
+		} break;
+		case lskStickersOld: {
+			stream >> result.installedStickersKey;
+		} break;
+		case lskStickersKeys: {
+			stream >> result.installedStickersKey >> result.featuredStickersKey >> result.recentStickersKey >> result.archivedStickersKey;
+		} break;
+		case lskFavedStickers: {
+			stream >> result.favedStickersKey;
+		} break;
+		case lskSavedGifsOld: {
+			quint64 key;
+			stream >> key;
+		} break;
+		case lskSavedGifs: {
+			stream >> result.savedGifsKey;
+		} break;
+		case lskSavedPeersOld: {
+			quint64 key;
+			stream >> key;
+		} break;
+		case lskExportSettings: {
+			stream >> result.exportSettingsKey;
+		} break;
+		case lskMasksKeys: {
+			stream
+				>> result.installedMasksKey
+				>> result.recentMasksKey
+				>> result.archivedMasksKey;
+		} break;
+		case lskCustomEmojiKeys: {
+			stream
+				>> result.installedCustomEmojiKey
+				>> result.featuredCustomEmojiKey
+				>> result.archivedCustomEmojiKey;
+		} break;
+		default:
+			LOG(("App Error: unknown key type in encrypted map: %1").arg(keyType));
+			return std::nullopt;
+		}
+		if (!CheckStreamStatus(stream)) {
+			return std::nullopt;
+		}
+	}
+	return result;
+}
+
+[[nodiscard]] PreloadedFile Preloaded(const FileReadDescriptor &file) {
+	return {
+		.version = file.version,
+		.data = file.data,
+		.position = file.buffer.pos(),
+	};
+}
+
+// Called in a background thread, so it doesn't touch the Account.
+[[nodiscard]] PreloadedFiles PreloadStartFiles(
+		const QString &basePath,
+		const QString &globalPath,
+		const QString &mtpDataName,
+		const MTP::AuthKeyPtr &localKey) {
+	auto result = PreloadedFiles();
+	const auto preload = [&](const QString &name, const QString &path) {
+		auto file = FileReadDescriptor();
+		if (ReadEncryptedFile(file, name, path, localKey)) {
+			result.files.emplace(path + name, Preloaded(file));
+		}
+	};
+
+	// The decrypted map is passed as is, so it isn't read again.
+	auto mapData = FileReadDescriptor();
+	if (ReadFile(mapData, u"map"_q, basePath)) {
+		QByteArray legacySalt, legacyKeyEncrypted, mapEncrypted;
+		mapData.stream >> legacySalt >> legacyKeyEncrypted >> mapEncrypted;
+		auto map = EncryptedDescriptor();
+		if (mapData.stream.status() == QDataStream::Ok
+			&& DecryptLocal(map, mapEncrypted, localKey)) {
+			if (auto keys = ReadMapData(map.stream)) {
+				if (keys->locationsKey) {
+					preload(ToFilePart(keys->locationsKey), basePath);
+				}
+				if (keys->userSettingsKey) {
+					preload(ToFilePart(keys->userSettingsKey), basePath);
+				}
+				result.map = std::make_shared<MapData>(std::move(*keys));
+				result.mapVersion = mapData.version;
+			}
+		}
+	}
+	preload(mtpDataName, globalPath);
+	preload(u"config"_q, basePath);
+	return result;
+}
+
+} // namespace
+
 Account::Account(not_null<Main::Account*> owner, const QString &dataName)
 : _owner(owner)
 , _dataName(dataName)
@@ -167,7 +367,9 @@ std::unique_ptr<MTP::Config> Account::start(MTP::AuthKeyPtr localKey) {
 	_localKey = std::move(localKey);
 	readMapWith(_localKey);
 	clearLegacyFiles();
-	return readMtpConfig();
+	auto result = readMtpConfig();
+	_preloaded = PreloadedFiles();
+	return result;
 }
 
 void Account::startAdded(MTP::AuthKeyPtr localKey) {
@@ -177,6 +379,60 @@ void Account::startAdded(MTP::AuthKeyPtr localKey) {
 	clearLegacyFiles();
 }
 
+auto Account::preloader(MTP::AuthKeyPtr localKey) const
+-> FnMut<PreloadedFiles()> {
+	Expects(localKey != nullptr);
+
+	return [
+		basePath = _basePath,
+		globalPath = BaseGlobalPath(),
+		mtpDataName = ToFilePart(_dataNameKey),
+		localKey = std::move(localKey)
+	] {
+		return PreloadStartFiles(basePath, globalPath, mtpDataName, localKey);
+	};
+}
+
+void Account::setPreloaded(PreloadedFiles &&files) {
+	_preloaded = std::move(files);
+}
+
+bool Account::readFile(
+		FileReadDescriptor &result,
+		const QString &name,
+		const QString &basePath) {
+	return takePreloaded(result, basePath + name)
+		|| ReadFile(result, name, basePath);
+}
+
+bool Account::readEncryptedFile(
+		FileReadDescriptor &result,
+		const QString &name,
+		const QString &basePath) {
+	return takePreloaded(result, basePath + name)
+		|| ReadEncryptedFile(result, name, basePath, _localKey);
+}
+
+bool Account::takePreloaded(
+		FileReadDescriptor &result,
+		const QString &path) {
+	const auto i = _preloaded.files.find(path);
+	if (i == end(_preloaded.files)) {
+		return false;
+	}
+	const auto file = std::move(i->second);
+	_preloaded.files.erase(i);
+
+	result.version = file.version;
+	result.data = file.data;
+	result.buffer.setBuffer(&result.data);
+	result.buffer.open(QIODevice::ReadOnly);
+	result.buffer.seek(file.position);
+	result.stream.setDevice(&result.buffer);
+	result.stream.setVersion(QDataStream::Qt_5_1);
+	return true;
+}
+
 void Account::clearLegacyFiles() {
 	const auto weak = base::make_weak(_owner);
 	ClearLegacyFiles(_basePath, [weak, this](
@@ -244,197 +500,97 @@ Account::ReadMapResult Account::readMapWith(
 		const QByteArray &legacyPasscode) {
 	auto ms = crl::now();
 
-	FileReadDescriptor mapData;
-	if (!ReadFile(mapData, u"map"_q, _basePath)) {
-		return ReadMapResult::Failed;
-	}
-	LOG(("App Info: reading map..."));
-
-	QByteArray legacySalt, legacyKeyEncrypted, mapEncrypted;
-	mapData.stream >> legacySalt >> legacyKeyEncrypted >> mapEncrypted;
-	if (!CheckStreamStatus(mapData.stream)) {
-		return ReadMapResult::Failed;
-	}
-	if (!localKey) {
-		if (legacySalt.size() != LocalEncryptSaltSize) {
-			LOG(("App Error: bad salt in map file, size: %1").arg(legacySalt.size()));
+	auto parsed = std::optional<MapData>();
+	auto version = int32();
+	const auto preloaded = base::take(_preloaded.map);
+	if (preloaded && localKey) {
+		LOG(("App Info: using preloaded map..."));
+		parsed = std::move(*preloaded);
+		version = _preloaded.mapVersion;
+	} else {
+		FileReadDescriptor mapData;
+		if (!readFile(mapData, u"map"_q, _basePath)) {
 			return ReadMapResult::Failed;
 		}
-		auto legacyPasscodeKey = CreateLegacyLocalKey(legacyPasscode, legacySalt);
+		LOG(("App Info: reading map..."));
 
-		EncryptedDescriptor keyData;
-		if (!DecryptLocal(keyData, legacyKeyEncrypted, legacyPasscodeKey)) {
-			LOG(("App Info: could not decrypt pass-protected key from map file, maybe bad password..."));
-			return ReadMapResult::IncorrectPasscode;
-		}
-		auto key = Serialize::read<MTP::AuthKey::Data>(keyData.stream);
-		if (keyData.stream.status() != QDataStream::Ok || !keyData.stream.atEnd()) {
-			LOG(("App Error: could not read pass-protected key from map file"));
+		QByteArray legacySalt, legacyKeyEncrypted, mapEncrypted;
+		mapData.stream >> legacySalt >> legacyKeyEncrypted >> mapEncrypted;
+		if (!CheckStreamStatus(mapData.stream)) {
 			return ReadMapResult::Failed;
 		}
-		localKey = std::make_shared<MTP::AuthKey>(key);
-	}
-
-	EncryptedDescriptor map;
-	if (!DecryptLocal(map, mapEncrypted, localKey)) {
-		LOG(("App Error: could not decrypt map."));
-		return ReadMapResult::Failed;
-	}
-	LOG(("App Info: reading encrypted map..."));
+		if (!localKey) {
+			if (legacySalt.size() != LocalEncryptSaltSize) {
+				LOG(("App Error: bad salt in map file, size: %1").arg(legacySalt.size()));
+				return ReadMapResult::Failed;
+			}
+			auto legacyPasscodeKey = CreateLegacyLocalKey(legacyPasscode, legacySalt);
 
-	QByteArray selfSerialized;
-	base::flat_map<PeerId, FileKey> draftsMap;
-	base::flat_map<PeerId, FileKey> draftCursorsMap;
-	base::flat_map<PeerId, bool> draftsNotReadMap;
-	quint64 locationsKey = 0, reportSpamStatusesKey = 0, trustedBotsKey = 0;
-	quint64 recentStickersKeyOld = 0;
-	quint64 installedStickersKey = 0, featuredStickersKey = 0, recentStickersKey = 0, favedStickersKey = 0, archivedStickersKey = 0;
-	quint64 installedMasksKey = 0, recentMasksKey = 0, archivedMasksKey = 0;
-	quint64 installedCustomEmojiKey = 0, featuredCustomEmojiKey = 0, archivedCustomEmojiKey = 0;
-	quint64 savedGifsKey = 0;
-	quint64 legacyBackgroundKeyDay = 0, legacyBackgroundKeyNight = 0;
-	quint64 userSettingsKey = 0, recentHashtagsAndBotsKey = 0, exportSettingsKey = 0;
-	while (!map.stream.atEnd()) {
-		quint32 keyType;
-		map.stream >> keyType;
-		switch (keyType) {
-		case lskDraft: {
-			quint32 count = 0;
-			map.stream >> count;
-			for (quint32 i = 0; i < count; ++i) {
-				FileKey key;
-				quint64 peerIdSerialized;
-				map.stream >> key >> peerIdSerialized;
-				const auto peerId = DeserializePeerId(peerIdSerialized);
-				draftsMap.emplace(peerId, key);
-				draftsNotReadMap.emplace(peerId, true);
+			EncryptedDescriptor keyData;
+			if (!DecryptLocal(keyData, legacyKeyEncrypted, legacyPasscodeKey)) {
+				LOG(("App Info: could not decrypt pass-protected key from map file, maybe bad password..."));
+				return ReadMapResult::IncorrectPasscode;
 			}
-		} break;
-		case lskSelfSerialized: {
-			map.stream >> selfSerialized;
-		} break;
-		case lskDraftPosition: {
-			quint32 count = 0;
-			map.stream >> count;
-			for (quint32 i = 0; i < count; ++i) {
-				FileKey key;
-				quint64 peerIdSerialized;
-				map.stream >> key >> peerIdSerialized;
-				const auto peerId = DeserializePeerId(peerIdSerialized);
-				draftCursorsMap.emplace(peerId, key);
+			auto key = Serialize::read<MTP::AuthKey::Data>(keyData.stream);
+			if (keyData.stream.status() != QDataStream::Ok || !keyData.stream.atEnd()) {
+				LOG(("App Error: could not read pass-protected key from map file"));
+				return ReadMapResult::Failed;
 			}
-		} break;
-		case lskLegacyImages:
-		case lskLegacyStickerImages:
-		case lskLegacyAudios: {
-			quint32 count = 0;
-			map.stream >> count;
-			for (quint32 i = 0; i < count; ++i) {
-				FileKey key;
-				quint64 first, second;
-				qint32 size;
-				map.stream >> key >> first >> second >> size;
-				// Just ignore the key, it will be removed as a leaked one.
-			}
-		} break;
-		case lskLocations: {
-			map.stream >> locationsKey;
-		} break;
-		case lskReportSpamStatusesOld: {
-			map.stream >> reportSpamStatusesKey;
-			ClearKey(reportSpamStatusesKey, _basePath);
-		} break;
-		case lskTrustedBots: {
-			map.stream >> trustedBotsKey;
-		} break;
-		case lskRecentStickersOld: {
-			map.stream >> recentStickersKeyOld;
-		} break;
-		case lskBackgroundOldOld: {
-			map.stream >> (Window::Theme::IsNightMode()
-				? legacyBackgroundKeyNight
-				: legacyBackgroundKeyDay);
-		} break;
-		case lskBackgroundOld: {
-			map.stream >> legacyBackgroundKeyDay >> legacyBackgroundKeyNight;
-		} break;
-		case lskUserSettings: {
-			map.stream >> userSettingsKey;
-		} break;
-		case lskRecentHashtagsAndBots: {
-			map.stream >> recentHashtagsAndBotsKey;
-		} break;
-		case lskStickersOld: {
-			map.stream >> installedStickersKey;
-		} break;
-		case lskStickersKeys: {
-			map.stream >> installedStickersKey >> featuredStickersKey >> recentStickersKey >> archivedStickersKey;
-		} break;
-		case lskFavedStickers: {
-			map.stream >> favedStickersKey;
-		} break;
-		case lskSavedGifsOld: {
-			quint64 key;
-			map.stream >> key;
-		} break;
-		case lskSavedGifs: {
-			map.stream >> savedGifsKey;
-		} break;
-		case lskSavedPeersOld: {
-			quint64 key;
-			map.stream >> key;
-		} break;
-		case lskExportSettings: {
-			map.stream >> exportSettingsKey;
-		} break;
-		case lskMasksKeys: {
-			map.stream
-				>> installedMasksKey
-				>> recentMasksKey
-				>> archivedMasksKey;
-		} break;
-		case lskCustomEmojiKeys: {
-			map.stream
-				>> installedCustomEmojiKey
-				>> featuredCustomEmojiKey
-				>> archivedCustomEmojiKey;
-		} break;
-		default:
-			LOG(("App Error: unknown key type in encrypted map: %1").arg(keyType));
-			return ReadMapResult::Failed;
+			localKey = std::make_shared<MTP::AuthKey>(key);
 		}
-		if (!CheckStreamStatus(map.stream)) {
+
+		EncryptedDescriptor map;
+		if (!DecryptLocal(map, mapEncrypted, localKey)) {
+			LOG(("App Error: could not decrypt map."));
 			return ReadMapResult::Failed;
 		}
+		LOG(("App Info: reading encrypted map..."));
+
+		parsed = ReadMapData(map.stream);
+		version = mapData.version;
+	}
+	if (!parsed) {
+		return ReadMapResult::Failed;
+	}
+	if (const auto key = parsed->legacyBackgroundKeyOldOld) {
+		auto &legacy = Window::Theme::IsNightMode()
+			? parsed->legacyBackgroundKeyNight
+			: parsed->legacyBackgroundKeyDay;
+		if (!legacy) {
+			legacy = key;
+		}
+	}
+	if (parsed->reportSpamStatusesKey) {
+		ClearKey(parsed->reportSpamStatusesKey, _basePath);
 	}
 
 	_localKey = std::move(localKey);
 
-	_draftsMap = draftsMap;
-	_draftCursorsMap = draftCursorsMap;
-	_draftsNotReadMap = draftsNotReadMap;
-
-	_locationsKey = locationsKey;
-	_trustedBotsKey = trustedBotsKey;
-	_recentStickersKeyOld = recentStickersKeyOld;
-	_installedStickersKey = installedStickersKey;
-	_featuredStickersKey = featuredStickersKey;
-	_recentStickersKey = recentStickersKey;
-	_favedStickersKey = favedStickersKey;
-	_archivedStickersKey = archivedStickersKey;
-	_savedGifsKey = savedGifsKey;
-	_installedMasksKey = installedMasksKey;
-	_recentMasksKey = recentMasksKey;
-	_archivedMasksKey = archivedMasksKey;
-	_installedCustomEmojiKey = installedCustomEmojiKey;
-	_featuredCustomEmojiKey = featuredCustomEmojiKey;
-	_archivedCustomEmojiKey = archivedCustomEmojiKey;
-	_legacyBackgroundKeyDay = legacyBackgroundKeyDay;
-	_legacyBackgroundKeyNight = legacyBackgroundKeyNight;
-	_settingsKey = userSettingsKey;
-	_recentHashtagsAndBotsKey = recentHashtagsAndBotsKey;
-	_exportSettingsKey = exportSettingsKey;
-	_oldMapVersion = mapData.version;
+	_draftsMap = std::move(parsed->draftsMap);
+	_draftCursorsMap = std::move(parsed->draftCursorsMap);
+	_draftsNotReadMap = std::move(parsed->draftsNotReadMap);
+
+	_locationsKey = parsed->locationsKey;
+	_trustedBotsKey = parsed->trustedBotsKey;
+	_recentStickersKeyOld = parsed->recentStickersKeyOld;
+	_installedStickersKey = parsed->installedStickersKey;
+	_featuredStickersKey = parsed->featuredStickersKey;
+	_recentStickersKey = parsed->recentStickersKey;
+	_favedStickersKey = parsed->favedStickersKey;
+	_archivedStickersKey = parsed->archivedStickersKey;
+	_savedGifsKey = parsed->savedGifsKey;
+	_installedMasksKey = parsed->installedMasksKey;
+	_recentMasksKey = parsed->recentMasksKey;
+	_archivedMasksKey = parsed->archivedMasksKey;
+	_installedCustomEmojiKey = parsed->installedCustomEmojiKey;
+	_featuredCustomEmojiKey = parsed->featuredCustomEmojiKey;
+	_archivedCustomEmojiKey = parsed->archivedCustomEmojiKey;
+	_legacyBackgroundKeyDay = parsed->legacyBackgroundKeyDay;
+	_legacyBackgroundKeyNight = parsed->legacyBackgroundKeyNight;
+	_settingsKey = parsed->userSettingsKey;
+	_recentHashtagsAndBotsKey = parsed->recentHashtagsAndBotsKey;
+	_exportSettingsKey = parsed->exportSettingsKey;
+	_oldMapVersion = version;
 
 	if (_oldMapVersion < AppVersion) {
 		writeMapDelayed();
@@ -456,10 +612,10 @@ Account::ReadMapResult Account::readMapWith(
 	auto stored = readSessionSettings();
 	readMtpData();
 
-	DEBUG_LOG(("selfSerialized set: %1").arg(selfSerialized.size()));
+	DEBUG_LOG(("selfSerialized set: %1").arg(parsed->selfSerialized.size()));
 	_owner->setSessionFromStorage(
 		std::move(stored),
-		std::move(selfSerialized),
+		std::move(parsed->selfSerialized),
 		_oldMapVersion);
 
 	LOG(("Map read time: %1").arg(crl::now() - ms));
@@ -493,6 +649,7 @@ void Account::writeMap() {
 	}
 
 	FileWriteDescriptor map(u"map"_q, _basePath);
+	map.setKind("map");
 	map.writeData(QByteArray());
 	map.writeData(QByteArray());
 
@@ -729,6 +886,7 @@ void Account::writeLocations() {
 		data.stream << quint32(0) << _downloadsSerialized;
 
 		FileWriteDescriptor file(_locationsKey, _basePath);
+		file.setKind("locations");
 		file.writeEncrypted(data, _localKey);
 	}
 }
@@ -747,7 +905,7 @@ void Account::writeLocationsDelayed() {
 
 void Account::readLocations() {
 	FileReadDescriptor locations;
-	if (!ReadEncryptedFile(locations, _locationsKey, _basePath, _localKey)) {
+	if (!readEncryptedFile(locations, ToFilePart(_locationsKey), _basePath)) {
 		ClearKey(_locationsKey, _basePath);
 		_locationsKey = 0;
 		writeMapDelayed();
@@ -869,6 +1027,7 @@ void Account::writeSessionSettings(Main::SessionSettings *stored) {
 	data.stream << quint32(dbiRecentStickers) << recentStickers;
 
 	FileWriteDescriptor file(_settingsKey, _basePath);
+	file.setKind("settings");
 	file.writeEncrypted(data, _localKey);
 }
 
@@ -881,7 +1040,7 @@ ReadSettingsContext Account::prepareReadSettingsContext() const {
 std::unique_ptr<Main::SessionSettings> Account::readSessionSettings() {
 	ReadSettingsContext context;
 	FileReadDescriptor userSettings;
-	if (!ReadEncryptedFile(userSettings, _settingsKey, _basePath, _localKey)) {
+	if (!readEncryptedFile(userSettings, ToFilePart(_settingsKey), _basePath)) {
 		LOG(("App Info: could not read encrypted user settings..."));
 
 		Local::readOldUserSettings(true, context);
@@ -961,6 +1120,7 @@ void Account::writeMtpData() {
 	const auto size = sizeof(quint32) + Serialize::bytearraySize(serialized);
 
 	FileWriteDescriptor mtp(ToFilePart(_dataNameKey), BaseGlobalPath());
+	mtp.setKind("mtp");
 	EncryptedDescriptor data(size);
 	data.stream << quint32(dbiMtpAuthorization) << serialized;
 	mtp.writeEncrypted(data, _localKey);
@@ -970,7 +1130,7 @@ void Account::readMtpData() {
 	auto context = prepareReadSettingsContext();
 
 	FileReadDescriptor mtp;
-	if (!ReadEncryptedFile(mtp, ToFilePart(_dataNameKey), BaseGlobalPath(), _localKey)) {
+	if (!readEncryptedFile(mtp, ToFilePart(_dataNameKey), BaseGlobalPath())) {
 		if (_localKey) {
 			Local::readOldMtpData(true, context);
 			applyReadContext(std::move(context));
@@ -1001,6 +1161,7 @@ void Account::writeMtpConfig() {
 	const auto size = Serialize::bytearraySize(serialized);
 
 	FileWriteDescriptor file(u"config"_q, _basePath);
+	file.setKind("config");
 	EncryptedDescriptor data(size);
 	data.stream << serialized;
 	file.writeEncrypted(data, _localKey);
@@ -1010,7 +1171,7 @@ std::unique_ptr<MTP::Config> Account::readMtpConfig() {
 	Expects(_localKey != nullptr);
 
 	FileReadDescriptor file;
-	if (!ReadEncryptedFile(file, "config", _basePath, _localKey)) {
+	if (!readEncryptedFile(file, u"config"_q, _basePath)) {
 		return nullptr;
 	}
 
@@ -1174,6 +1335,7 @@ void Account::writeDrafts(not_null<History*> history) {
 		writeCallback);
 
 	FileWriteDescriptor file(i->second, _basePath);
+	file.setKind("drafts");
 	file.writeEncrypted(data, _localKey);
 
 	_draftsNotReadMap.remove(peerId);
@@ -1232,6 +1394,7 @@ void Account::writeDraftCursors(not_null<History*> history) {
 		writeCallback);
 
 	FileWriteDescriptor file(i->second, _basePath);
+	file.setKind("draft_cursors");
 	file.writeEncrypted(data, _localKey);
 }
 
@@ -1810,6 +1973,7 @@ void Account::writeStickerSets(
 	data.stream << order;
 
 	FileWriteDescriptor file(stickersKey, _basePath);
+	file.setKind("stickers");
 	file.writeEncrypted(data, _localKey);
 }
 
@@ -2436,6 +2600,7 @@ void Account::writeSavedGifs() {
 			Serialize::Document::writeToStream(data.stream, gif);
 		}
 		FileWriteDescriptor file(_savedGifsKey, _basePath);
+		file.setKind("saved_gifs");
 		file.writeEncrypted(data, _localKey);
 	}
 }
@@ -2531,6 +2696,7 @@ void Account::writeRecentHashtagsAndBots() {
 		Serialize::writePeer(data.stream, *i);
 	}
 	FileWriteDescriptor file(_recentHashtagsAndBotsKey, _basePath);
+	file.setKind("recent_hashtags");
 	file.writeEncrypted(data, _localKey);
 }
 
@@ -2707,6 +2873,7 @@ void Account::writeExportSettings(const Export::Settings &settings) {
 	data.stream << qint32(settings.singlePeerTill);
 
 	FileWriteDescriptor file(_exportSettingsKey, _basePath);
+	file.setKind("export_settings");
 	file.writeEncrypted(data, _localKey);
 }
 
@@ -2855,6 +3022,7 @@ void Account::writeTrustedBots() {
 	}
 
 	FileWriteDescriptor file(_trustedBotsKey, _basePath);
+	file.setKind("trusted_bots");
 	file.writeEncrypted(data, _localKey);
 }
 
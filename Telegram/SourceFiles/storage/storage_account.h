@@ -42,6 +42,7 @@ namespace Storage {
 namespace details {
 struct ReadSettingsContext;
 struct FileReadDescriptor;
+struct MapData;
 } // namespace details
 
 class EncryptionKey;
@@ -50,6 +51,18 @@ using FileKey = quint64;
 
 enum class StartResult : uchar;
 
+// Decrypted contents of a file read in advance, see Account::preloader().
+struct PreloadedFile {
+	int32 version = 0;
+	QByteArray data;
+	qint64 position = 0;
+};
+struct PreloadedFiles {
+	base::flat_map<QString, PreloadedFile> files;
+	std::shared_ptr<details::MapData> map;
+	int32 mapVersion = 0;
+};
+
 struct MessageDraft {
 	FullReplyTo reply;
 	TextWithTags textWithTags;
@@ -70,6 +83,12 @@ public:
 	[[nodiscard]] std::unique_ptr<MTP::Config> start(
 		MTP::AuthKeyPtr localKey);
 	void startAdded(MTP::AuthKeyPtr localKey);
+
+	// Reads and decrypts the files start() needs, may run in any thread.
+	// The result should be passed to setPreloaded() before start().
+	[[nodiscard]] auto preloader(MTP::AuthKeyPtr localKey) const
+		-> FnMut<PreloadedFiles()>;
+	void setPreloaded(PreloadedFiles &&files);
 	[[nodiscard]] int oldMapVersion() const {
 		return _oldMapVersion;
 	}
@@ -197,6 +216,17 @@ private:
 	ReadMapResult readMapWith(
 		MTP::AuthKeyPtr localKey,
 		const QByteArray &legacyPasscode = QByteArray());
+	[[nodiscard]] bool readFile(
+		details::FileReadDescriptor &result,
+		const QString &name,
+		const QString &basePath);
+	[[nodiscard]] bool readEncryptedFile(
+		details::FileReadDescriptor &result,
+		const QString &name,
+		const QString &basePath);
+	[[nodiscard]] bool takePreloaded(
+		details::FileReadDescriptor &result,
+		const QString &path);
 	void clearLegacyFiles();
 	void writeMapDelayed();
 	void writeMapQueued();
@@ -303,6 +333,7 @@ private:
 	bool _recentHashtagsAndBotsWereRead = false;
 
 	int _oldMapVersion = 0;
+	PreloadedFiles _preloaded;
 
 	base::Timer _writeMapTimer;
 	base::Timer _writeLocationsTimer;
@@ -12,6 +12,7 @@ https://github.com/telegramdesktop/tdesktop/blob/master/LEGAL
 #include "mtproto/mtproto_config.h"
 #include "main/main_domain.h"
 #include "main/main_account.h"
+#include "core/startup_trace.h"
 #include "base/random.h"
 
 namespace Storage {
@@ -168,33 +169,76 @@ Domain::StartModernResult Domain::startModern(
 	_oldVersion = keyData.version;
 
 	auto tried = base::flat_set<int>();
-	auto sessions = base::flat_set<uint64>();
-	auto active = 0;
+	auto indices = std::vector<int>();
+	auto lastIndex = -1;
 	for (auto i = 0; i != count; ++i) {
 		auto index = qint32();
 		info.stream >> index;
 		if (index >= 0
 			&& index < Main::Domain::kPremiumMaxAccounts
 			&& tried.emplace(index).second) {
-			auto account = std::make_unique<Main::Account>(
-				_owner,
-				_dataName,
-				index);
-			auto config = account->prepareToStart(_localKey);
-			const auto sessionId = account->willHaveSessionUniqueId(
-				config.get());
-			if (!sessions.contains(sessionId)
-				&& (sessionId != 0 || (sessions.empty() && i + 1 == count))) {
-				if (sessions.empty()) {
-					active = index;
-				}
-				account->start(std::move(config));
-				_owner->accountAddedInStorage({
-					.index = index,
-					.account = std::move(account)
-				});
-				sessions.emplace(sessionId);
+			indices.push_back(index);
+			if (i + 1 == count) {
+				lastIndex = index;
+			}
+		}
+	}
+
+	// Reading and decrypting the account files takes most of the time,
+	// so do it for all the accounts in parallel, the first one right here
+	// after the others are already started in the background.
+	auto accounts = std::vector<std::unique_ptr<Main::Account>>();
+	auto preloaded = std::vector<PreloadedFiles>(indices.size());
+	auto semaphores = std::vector<std::unique_ptr<crl::semaphore>>();
+	accounts.reserve(indices.size());
+	semaphores.reserve(indices.size());
+	for (const auto index : indices) {
+		accounts.push_back(std::make_unique<Main::Account>(
+			_owner,
+			_dataName,
+			index));
+	}
+	for (auto i = 1, size = int(indices.size()); i < size; ++i) {
+		const auto semaphore = semaphores.emplace_back(
+			std::make_unique<crl::semaphore>()).get();
+		const auto result = &preloaded[i];
+		crl::async([
+			=,
+			preload = accounts[i]->local().preloader(_localKey)
+		]() mutable {
+			*result = preload();
+			semaphore->release();
+		});
+	}
+	if (!accounts.empty()) {
+		preloaded.front() = accounts.front()->local().preloader(_localKey)();
+	}
+	for (const auto &semaphore : semaphores) {
+		semaphore->acquire();
+	}
+	Core::StartupTrace::Mark("accounts files");
+
+	auto sessions = base::flat_set<uint64>();
+	auto active = 0;
+	for (auto i = 0, size = int(indices.size()); i != size; ++i) {
+		const auto index = indices[i];
+		auto &account = accounts[i];
+		account->local().setPreloaded(base::take(preloaded[i]));
+		auto config = account->prepareToStart(_localKey);
+		const auto sessionId = account->willHaveSessionUniqueId(
+			config.get());
+		if (!sessions.contains(sessionId)
+			&& (sessionId != 0
+				|| (sessions.empty() && index == lastIndex))) {
+			if (sessions.empty()) {
+				active = index;
 			}
+			account->start(std::move(config));
+			_owner->accountAddedInStorage({
+				.index = index,
+				.account = std::move(account)
+			});
+			sessions.emplace(sessionId);
 		}
 	}
 	if (sessions.empty()) {
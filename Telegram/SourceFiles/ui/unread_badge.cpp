@@ -213,4 +213,8 @@ void PeerBadge::unload() {
 	_emojiStatus = nullptr;
 }
 
+bool PeerBadge::animated() const {
+	return (_emojiStatus != nullptr);
+}
+
 } // namespace Ui
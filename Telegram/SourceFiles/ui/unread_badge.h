@@ -54,6 +54,8 @@ public:
 		const Descriptor &descriptor);
 	void unload();
 
+	[[nodiscard]] bool animated() const;
+
 private:
 	struct EmojiStatus;
 	std::unique_ptr<EmojiStatus> _emojiStatus;
@@ -30,6 +30,8 @@ PRIVATE
     export/output/export_output_html_and_json.h
     export/output/export_output_json.cpp
     export/output/export_output_json.h
+    export/output/export_output_journal.cpp
+    export/output/export_output_journal.h
     export/output/export_output_result.h
     export/output/export_output_stats.cpp
     export/output/export_output_stats.h
@@ -21,6 +21,8 @@ PRIVATE
     mtproto/details/mtproto_dc_key_creator.h
     mtproto/details/mtproto_dcenter.cpp
     mtproto/details/mtproto_dcenter.h
+    mtproto/details/mtproto_decrypt_worker.cpp
+    mtproto/details/mtproto_decrypt_worker.h
     mtproto/details/mtproto_domain_resolver.cpp
     mtproto/details/mtproto_domain_resolver.h
     mtproto/details/mtproto_dump_to_text.cpp